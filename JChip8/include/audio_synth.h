@@ -0,0 +1,42 @@
+#ifndef JUMI_CHIP8_AUDIO_SYNTH_H
+#define JUMI_CHIP8_AUDIO_SYNTH_H
+#include "typedefs.h"
+#include <cstddef>
+#include <vector>
+
+// Beeper synthesis from a precomputed loop.  Whenever the tone changes, a few whole periods of the
+// waveform are rendered with band-limited (polyBLEP) edges into a loop buffer sized so the period fits
+// it almost exactly.  Filling an output buffer is then nothing but memcpy from that loop, so the cost per
+// buffer is the same whatever the tone and there is no division in the audio callback.
+//
+// The classic CHIP-8 beep is a square wave at the configured frequency.  XO-CHIP ROMs instead load a
+// 128 bit pattern with F002 and set its playback rate with FX3A, which plays through the same loop.
+class audio_synth
+{
+public:
+    static constexpr uint32 PATTERN_BITS = 128;
+
+    audio_synth(uint32 sample_rate, int16 volume);
+
+    void set_square(uint32 frequency);
+    void set_pattern(const uint8* pattern, uint8 pitch);
+    void set_volume(int16 volume);
+    void fill(int16* out, size_t count) noexcept;
+    void restart() noexcept;
+
+    [[nodiscard]] uint32 loop_length() const noexcept;
+    [[nodiscard]] static double pattern_bit_rate(uint8 pitch) noexcept;
+
+private:
+    uint32 _sample_rate;
+    int16 _volume;
+    uint8 _pattern[PATTERN_BITS / 8];
+    double _bit_rate;
+    std::vector<int16> _loop;
+    std::vector<float> _wave;
+    size_t _position;
+
+    void render();
+};
+
+#endif
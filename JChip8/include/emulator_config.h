@@ -1,8 +1,10 @@
 #ifndef JUMI_CHIP8_EMULATOR_CONFIG_H
 #define JUMI_CHIP8_EMULATOR_CONFIG_H
 #include "typedefs.h"
+#include "chip8_quirks.h"
 #include <nlohmann/json.hpp>
 #include <string>
+#include <unordered_map>
 
 struct emulator_config
 {
@@ -13,6 +15,26 @@ struct emulator_config
     uint32 wave_frequency = 440;
     int16 volume = 1200;
     uint16 instructions_per_second = 1000;
+    uint32 rewind_seconds = 300;
+    uint32 rewind_memory_mb = 32;
+    uint32 run_ahead_frames = 0;    // 0 turns run-ahead off; most games need 1 or 2
+    chip8_quirks quirks;
+    std::unordered_map<std::string, chip8_quirks> rom_quirks;
+
+    // SDL key names and game controller button names, each mapped to a CHIP-8 key as a hex digit
+    std::unordered_map<std::string, std::string> key_map =
+    {
+        {"1", "1"}, {"2", "2"}, {"3", "3"}, {"4", "C"},
+        {"Q", "4"}, {"W", "5"}, {"F", "6"}, {"P", "D"},
+        {"A", "7"}, {"R", "8"}, {"S", "9"}, {"T", "E"},
+        {"Z", "A"}, {"X", "0"}, {"C", "B"}, {"D", "F"},
+    };
+    std::unordered_map<std::string, std::string> gamepad_map =
+    {
+        {"dpup", "2"}, {"dpleft", "4"}, {"dpright", "6"}, {"dpdown", "8"},
+        {"a", "5"}, {"b", "0"}, {"x", "7"}, {"y", "9"},
+        {"back", "E"}, {"start", "F"},
+    };
 };
 
 namespace config
@@ -24,8 +46,11 @@ emulator_config load_configuration_file();
 emulator_config create_default_config_file();
 std::string to_hex(uint32 value);
 uint32 from_hex(const std::string& hex_str);
+const chip8_quirks& quirks_for_rom(const emulator_config& config, const std::string& rom_path);
 void to_json(nlohmann::json& j, const emulator_config& p);
 void from_json(const nlohmann::json& j, emulator_config& p);
+void to_json(nlohmann::json& j, const chip8_quirks& quirks);
+void from_json(const nlohmann::json& j, chip8_quirks& quirks);
 
 #endif
 
@@ -0,0 +1,52 @@
+#ifndef JUMI_CHIP8_EMULATOR_METRICS_H
+#define JUMI_CHIP8_EMULATOR_METRICS_H
+#include "typedefs.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <string>
+
+// Live counters for monitoring a running emulator.  The main loop and the audio callback each bump their
+// own counters with relaxed atomic adds, a handful per frame, and format() only loads them, so a scrape
+// never takes a lock or waits on either thread.
+class emulator_metrics
+{
+public:
+    static constexpr uint32 FRAME_BUCKETS = 8;
+    // Upper bounds of the frame time histogram; one more bucket counts everything slower
+    static constexpr std::array<uint32, FRAME_BUCKETS> FRAME_BUCKET_US = { 2000, 4000, 8000, 12000, 16667, 25000, 33333, 50000 };
+    static constexpr uint64 FRAME_BUDGET_NS = 16'666'667;
+
+    emulator_metrics() = default;
+    emulator_metrics(const emulator_metrics&) = delete;
+    emulator_metrics& operator=(const emulator_metrics&) = delete;
+
+    // One pass of the main loop, timed without its sleep.  A pass over the 60 Hz budget is a late frame.
+    void record_frame(uint64 cycles, bool emulated, uint64 busy_ns) noexcept;
+    void record_draw(uint64 ns) noexcept;
+    void record_present(uint64 ns) noexcept;
+    void record_audio_callback(bool underrun) noexcept;
+    void set_target_ips(uint32 ips) noexcept;
+    // Main loop only.  Names are kept for the life of the process, so a scrape can still read the old one.
+    void set_rom(const std::string& name);
+
+    // The Prometheus text exposition format, version 0.0.4
+    [[nodiscard]] std::string format() const;
+
+private:
+    std::atomic<uint64> _cycles{ 0 };
+    std::atomic<uint64> _frames{ 0 };
+    std::atomic<uint64> _frames_late{ 0 };
+    std::atomic<uint64> _frame_ns{ 0 };
+    std::array<std::atomic<uint64>, FRAME_BUCKETS + 1> _frame_buckets{};
+    std::atomic<uint64> _frames_presented{ 0 };
+    std::atomic<uint64> _draw_ns{ 0 };
+    std::atomic<uint64> _present_ns{ 0 };
+    std::atomic<uint64> _audio_callbacks{ 0 };
+    std::atomic<uint64> _audio_underruns{ 0 };
+    std::atomic<uint32> _target_ips{ 0 };
+    std::deque<std::string> _rom_names;             // only ever appended to, which leaves earlier names in place
+    std::atomic<const std::string*> _rom{ nullptr };
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef JUMI_CHIP8_GRID_ATLAS_H
+#define JUMI_CHIP8_GRID_ATLAS_H
+#include "typedefs.h"
+#include <vector>
+
+class JChip8;
+
+// The framebuffers of a grid of machines packed side by side into one ARGB8888 image, so a whole wall of
+// them is one texture and one draw call.  Cells are only repacked when their machine drew, and the renderer
+// only uploads the cells listed in dirty_cells().  Colours are 0xRRGGBBAA, as the config loads them.
+class grid_atlas
+{
+public:
+    grid_atlas(uint32 columns, uint32 rows, uint32 fg_color, uint32 bg_color);
+
+    bool update(uint32 cell, JChip8& chip8);
+    void update(uint32 cell, const bool* graphics) noexcept;
+
+    [[nodiscard]] uint32 columns() const noexcept;
+    [[nodiscard]] uint32 rows() const noexcept;
+    [[nodiscard]] uint32 cells() const noexcept;
+    [[nodiscard]] uint32 width() const noexcept;
+    [[nodiscard]] uint32 height() const noexcept;
+    [[nodiscard]] uint32 pitch() const noexcept;        // bytes per atlas row
+    [[nodiscard]] const uint32* pixels() const noexcept;
+    [[nodiscard]] const uint32* cell_pixels(uint32 cell) const noexcept;
+    void cell_origin(uint32 cell, uint32& x, uint32& y) const noexcept;
+
+    [[nodiscard]] const std::vector<uint32>& dirty_cells() const noexcept;
+    void clear_dirty() noexcept;
+
+private:
+    uint32 _columns;
+    uint32 _rows;
+    uint32 _fg_color;
+    uint32 _bg_color;
+    std::vector<uint32> _pixels;
+    std::vector<uint8> _dirty;
+    std::vector<uint32> _dirty_cells;
+};
+
+#endif
@@ -6,6 +6,21 @@
 
 class sdl2_handler;
 class JChip8;
+class debugger;
+class perf_stats;
+struct rewind_stats;
+struct input_stats;
+struct run_ahead_stats;
+struct netplay_stats;
+struct emulator_config;
+
+enum class recording_request
+{
+    none,
+    start_gif,
+    start_y4m_wav,
+    stop,
+};
 
 class imgui_handler
 {
@@ -20,8 +35,16 @@ public:
     [[nodiscard]] const uint16& get_window_height() const noexcept;
     [[nodiscard]] bool reload_config() const noexcept;
     [[nodiscard]] bool init_default_config() const noexcept;
+    [[nodiscard]] bool rom_changed() const noexcept;
+    [[nodiscard]] const std::string& rom_path() const noexcept;     // empty after Unload ROM
+    [[nodiscard]] recording_request requested_recording() const noexcept;
+    [[nodiscard]] const std::string& recording_path() const noexcept;
     void begin_frame(const sdl2_handler& sdl_handler);
-    void draw_gui(JChip8& chip8);
+    void draw_gui(JChip8& chip8, const emulator_config& config, bool recording);
+    void draw_perf_overlay(const perf_stats& stats, uint16 configured_ips, const rewind_stats& rewind, const input_stats& input,
+        const run_ahead_stats& ahead);
+    void draw_debugger(JChip8& chip8, debugger& dbg);
+    void draw_netplay_status(const netplay_stats& stats);
     void end_frame();
     void process_event(SDL_Event* event) const;
 
@@ -29,9 +52,25 @@ private:
     uint16 _menu_height;
     bool _reload_config;
     bool _init_default_config;
+    bool _rom_changed;
+    std::string _rom_path;
+    recording_request _recording_request;
+    std::string _recording_path;
+    bool _show_perf_overlay;
+    bool _show_debugger;
+    uint16 _debug_cursor;
+    char _watch_start[8];
+    char _watch_end[8];
+    bool _watch_read;
+    bool _watch_write;
+    int _condition_register;
+    int _condition_op;
+    char _condition_value[8];
 
     std::string open_file_dialog() const;
+    std::string save_recording_dialog() const;
     void open_config_file(const char* filepath);
+    void sync_debugger(JChip8& chip8, debugger& dbg) const;
 };
 
 #endif
@@ -0,0 +1,37 @@
+#ifndef JUMI_CHIP8_METRICS_SERVER_H
+#define JUMI_CHIP8_METRICS_SERVER_H
+#include "typedefs.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+class emulator_metrics;
+
+// Serves emulator_metrics over HTTP from a thread of its own, on 127.0.0.1 or on a Unix domain socket,
+// answering every request with the current values so a Prometheus scrape job and curl both work.  One
+// client is served at a time with short timeouts, so a stuck client only ever holds up other scrapes.
+class metrics_server
+{
+public:
+    metrics_server(const emulator_metrics& metrics, uint16 port);
+    metrics_server(const emulator_metrics& metrics, const std::string& socket_path);
+    ~metrics_server();
+    metrics_server(const metrics_server&) = delete;
+    metrics_server& operator=(const metrics_server&) = delete;
+
+    [[nodiscard]] uint64 scrapes() const noexcept;
+
+private:
+    struct listener;
+
+    const emulator_metrics& _metrics;
+    std::unique_ptr<listener> _listener;
+    std::atomic<bool> _stopping;
+    std::atomic<uint64> _scrapes;
+    std::thread _thread;
+
+    void serve_loop();
+};
+
+#endif
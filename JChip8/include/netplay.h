@@ -0,0 +1,120 @@
+#ifndef JUMI_CHIP8_NETPLAY_H
+#define JUMI_CHIP8_NETPLAY_H
+#include "jchip8.h"
+#include "typedefs.h"
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+struct netplay_options
+{
+    static constexpr uint32 MAX_INPUT_DELAY = 16;
+    static constexpr uint32 MAX_ROLLBACK = 32;
+
+    uint16 local_port = 0;
+    std::string peer_host;
+    uint16 peer_port = 0;
+    uint32 input_delay = 1;         // frames between a local key press and the frame it applies to
+    uint32 max_rollback = 8;        // how far behind the confirmed remote input the local machine may run
+    uint32 sim_latency_ms = 0;      // extra one-way delay added to outgoing packets, for testing
+    uint32 sim_jitter_ms = 0;
+    uint32 sim_loss_percent = 0;    // chance of dropping an outgoing packet, for testing
+};
+
+struct netplay_stats
+{
+    bool synchronized;
+    bool desynced;
+    uint32 frame;
+    uint32 remote_confirmed_frame;
+    uint32 rollbacks;
+    uint32 resimulated_frames;
+    uint32 max_rollback_depth;
+    uint32 stalls;
+    uint32 packets_sent;
+    uint32 packets_received;
+    uint32 packets_dropped;
+    double last_rollback_ms;
+};
+
+// Two-player rollback netplay over UDP.  Both peers run their own JChip8 from the same ROM and seed, and
+// the keypad each frame sees is the OR of both players' keys.  The remote keys for frames that have not
+// arrived yet are predicted to be whatever the remote player held last; when the real input disagrees
+// the machine restores its snapshot from that frame and re-runs every frame since, all inside one host
+// frame.  Packets carry every input the peer hasn't acknowledged, so a lost packet costs nothing but
+// latency.
+class netplay_session
+{
+public:
+    using frame_fn = std::function<void(JChip8&)>;
+
+    explicit netplay_session(const netplay_options& options);
+    ~netplay_session();
+    netplay_session(const netplay_session&) = delete;
+    netplay_session& operator=(const netplay_session&) = delete;
+
+    void reset(JChip8& chip8);
+    void advance(JChip8& chip8, uint16 local_keys, const frame_fn& run_frame);
+    [[nodiscard]] const netplay_stats& stats() const noexcept;
+
+private:
+    static constexpr uint32 INPUT_WINDOW = 128;
+    static constexpr uint32 SNAPSHOT_COUNT = 64;
+    static_assert(netplay_options::MAX_ROLLBACK < SNAPSHOT_COUNT, "A rollback has to find its frame still in the ring");
+    static constexpr uint32 CHECKSUM_INTERVAL = 60;
+
+    struct pending_packet
+    {
+        std::chrono::steady_clock::time_point release;
+        std::vector<uint8> bytes;
+    };
+
+    struct checksum_record
+    {
+        uint32 frame;
+        uint32 checksum;
+    };
+
+    struct udp_socket;
+
+    netplay_options _options;
+    std::unique_ptr<udp_socket> _socket;
+    netplay_stats _stats;
+
+    uint32 _rom_hash;
+    bool _peer_seen;
+    bool _peer_has_seen_us;
+    uint32 _frame;                  // next frame to simulate
+    uint32 _local_count;            // local inputs recorded so far, including the input delay
+    uint32 _remote_confirmed;       // remote inputs known so far, every frame below this is final
+    uint32 _peer_acked;             // local inputs the peer has confirmed receiving
+
+    std::array<uint16, INPUT_WINDOW> _local_inputs;
+    std::array<uint16, INPUT_WINDOW> _remote_inputs;
+    std::array<uint16, INPUT_WINDOW> _remote_used;
+    std::array<machine_state, SNAPSHOT_COUNT> _snapshots;
+    uint16 _last_remote_input;
+
+    checksum_record _last_checksum;
+    std::array<checksum_record, 8> _checksums;
+
+    std::deque<pending_packet> _outgoing;
+    std::mt19937 _loss_rng;
+
+    void receive(JChip8& chip8, uint32& rollback_to);
+    void send_hello();
+    void send_inputs();
+    void queue_packet(std::vector<uint8> bytes);
+    void flush_outgoing();
+    void simulate(JChip8& chip8, uint32 frame, const frame_fn& run_frame);
+    uint16 remote_input_for(uint32 frame) const noexcept;
+    void update_checksums();
+    static uint32 state_checksum(const machine_state& state) noexcept;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef JUMI_CHIP8_PERF_TIMER_H
+#define JUMI_CHIP8_PERF_TIMER_H
+#include "typedefs.h"
+#include <array>
+#include <chrono>
+#include <iosfwd>
+#include <utility>
+#include <vector>
+
+// Host side stages of one pass through the main loop
+enum class perf_stage
+{
+    input,
+    emulation,
+    run_ahead,
+    draw,
+    gui,
+    present,
+    sleep,
+    count,
+};
+
+struct perf_summary
+{
+    float min_ms;
+    float avg_ms;
+    float p99_ms;
+};
+
+// Rolling per-stage timings for the last few seconds of frames.  Recording is a couple of stores per
+// stage; the min/avg/p99 summaries are only computed when something asks for them.
+class perf_stats
+{
+public:
+    static constexpr uint32 FRAME_HISTORY = 240;
+    static constexpr uint32 STAGE_COUNT = static_cast<uint32>(perf_stage::count);
+
+    perf_stats();
+
+    void record(perf_stage stage, float ms) noexcept;
+    void end_frame(uint32 instructions_executed) noexcept;
+
+    [[nodiscard]] perf_summary summarize(perf_stage stage) const;
+    [[nodiscard]] perf_summary summarize_frame() const;
+    [[nodiscard]] double achieved_ips() const noexcept;
+    [[nodiscard]] uint32 last_instructions() const noexcept;
+    [[nodiscard]] const float* frame_times() const noexcept;
+    [[nodiscard]] uint32 frame_offset() const noexcept;
+    [[nodiscard]] uint32 frames_recorded() const noexcept;
+
+    static const char* stage_name(perf_stage stage) noexcept;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::array<std::array<float, FRAME_HISTORY>, STAGE_COUNT> _stage_ms;
+    std::array<float, STAGE_COUNT> _current_ms;
+    std::array<float, FRAME_HISTORY> _frame_ms;
+    std::array<uint32, FRAME_HISTORY> _instructions;
+    uint32 _index;
+    uint32 _frames_recorded;
+    clock::time_point _last_frame_end;
+
+    perf_summary summarize_samples(const float* samples) const;
+};
+
+class scoped_perf_timer
+{
+public:
+    scoped_perf_timer(perf_stats& stats, perf_stage stage) noexcept;
+    ~scoped_perf_timer();
+    scoped_perf_timer(const scoped_perf_timer&) = delete;
+    scoped_perf_timer& operator=(const scoped_perf_timer&) = delete;
+
+private:
+    perf_stats& _stats;
+    perf_stage _stage;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Wall clock time of each step from process start to the first presented frame, for --startup-profile.
+// Each mark closes the stage that began at the previous one.
+class startup_profile
+{
+public:
+    startup_profile();
+
+    void mark(const char* stage);
+    void report(std::ostream& out) const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::vector<std::pair<const char*, double>> _stages;
+    clock::time_point _start;
+    clock::time_point _last;
+};
+
+// Builds without the overlay compile every timing point away
+#ifdef JCHIP8_PERF_OVERLAY
+#define JCHIP8_PERF_CONCAT_IMPL(a, b) a##b
+#define JCHIP8_PERF_CONCAT(a, b) JCHIP8_PERF_CONCAT_IMPL(a, b)
+#define JCHIP8_PERF_SCOPE(stats, stage) scoped_perf_timer JCHIP8_PERF_CONCAT(perf_scope_, __LINE__)(stats, stage)
+#define JCHIP8_PERF_END_FRAME(stats, instructions) (stats).end_frame(instructions)
+#else
+#define JCHIP8_PERF_SCOPE(stats, stage) ((void)0)
+#define JCHIP8_PERF_END_FRAME(stats, instructions) ((void)(instructions))
+#endif
+
+#endif
@@ -1,19 +1,40 @@
 #ifndef JUMI_CHIP8_SDL_HANDLER_H
 #define JUMI_CHIP8_SDL_HANDLER_H
+#include <array>
 #include <cstdint>
+#include <unordered_map>
 #include <SDL2/SDL.h>
+#include "audio_synth.h"
 #include "typedefs.h"
 
 struct ROM;
 struct emulator_config;
+class emulator_metrics;
+class grid_atlas;
+class startup_profile;
 
 class JChip8;
 class imgui_handler;
 
+// How long keypad changes took from the host event to the cycle they were applied at
+struct input_stats
+{
+    static constexpr uint32 HISTORY = 64;
+
+    uint64 events = 0;
+    uint64 extended_taps = 0;       // releases held back so a tap shorter than a frame is still seen
+    float latencies_ms[HISTORY] = {};
+    uint32 latency_count = 0;
+    uint32 latency_offset = 0;
+
+    [[nodiscard]] float avg_ms() const noexcept;
+    [[nodiscard]] float max_ms() const noexcept;
+};
+
 class sdl2_handler
 {
 public:
-    sdl2_handler(uint32 window_width, uint32 window_height, const emulator_config& config);
+    sdl2_handler(uint32 window_width, uint32 window_height, const emulator_config& config, startup_profile* profile = nullptr);
     ~sdl2_handler();
     sdl2_handler(const sdl2_handler&) = delete;
     sdl2_handler& operator=(const sdl2_handler&) = delete;
@@ -23,12 +44,21 @@ public:
     uint64 time() const noexcept;
     uint64 performance_freq() const noexcept;
     void delay(uint32 time_ms) const noexcept;
+    bool wait_event(uint32 timeout_ms) const noexcept;
     SDL_Window* window() const noexcept;
     SDL_Renderer* renderer() const noexcept;
     void draw_graphics(JChip8& chip8);
+    void draw_grid(grid_atlas& atlas);
     void clear_framebuffer() const;
-    void handle_input(JChip8& chip8, const imgui_handler& gui_handler);
-    void play_device(bool play) const;
+    bool handle_input(JChip8& chip8, const imgui_handler& gui_handler);
+    void reload_input_map();
+    void play_device(bool play);
+    void attach_metrics(emulator_metrics* metrics);
+    void init_deferred();
+    void update_audio(const JChip8& chip8);
+    [[nodiscard]] bool rewind_held() const noexcept;
+    [[nodiscard]] uint16 local_keys() const noexcept;
+    [[nodiscard]] const input_stats& input_latency() const noexcept;
     void set_window_size(uint32 width, uint32 height, uint32 menu_height);
     void show_window() const noexcept;
     void render() const noexcept;
@@ -36,15 +66,42 @@ public:
 private:
     SDL_Window* _window;
     SDL_Renderer* _renderer;
+    SDL_Texture* _grid_texture;         // created by the first draw_grid, sized to its atlas
+    uint32 _grid_texture_width;
+    uint32 _grid_texture_height;
     SDL_AudioSpec _want;
     SDL_AudioSpec _have;
-    SDL_AudioDeviceID _audio_device;
+    SDL_AudioDeviceID _audio_device;        // 0 until the first beep opens it
+    bool _audio_unavailable;
+    bool _audio_playing;
+    uint64 _last_callback;              // audio thread only, or under the audio lock
+    emulator_metrics* _metrics;
+    bool _deferred_init_done;
     uint32 _window_width;
     uint32 _window_height;
     float _window_scale;
     uint32 _menu_height;
+    bool _rewind_held;
+    uint16 _local_keys;
+    std::unordered_map<SDL_Keycode, uint8> _key_map;
+    std::array<int8, SDL_CONTROLLER_BUTTON_MAX> _button_map;
+    SDL_GameController* _gamepad;
+    uint8 _key_sources[16];         // which devices hold each key, so the keyboard and a gamepad don't release each other
+    uint64 _press_cycle[16];
+    uint32 _poll_first_ticks;
+    uint64 _poll_base_cycle;
+    bool _poll_started;
+    input_stats _input_stats;
     const emulator_config& _config;
+    audio_synth _synth;
+    uint8 _tone_pattern[16];
+    uint8 _tone_pitch;
+    bool _tone_pattern_loaded;
+    uint32 _tone_frequency;
+    int16 _tone_volume;
 
+    void key_event(JChip8& chip8, uint8 key, bool pressed, uint8 source, uint32 timestamp, uint32 now);
+    void open_audio();
     void extract_rgba(uint32 color, uint8& r, uint8& g, uint8& b, uint8& a) const;
     static void audio_callback(void* userdata, uint8* stream, int len);
 };
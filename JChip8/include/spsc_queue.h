@@ -0,0 +1,50 @@
+#ifndef JUMI_CHIP8_SPSC_QUEUE_H
+#define JUMI_CHIP8_SPSC_QUEUE_H
+#include "typedefs.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Fixed size single producer, single consumer ring.  Neither side ever blocks or allocates: a full
+// queue makes try_push fail and an empty one makes try_pop fail.  The head and tail live on separate
+// cache lines so the two threads don't fight over one.
+template <typename T, size_t Capacity>
+class spsc_queue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "spsc_queue capacity must be a power of two");
+
+public:
+    [[nodiscard]] bool try_push(const T& value) noexcept
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        _slots[tail & (Capacity - 1)] = value;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool try_pop(T& out) noexcept
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+            return false;
+
+        out = _slots[head & (Capacity - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> _head{ 0 };
+    alignas(64) std::atomic<size_t> _tail{ 0 };
+    alignas(64) std::array<T, Capacity> _slots;
+};
+
+#endif
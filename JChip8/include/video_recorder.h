@@ -0,0 +1,80 @@
+#ifndef JUMI_CHIP8_VIDEO_RECORDER_H
+#define JUMI_CHIP8_VIDEO_RECORDER_H
+#include "jchip8.h"
+#include "spsc_queue.h"
+#include "typedefs.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct emulator_config;
+
+enum class recording_format : uint8
+{
+    gif,        // one palette-indexed image per distinct frame, repeats become longer frame delays
+    y4m_wav,    // uncompressed 60 fps YUV 4:4:4 video, with the beeper in a matching .wav file
+};
+
+struct recorder_stats
+{
+    uint32 frames_submitted;
+    uint32 unique_frames;
+    uint32 frames_dropped;
+    uint64 bytes_written;
+};
+
+// Records the native resolution framebuffer and the beeper after every emulated frame.  submit() packs
+// the frame into a queue slot and returns, everything else (deduplication, colour conversion, encoding,
+// audio synthesis and file IO) happens on a writer thread.  If the writer ever falls a full queue
+// behind, frames are dropped rather than stalling the emulator.
+class video_recorder
+{
+public:
+    video_recorder();
+    ~video_recorder();
+    video_recorder(const video_recorder&) = delete;
+    video_recorder& operator=(const video_recorder&) = delete;
+
+    // Y4M + WAV recordings write <path>.y4m and <path>.wav, GIF recordings write <path>.gif
+    void start(const std::string& path, recording_format format, const emulator_config& config);
+    void stop();
+    void submit(const JChip8& chip8) noexcept;
+    [[nodiscard]] bool recording() const noexcept;
+    [[nodiscard]] recorder_stats stats() const noexcept;
+
+    static constexpr uint32 FRAME_BYTES = GRAPHICS_WIDTH * GRAPHICS_HEIGHT / 8;
+
+    struct recorded_frame
+    {
+        uint8 pixels[FRAME_BYTES];  // one bit per pixel, row major, most significant bit first
+        bool sound;
+        bool audio_pattern_loaded;
+        uint8 audio_pitch;
+        uint8 audio_pattern[16];
+    };
+
+private:
+    struct encoder;
+
+    spsc_queue<recorded_frame, 256> _queue;
+    std::unique_ptr<encoder> _encoder;
+    std::thread _writer;
+    std::atomic<bool> _recording;
+    std::atomic<bool> _stopping;
+    std::atomic<uint32> _frames_submitted;
+    std::atomic<uint32> _unique_frames;
+    std::atomic<uint32> _frames_dropped;
+    std::atomic<uint64> _bytes_written;
+
+    void writer_loop();
+};
+
+// Packs a bool-per-pixel framebuffer into recorded_frame::pixels
+void pack_framebuffer(const bool* graphics, uint8* out) noexcept;
+
+// GIF flavoured LZW for the image data of one frame, already split into length-prefixed sub-blocks
+void gif_lzw_encode(const uint8* indices, size_t count, uint8 min_code_size, std::vector<uint8>& out);
+
+#endif
@@ -0,0 +1,144 @@
+#include "audio_synth.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Long enough that rounding the loop to whole samples detunes by well under a cent
+    constexpr double MIN_LOOP_SAMPLES = 2048.0;
+
+    bool pattern_bit(const uint8* pattern, uint32 bit) noexcept
+    {
+        return (pattern[(bit >> 3) & 0xF] >> (7 - (bit & 7))) & 1;
+    }
+}
+
+audio_synth::audio_synth(uint32 sample_rate, int16 volume)
+    : _sample_rate(sample_rate)
+    , _volume(volume)
+    , _pattern{ 0 }
+    , _bit_rate(0.0)
+    , _loop()
+    , _wave()
+    , _position(0)
+{
+    render();
+}
+
+void audio_synth::set_square(uint32 frequency)
+{
+    // Half a pattern high and half low is a square wave at bit_rate / 128
+    std::memset(_pattern, 0xFF, sizeof(_pattern) / 2);
+    std::memset(_pattern + sizeof(_pattern) / 2, 0x00, sizeof(_pattern) / 2);
+    _bit_rate = static_cast<double>(frequency) * PATTERN_BITS;
+    render();
+}
+
+void audio_synth::set_pattern(const uint8* pattern, uint8 pitch)
+{
+    std::memcpy(_pattern, pattern, sizeof(_pattern));
+    _bit_rate = pattern_bit_rate(pitch);
+    render();
+}
+
+void audio_synth::set_volume(int16 volume)
+{
+    _volume = volume;
+    render();
+}
+
+void audio_synth::fill(int16* out, size_t count) noexcept
+{
+    while (count > 0)
+    {
+        size_t chunk = std::min(count, _loop.size() - _position);
+        std::memcpy(out, _loop.data() + _position, chunk * sizeof(int16));
+        out += chunk;
+        count -= chunk;
+        _position += chunk;
+        if (_position == _loop.size())
+            _position = 0;
+    }
+}
+
+void audio_synth::restart() noexcept
+{
+    _position = 0;
+}
+
+uint32 audio_synth::loop_length() const noexcept
+{
+    return static_cast<uint32>(_loop.size());
+}
+
+double audio_synth::pattern_bit_rate(uint8 pitch) noexcept
+{
+    return 4000.0 * std::pow(2.0, (static_cast<double>(pitch) - 64.0) / 48.0);
+}
+
+void audio_synth::render()
+{
+    _position = 0;
+    double period = _bit_rate > 0.0 ? PATTERN_BITS * _sample_rate / _bit_rate : 0.0;
+
+    // Tones with a period under two samples are above Nyquist and can only alias, so they're silent
+    if (period < 2.0)
+    {
+        _loop.assign(1, 0);
+        return;
+    }
+
+    uint32 periods = static_cast<uint32>(std::ceil(MIN_LOOP_SAMPLES / period));
+    uint32 length = static_cast<uint32>(std::lround(periods * period));
+    double bit_width = static_cast<double>(length) / (static_cast<double>(periods) * PATTERN_BITS);
+    uint32 edges = periods * PATTERN_BITS;
+
+    // Naive one bit waveform first: sample n plays the bit whose span contains n
+    std::vector<float>& wave = _wave;
+    wave.assign(length, 0.0f);
+    for (uint32 edge = 0; edge < edges; ++edge)
+    {
+        uint32 first = static_cast<uint32>(std::ceil(edge * bit_width));
+        uint32 last = std::min(length, static_cast<uint32>(std::ceil((edge + 1) * bit_width)));
+        float level = pattern_bit(_pattern, edge) ? 1.0f : -1.0f;
+        for (uint32 n = first; n < last; ++n)
+            wave[n] = level;
+    }
+
+    // Then replace every hard step with a two sample polynomial approximation of a band-limited one
+    for (uint32 edge = 0; edge < edges; ++edge)
+    {
+        bool before = pattern_bit(_pattern, (edge + PATTERN_BITS - 1) % PATTERN_BITS);
+        bool after = pattern_bit(_pattern, edge % PATTERN_BITS);
+        if (before == after)
+            continue;
+
+        double step = after ? 2.0 : -2.0;
+        double at = edge * bit_width;
+        for (int64 n = static_cast<int64>(std::ceil(at - 1.0)); static_cast<double>(n) < at + 1.0; ++n)
+        {
+            double x = static_cast<double>(n) - at;
+            double residual = x < 0.0 ? (x + 1.0) * (x + 1.0) * 0.5 : -(1.0 - x) * (1.0 - x) * 0.5;
+            size_t index = static_cast<size_t>((n + length) % length);
+            wave[index] += static_cast<float>(step * residual);
+        }
+    }
+
+    // Patterns that are mostly on or mostly off would otherwise sit at a DC offset
+    double mean = 0.0;
+    for (float sample : wave)
+        mean += sample;
+    mean /= length;
+
+    double peak = 1.0;
+    for (float sample : wave)
+        peak = std::max(peak, std::abs(sample - mean));
+
+    _loop.resize(length);
+    double scale = _volume / peak;
+    for (uint32 n = 0; n < length; ++n)
+        _loop[n] = static_cast<int16>(std::lround((wave[n] - mean) * scale));
+}
@@ -62,6 +62,17 @@ uint32 from_hex(const std::string& hex_str)
     return value;
 }
 
+const chip8_quirks& quirks_for_rom(const emulator_config& config, const std::string& rom_path)
+{
+    // Per ROM overrides are keyed by file name, so they survive the ROM being moved around
+    std::string rom_name = std::filesystem::path(rom_path).filename().string();
+    auto it = config.rom_quirks.find(rom_name);
+    if (it != config.rom_quirks.end())
+        return it->second;
+
+    return config.quirks;
+}
+
 void to_json(nlohmann::json& j, const emulator_config& config)
 {
     j = nlohmann::json
@@ -73,6 +84,13 @@ void to_json(nlohmann::json& j, const emulator_config& config)
         {"wave_frequency", config.wave_frequency},
         {"volume", config.volume},
         {"instructions_per_second", config.instructions_per_second},
+        {"rewind_seconds", config.rewind_seconds},
+        {"rewind_memory_mb", config.rewind_memory_mb},
+        {"run_ahead_frames", config.run_ahead_frames},
+        {"quirks", config.quirks},
+        {"rom_quirks", config.rom_quirks},
+        {"key_map", config.key_map},
+        {"gamepad_map", config.gamepad_map},
     };
 }
 
@@ -85,4 +103,42 @@ void from_json(const nlohmann::json& j, emulator_config& config)
     j.at("wave_frequency").get_to(config.wave_frequency);
     j.at("volume").get_to(config.volume);
     j.at("instructions_per_second").get_to(config.instructions_per_second);
+
+    // Everything below was added after the first config files were written, so it is optional
+    if (j.contains("rewind_seconds"))
+        j.at("rewind_seconds").get_to(config.rewind_seconds);
+    if (j.contains("rewind_memory_mb"))
+        j.at("rewind_memory_mb").get_to(config.rewind_memory_mb);
+    if (j.contains("run_ahead_frames"))
+        j.at("run_ahead_frames").get_to(config.run_ahead_frames);
+    if (j.contains("quirks"))
+        j.at("quirks").get_to(config.quirks);
+    if (j.contains("rom_quirks"))
+        j.at("rom_quirks").get_to(config.rom_quirks);
+    if (j.contains("key_map"))
+        j.at("key_map").get_to(config.key_map);
+    if (j.contains("gamepad_map"))
+        j.at("gamepad_map").get_to(config.gamepad_map);
+}
+
+void to_json(nlohmann::json& j, const chip8_quirks& quirks)
+{
+    j = nlohmann::json
+    {
+        {"shift_uses_vy", quirks.shift_uses_vy},
+        {"load_store_increments_i", quirks.load_store_increments_i},
+        {"logic_resets_vf", quirks.logic_resets_vf},
+        {"clip_sprites", quirks.clip_sprites},
+        {"display_wait", quirks.display_wait},
+    };
+}
+
+void from_json(const nlohmann::json& j, chip8_quirks& quirks)
+{
+    chip8_quirks defaults;
+    quirks.shift_uses_vy = j.value("shift_uses_vy", defaults.shift_uses_vy);
+    quirks.load_store_increments_i = j.value("load_store_increments_i", defaults.load_store_increments_i);
+    quirks.logic_resets_vf = j.value("logic_resets_vf", defaults.logic_resets_vf);
+    quirks.clip_sprites = j.value("clip_sprites", defaults.clip_sprites);
+    quirks.display_wait = j.value("display_wait", defaults.display_wait);
 }
@@ -0,0 +1,135 @@
+#include "emulator_metrics.h"
+#include <cstdio>
+
+namespace
+{
+    void append_metric(std::string& out, const char* name, const char* type, const char* help, const std::string& value)
+    {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+        out += name;
+        out += ' ';
+        out += value;
+        out += '\n';
+    }
+
+    std::string seconds(uint64 ns)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9f", static_cast<double>(ns) / 1e9);
+        return text;
+    }
+
+    // Label values escape backslashes, quotes and newlines
+    std::string label_value(const std::string& value)
+    {
+        std::string escaped;
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+                escaped += '\\';
+            if (c == '\n')
+                escaped += "\\n";
+            else
+                escaped += c;
+        }
+        return escaped;
+    }
+}
+
+void emulator_metrics::record_frame(uint64 cycles, bool emulated, uint64 busy_ns) noexcept
+{
+    _cycles.fetch_add(cycles, std::memory_order_relaxed);
+    if (emulated)
+        _frames.fetch_add(1, std::memory_order_relaxed);
+    if (busy_ns > FRAME_BUDGET_NS)
+        _frames_late.fetch_add(1, std::memory_order_relaxed);
+
+    uint32 bucket = 0;
+    while (bucket < FRAME_BUCKETS && busy_ns > uint64{ FRAME_BUCKET_US[bucket] } * 1000)
+        ++bucket;
+    _frame_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    _frame_ns.fetch_add(busy_ns, std::memory_order_relaxed);
+}
+
+void emulator_metrics::record_draw(uint64 ns) noexcept
+{
+    _draw_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+void emulator_metrics::record_present(uint64 ns) noexcept
+{
+    _frames_presented.fetch_add(1, std::memory_order_relaxed);
+    _present_ns.fetch_add(ns, std::memory_order_relaxed);
+}
+
+void emulator_metrics::record_audio_callback(bool underrun) noexcept
+{
+    _audio_callbacks.fetch_add(1, std::memory_order_relaxed);
+    if (underrun)
+        _audio_underruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+void emulator_metrics::set_target_ips(uint32 ips) noexcept
+{
+    _target_ips.store(ips, std::memory_order_relaxed);
+}
+
+void emulator_metrics::set_rom(const std::string& name)
+{
+    const std::string* current = _rom.load(std::memory_order_relaxed);
+    if (current && *current == name)
+        return;
+
+    _rom_names.push_back(name);
+    _rom.store(&_rom_names.back(), std::memory_order_release);
+}
+
+std::string emulator_metrics::format() const
+{
+    auto load = [](const std::atomic<uint64>& counter) { return std::to_string(counter.load(std::memory_order_relaxed)); };
+
+    std::string out;
+    out.reserve(2048);
+    append_metric(out, "jchip8_cycles_total", "counter", "Instructions the machine has executed; rate() gives the achieved IPS.", load(_cycles));
+    append_metric(out, "jchip8_target_ips", "gauge", "Instructions per second the machine is configured to run.",
+        std::to_string(_target_ips.load(std::memory_order_relaxed)));
+    append_metric(out, "jchip8_frames_total", "counter", "60 Hz frames emulated.", load(_frames));
+    append_metric(out, "jchip8_frames_late_total", "counter", "Main loop passes that took longer than a 60 Hz frame.", load(_frames_late));
+    append_metric(out, "jchip8_frames_presented_total", "counter", "Frames drawn to the window.", load(_frames_presented));
+    append_metric(out, "jchip8_draw_seconds_total", "counter", "Time spent in draw_graphics.", seconds(_draw_ns.load(std::memory_order_relaxed)));
+    append_metric(out, "jchip8_present_seconds_total", "counter", "Time spent in SDL_RenderPresent.",
+        seconds(_present_ns.load(std::memory_order_relaxed)));
+    append_metric(out, "jchip8_audio_callbacks_total", "counter", "Audio buffers the device asked for.", load(_audio_callbacks));
+    append_metric(out, "jchip8_audio_underruns_total", "counter", "Audio buffers asked for after the device had already run dry.",
+        load(_audio_underruns));
+
+    // The count is the sum of the buckets read, so +Inf always equals it however the reads interleave with updates
+    out += "# HELP jchip8_frame_seconds Main loop pass time, not counting the sleep to the next frame.\n";
+    out += "# TYPE jchip8_frame_seconds histogram\n";
+    uint64 cumulative = 0;
+    char bound[32];
+    for (uint32 bucket = 0; bucket <= FRAME_BUCKETS; ++bucket)
+    {
+        cumulative += _frame_buckets[bucket].load(std::memory_order_relaxed);
+        if (bucket < FRAME_BUCKETS)
+            std::snprintf(bound, sizeof(bound), "%g", FRAME_BUCKET_US[bucket] / 1e6);
+        else
+            std::snprintf(bound, sizeof(bound), "+Inf");
+        out += "jchip8_frame_seconds_bucket{le=\"" + std::string(bound) + "\"} " + std::to_string(cumulative) + '\n';
+    }
+    out += "jchip8_frame_seconds_sum " + seconds(_frame_ns.load(std::memory_order_relaxed)) + '\n';
+    out += "jchip8_frame_seconds_count " + std::to_string(cumulative) + '\n';
+
+    const std::string* rom = _rom.load(std::memory_order_acquire);
+    out += "# HELP jchip8_rom_info The ROM currently loaded.\n# TYPE jchip8_rom_info gauge\n";
+    out += "jchip8_rom_info{rom=\"" + label_value(rom ? *rom : std::string()) + "\"} 1\n";
+    return out;
+}
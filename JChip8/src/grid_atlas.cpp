@@ -0,0 +1,86 @@
+#include "grid_atlas.h"
+#include "jchip8.h"
+
+grid_atlas::grid_atlas(uint32 columns, uint32 rows, uint32 fg_color, uint32 bg_color)
+    : _columns(columns > 0 ? columns : 1)
+    , _rows(rows > 0 ? rows : 1)
+    , _fg_color(0xFF000000u | (fg_color >> 8))
+    , _bg_color(0xFF000000u | (bg_color >> 8))
+    , _pixels(static_cast<size_t>(_columns) * _rows * GRAPHICS_WIDTH * GRAPHICS_HEIGHT, _bg_color)
+    , _dirty(static_cast<size_t>(_columns) * _rows, 1)
+    , _dirty_cells()
+{
+    // Every cell starts dirty so the first upload fills the texture with the background
+    _dirty_cells.reserve(cells());
+    for (uint32 cell = 0; cell < cells(); ++cell)
+        _dirty_cells.push_back(cell);
+}
+
+bool grid_atlas::update(uint32 cell, JChip8& chip8)
+{
+    if (!chip8.draw_flag())
+        return false;
+
+    update(cell, chip8.graphics);
+    chip8.reset_draw_flag();
+    return true;
+}
+
+void grid_atlas::update(uint32 cell, const bool* graphics) noexcept
+{
+    if (cell >= cells())
+        return;
+
+    uint32 x = 0;
+    uint32 y = 0;
+    cell_origin(cell, x, y);
+    uint32* out = _pixels.data() + static_cast<size_t>(y) * width() + x;
+    // Written so the compiler vectorises each row: colours live in locals, since stores through out could
+    // otherwise alias the members, pixels are read as bytes and the colour is picked with a mask, not a branch
+    uint32 bg = _bg_color;
+    uint32 flip = _fg_color ^ _bg_color;
+    for (uint32 row = 0; row < GRAPHICS_HEIGHT; ++row)
+    {
+        const uint8* in = reinterpret_cast<const uint8*>(graphics) + row * GRAPHICS_WIDTH;
+        for (uint32 col = 0; col < GRAPHICS_WIDTH; ++col)
+            out[col] = bg ^ (flip & (0u - static_cast<uint32>(in[col])));
+        out += width();
+    }
+
+    if (!_dirty[cell])
+    {
+        _dirty[cell] = 1;
+        _dirty_cells.push_back(cell);
+    }
+}
+
+uint32 grid_atlas::columns() const noexcept { return _columns; }
+uint32 grid_atlas::rows() const noexcept { return _rows; }
+uint32 grid_atlas::cells() const noexcept { return _columns * _rows; }
+uint32 grid_atlas::width() const noexcept { return _columns * GRAPHICS_WIDTH; }
+uint32 grid_atlas::height() const noexcept { return _rows * GRAPHICS_HEIGHT; }
+uint32 grid_atlas::pitch() const noexcept { return width() * sizeof(uint32); }
+const uint32* grid_atlas::pixels() const noexcept { return _pixels.data(); }
+
+const uint32* grid_atlas::cell_pixels(uint32 cell) const noexcept
+{
+    uint32 x = 0;
+    uint32 y = 0;
+    cell_origin(cell, x, y);
+    return _pixels.data() + static_cast<size_t>(y) * width() + x;
+}
+
+void grid_atlas::cell_origin(uint32 cell, uint32& x, uint32& y) const noexcept
+{
+    x = (cell % _columns) * GRAPHICS_WIDTH;
+    y = (cell / _columns) * GRAPHICS_HEIGHT;
+}
+
+const std::vector<uint32>& grid_atlas::dirty_cells() const noexcept { return _dirty_cells; }
+
+void grid_atlas::clear_dirty() noexcept
+{
+    for (uint32 cell : _dirty_cells)
+        _dirty[cell] = 0;
+    _dirty_cells.clear();
+}
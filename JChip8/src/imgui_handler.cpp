@@ -1,12 +1,19 @@
 #include "imgui_handler.h"
 #include "sdl2_handler.h"
+#include "debugger.h"
 #include "emulator_config.h"
-#include "JChip8.h"
+#include "jchip8.h"
+#include "netplay.h"
+#include "perf_timer.h"
+#include "rewind_buffer.h"
+#include "run_ahead.h"
 #include "typedefs.h"
 #include <imgui.h>
 #include <imgui_impl_sdl2.h>
 #include <imgui_impl_sdlrenderer2.h>
 #include <tinyfiledialogs/tinyfiledialogs.h>
+#include <cstdio>
+#include <cstdlib>
 #include <string>
 
 #ifdef _WIN32
@@ -17,6 +24,20 @@ imgui_handler::imgui_handler(const sdl2_handler& sdl_handler)
     : _menu_height{ 20 }
     , _reload_config{ false }
     , _init_default_config{ false }
+    , _rom_changed{ false }
+    , _rom_path()
+    , _recording_request{ recording_request::none }
+    , _recording_path()
+    , _show_perf_overlay{ false }
+    , _show_debugger{ false }
+    , _debug_cursor{ ROM_START_LOCATION }
+    , _watch_start{ "200" }
+    , _watch_end{ "200" }
+    , _watch_read{ false }
+    , _watch_write{ true }
+    , _condition_register{ 0 }
+    , _condition_op{ 0 }
+    , _condition_value{ "00" }
 {
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -48,17 +69,39 @@ bool imgui_handler::init_default_config() const noexcept
     return _init_default_config;
 }
 
+bool imgui_handler::rom_changed() const noexcept
+{
+    return _rom_changed;
+}
+
+const std::string& imgui_handler::rom_path() const noexcept
+{
+    return _rom_path;
+}
+
+recording_request imgui_handler::requested_recording() const noexcept
+{
+    return _recording_request;
+}
+
+const std::string& imgui_handler::recording_path() const noexcept
+{
+    return _recording_path;
+}
+
 void imgui_handler::begin_frame(const sdl2_handler& sdl_handler)
 {
     _reload_config = false;
     _init_default_config = false;
+    _rom_changed = false;
+    _recording_request = recording_request::none;
 
     ImGui_ImplSDL2_NewFrame(sdl_handler.window());
     ImGui_ImplSDLRenderer2_NewFrame();
     ImGui::NewFrame();
 }
 
-void imgui_handler::draw_gui(JChip8& chip8)
+void imgui_handler::draw_gui(JChip8& chip8, const emulator_config& config, bool recording)
 {
     if (ImGui::BeginMainMenuBar())
     {
@@ -67,12 +110,16 @@ void imgui_handler::draw_gui(JChip8& chip8)
             if (ImGui::MenuItem("Load ROM"))
             {
                 std::string rom_path = open_file_dialog();
-                chip8.load_ROM(rom_path.c_str());
+                chip8.load_ROM(rom_path.c_str(), quirks_for_rom(config, rom_path));
+                _rom_path = rom_path;
+                _rom_changed = true;
             } ImGui::Separator();
 
             if (ImGui::MenuItem("Unload ROM"))
             {
                 chip8.unload_ROM();
+                _rom_path.clear();
+                _rom_changed = true;
             }
 
             ImGui::EndMenu();
@@ -94,6 +141,34 @@ void imgui_handler::draw_gui(JChip8& chip8)
             }
             ImGui::EndMenu();
         }
+        if (ImGui::BeginMenu("Record"))
+        {
+            if (ImGui::MenuItem("Start GIF Recording", nullptr, false, !recording))
+            {
+                _recording_path = save_recording_dialog();
+                if (!_recording_path.empty())
+                    _recording_request = recording_request::start_gif;
+            }
+            if (ImGui::MenuItem("Start Y4M + WAV Recording", nullptr, false, !recording))
+            {
+                _recording_path = save_recording_dialog();
+                if (!_recording_path.empty())
+                    _recording_request = recording_request::start_y4m_wav;
+            }
+            if (ImGui::MenuItem("Stop Recording", nullptr, false, recording))
+            {
+                _recording_request = recording_request::stop;
+            }
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("View"))
+        {
+#ifdef JCHIP8_PERF_OVERLAY
+            ImGui::MenuItem("Performance Overlay", nullptr, &_show_perf_overlay);
+#endif
+            ImGui::MenuItem("Debugger", nullptr, &_show_debugger);
+            ImGui::EndMenu();
+        }
         if (ImGui::BeginMenu("Exit"))
         {
             chip8.state = emulator_state::quit;
@@ -105,6 +180,253 @@ void imgui_handler::draw_gui(JChip8& chip8)
     }
 }
 
+void imgui_handler::draw_perf_overlay(const perf_stats& stats, uint16 configured_ips, const rewind_stats& rewind, const input_stats& input,
+    const run_ahead_stats& ahead)
+{
+    if (!_show_perf_overlay)
+        return;
+
+    ImGui::SetNextWindowPos(ImVec2(10.0f, _menu_height + 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.8f);
+    if (ImGui::Begin("Performance", &_show_perf_overlay, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing))
+    {
+        ImGui::Text("IPS: %.0f achieved / %u configured", stats.achieved_ips(), static_cast<uint32>(configured_ips));
+        ImGui::Text("Instructions last frame: %u (budget %u)", stats.last_instructions(), static_cast<uint32>(configured_ips / 60));
+        ImGui::Separator();
+
+        ImGui::Text("%-10s %8s %8s %8s", "Stage", "min ms", "avg ms", "p99 ms");
+        for (uint32 stage = 0; stage < perf_stats::STAGE_COUNT; ++stage)
+        {
+            perf_summary summary = stats.summarize(static_cast<perf_stage>(stage));
+            ImGui::Text("%-10s %8.3f %8.3f %8.3f", perf_stats::stage_name(static_cast<perf_stage>(stage)),
+                summary.min_ms, summary.avg_ms, summary.p99_ms);
+        }
+
+        perf_summary frame = stats.summarize_frame();
+        ImGui::Text("%-10s %8.3f %8.3f %8.3f", "Frame", frame.min_ms, frame.avg_ms, frame.p99_ms);
+        ImGui::Separator();
+
+        ImGui::Text("Rewind: %u frames, %.1f KB, %.0f B/frame", rewind.frames, rewind.bytes / 1024.0, rewind.avg_bytes_per_frame);
+        ImGui::Text("Rewind capture: %.2f us last, %.2f us avg", rewind.last_capture_us, rewind.avg_capture_us);
+        ImGui::Separator();
+
+        ImGui::Text("Input latency: %.1f ms avg, %.1f ms max (last %u)", input.avg_ms(), input.max_ms(), input.latency_count);
+        ImGui::Text("Input events: %llu, taps extended: %llu", static_cast<unsigned long long>(input.events),
+            static_cast<unsigned long long>(input.extended_taps));
+        if (ahead.frames > 0)
+        {
+            // Run-ahead redoes the emulation work every frame, so its cost is shown against the real frame's
+            float emulation_ms = stats.summarize(perf_stage::emulation).avg_ms;
+            ImGui::Text("Run-ahead: %u frames, %.2f us last, %.2f us avg (%.1fx emulation)", ahead.frames, ahead.last_us, ahead.avg_us,
+                emulation_ms > 0.0f ? ahead.avg_us / (emulation_ms * 1000.0) : 0.0);
+        }
+        ImGui::Separator();
+
+        ImGui::PlotLines("##frame_times", stats.frame_times(), static_cast<int>(perf_stats::FRAME_HISTORY),
+            static_cast<int>(stats.frame_offset()), "Frame time (ms)", 0.0f, 50.0f, ImVec2(0.0f, 60.0f));
+    }
+    ImGui::End();
+}
+
+void imgui_handler::draw_netplay_status(const netplay_stats& stats)
+{
+    ImGui::SetNextWindowPos(ImVec2(10.0f, _menu_height + 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.8f);
+    if (ImGui::Begin("Netplay", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing))
+    {
+        if (stats.desynced)
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Desynced (different ROM or diverged state)");
+        else if (!stats.synchronized)
+            ImGui::Text("Waiting for peer...");
+        else
+            ImGui::Text("Connected");
+
+        ImGui::Text("Frame %u, remote confirmed %u", stats.frame, stats.remote_confirmed_frame);
+        ImGui::Text("Rollbacks: %u (%u frames resimulated, deepest %u)", stats.rollbacks, stats.resimulated_frames, stats.max_rollback_depth);
+        ImGui::Text("Last rollback: %.3f ms", stats.last_rollback_ms);
+        ImGui::Text("Stalls: %u", stats.stalls);
+        ImGui::Text("Packets: %u sent, %u received, %u dropped", stats.packets_sent, stats.packets_received, stats.packets_dropped);
+    }
+    ImGui::End();
+}
+
+void imgui_handler::draw_debugger(JChip8& chip8, debugger& dbg)
+{
+    if (!_show_debugger)
+    {
+        sync_debugger(chip8, dbg);
+        return;
+    }
+
+    ImGui::SetNextWindowSize(ImVec2(420.0f, 520.0f), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Debugger", &_show_debugger))
+    {
+        bool paused = chip8.state == emulator_state::paused;
+        bool can_step = paused && chip8.rom_loaded();
+
+        if (ImGui::Button(paused ? "Continue" : "Pause"))
+        {
+            if (paused)
+            {
+                dbg.resume(chip8.pc);
+                chip8.state = emulator_state::running;
+            }
+            else
+            {
+                chip8.state = emulator_state::paused;
+            }
+        }
+
+        ImGui::BeginDisabled(!can_step);
+        ImGui::SameLine();
+        if (ImGui::Button("Step"))
+        {
+            dbg.resume(chip8.pc);
+            chip8.emulate_cycle();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Step Over"))
+        {
+            // Only a call has anything to step over, everything else is a plain step
+            uint16 opcode = chip8.fetch_instruction().opcode;
+            dbg.resume(chip8.pc);
+            if ((opcode >> 12) == 0x2)
+            {
+                dbg.run_to_return(static_cast<uint16>(chip8.pc + 2), chip8.sp);
+                chip8.state = emulator_state::running;
+            }
+            else
+            {
+                chip8.emulate_cycle();
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Run to Cursor"))
+        {
+            dbg.resume(chip8.pc);
+            dbg.run_to(_debug_cursor);
+            chip8.state = emulator_state::running;
+        }
+        ImGui::EndDisabled();
+
+        if (!dbg.break_reason().empty())
+            ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "%s", dbg.break_reason().c_str());
+
+        ImGui::Separator();
+        for (uint8 i = 0; i < 16; ++i)
+        {
+            ImGui::Text("V%X: %02X", i, chip8.V[i]);
+            if ((i % 4) != 3) ImGui::SameLine(static_cast<float>((i % 4) + 1) * 80.0f);
+        }
+        ImGui::Text("PC: %03X  I: %03X  SP: %X  DT: %02X  ST: %02X", chip8.pc, chip8.I, chip8.sp, chip8.delay_timer, chip8.sound_timer);
+        ImGui::Separator();
+
+        // Disassembly around the PC.  The checkbox toggles a breakpoint, clicking a line moves the cursor
+        if (ImGui::BeginChild("##disassembly", ImVec2(0.0f, 200.0f), true))
+        {
+            int first = static_cast<int>(chip8.pc) - 16;
+            for (int address = first < 0 ? 0 : first; address < chip8.pc + 32 && address + 1 < MEMORY_SIZE; address += 2)
+            {
+                uint16 addr = static_cast<uint16>(address);
+                uint16 opcode = static_cast<uint16>(chip8.memory[addr] << 8 | chip8.memory[addr + 1]);
+                char line[64];
+                std::snprintf(line, sizeof(line), "%s %03X  %04X  %s", addr == chip8.pc ? ">" : " ", addr, opcode, disassemble(opcode).c_str());
+
+                ImGui::PushID(address);
+                bool breakpoint = dbg.has_breakpoint(addr);
+                if (ImGui::Checkbox("##bp", &breakpoint))
+                    dbg.toggle_breakpoint(addr);
+                ImGui::SameLine();
+                if (ImGui::Selectable(line, addr == _debug_cursor))
+                    _debug_cursor = addr;
+                ImGui::PopID();
+            }
+        }
+        ImGui::EndChild();
+
+        if (ImGui::CollapsingHeader("Watchpoints"))
+        {
+            ImGui::InputText("Start", _watch_start, sizeof(_watch_start), ImGuiInputTextFlags_CharsHexadecimal);
+            ImGui::InputText("End", _watch_end, sizeof(_watch_end), ImGuiInputTextFlags_CharsHexadecimal);
+            ImGui::Checkbox("Read", &_watch_read);
+            ImGui::SameLine();
+            ImGui::Checkbox("Write", &_watch_write);
+            ImGui::SameLine();
+            if (ImGui::Button("Add Watchpoint") && (_watch_read || _watch_write))
+            {
+                watchpoint watch;
+                watch.start = static_cast<uint16>(std::strtoul(_watch_start, nullptr, 16));
+                watch.end = static_cast<uint16>(std::strtoul(_watch_end, nullptr, 16));
+                watch.access = static_cast<uint8>((_watch_read ? WATCH_READ : 0) | (_watch_write ? WATCH_WRITE : 0));
+                dbg.add_watchpoint(watch);
+            }
+
+            for (size_t i = 0; i < dbg.watchpoints().size(); ++i)
+            {
+                const watchpoint& watch = dbg.watchpoints()[i];
+                ImGui::PushID(static_cast<int>(i));
+                bool remove = ImGui::Button("X");
+                ImGui::SameLine();
+                ImGui::Text("%03X-%03X %s%s", watch.start, watch.end, (watch.access & WATCH_READ) ? "R" : "", (watch.access & WATCH_WRITE) ? "W" : "");
+                ImGui::PopID();
+                if (remove)
+                {
+                    dbg.remove_watchpoint(i);
+                    break;
+                }
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Conditions"))
+        {
+            static const char* registers[] = { "V0", "V1", "V2", "V3", "V4", "V5", "V6", "V7",
+                                               "V8", "V9", "VA", "VB", "VC", "VD", "VE", "VF", "I" };
+            static const char* ops[] = { "==", "!=", "<", ">" };
+            ImGui::Combo("Register", &_condition_register, registers, 17);
+            ImGui::Combo("Compare", &_condition_op, ops, 4);
+            ImGui::InputText("Value", _condition_value, sizeof(_condition_value), ImGuiInputTextFlags_CharsHexadecimal);
+            if (ImGui::Button("Add Condition"))
+            {
+                register_condition condition;
+                condition.reg = static_cast<uint8>(_condition_register);
+                condition.op = static_cast<compare_op>(_condition_op);
+                condition.value = static_cast<uint16>(std::strtoul(_condition_value, nullptr, 16));
+                dbg.add_condition(condition);
+            }
+
+            for (size_t i = 0; i < dbg.conditions().size(); ++i)
+            {
+                const register_condition& condition = dbg.conditions()[i];
+                ImGui::PushID(static_cast<int>(i));
+                bool remove = ImGui::Button("X");
+                ImGui::SameLine();
+                ImGui::Text("%s %s %02X", registers[condition.reg], ops[static_cast<int>(condition.op)], condition.value);
+                ImGui::PopID();
+                if (remove)
+                {
+                    dbg.remove_condition(i);
+                    break;
+                }
+            }
+        }
+
+        if (ImGui::Button("Clear All"))
+            dbg.clear();
+    }
+    ImGui::End();
+
+    sync_debugger(chip8, dbg);
+}
+
+void imgui_handler::sync_debugger(JChip8& chip8, debugger& dbg) const
+{
+    // The instrumented engine only runs while the panel is open with something to check.  Attaching re-selects
+    // the engine and makes a recompiled ROM re-verify its code, so it only happens as a session starts or ends.
+    bool wanted = _show_debugger && dbg.active();
+    if (wanted != chip8.debugger_attached())
+        chip8.attach_debugger(wanted ? &dbg : nullptr);
+}
+
 void imgui_handler::end_frame()
 {
     ImGui::Render();
@@ -131,6 +453,13 @@ std::string imgui_handler::open_file_dialog() const
     }
 }
 
+std::string imgui_handler::save_recording_dialog() const
+{
+    // The recorder adds the extension for the chosen format, so the dialog only picks a base name
+    const char* selected_file = tinyfd_saveFileDialog("Save recording as", "recording", 0, nullptr, nullptr);
+    return selected_file ? std::string(selected_file) : std::string();
+}
+
 void imgui_handler::open_config_file(const char* filepath)
 {
 #if defined(_WIN32)
@@ -1,69 +1,650 @@
+#include "debugger.h"
 #include "emulator_config.h"
+#include "emulator_metrics.h"
+#include "grid_atlas.h"
 #include "imgui_handler.h"
 #include "jchip8.h"
+#include "metrics_server.h"
+#include "netplay.h"
+#include "perf_timer.h"
+#include "rewind_buffer.h"
+#include "run_ahead.h"
 #include "sdl2_handler.h"
+#include "trace_recorder.h"
 #include "typedefs.h"
+#include "video_recorder.h"
 #include "j_assembler.h"
+#include "source_watcher.h"
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 static constexpr uint32 WINDOW_WIDTH  = 640;
 static constexpr uint32 WINDOW_HEIGHT = 320;
+// Frames still drawn after input, since ImGui takes a couple to settle a click into its new layout
+static constexpr uint32 GUI_SETTLE_FRAMES = 3;
+// How often an unchanging screen is redrawn anyway, so live debugger values still move
+static constexpr uint32 IDLE_REFRESH_MS = 250;
+
+static uint64 ticks_to_ns(const sdl2_handler& sdl_handler, uint64 ticks)
+{
+    return static_cast<uint64>(static_cast<double>(ticks) * 1e9 / static_cast<double>(sdl_handler.performance_freq()));
+}
+
+// What is left of a 60 Hz frame that took ticks, in whole milliseconds for SDL_Delay
+static uint32 frame_delay_ms(const sdl2_handler& sdl_handler, uint64 ticks)
+{
+    const double frame_duration = 1000.0 / 60.0;
+    const double time_elapsed = static_cast<double>(ticks) * 1000.0 / static_cast<double>(sdl_handler.performance_freq());
+    return frame_duration > time_elapsed ? static_cast<uint32>(frame_duration - time_elapsed) : 0;
+}
+
+// Machines on a --grid wall, past which each cell is too small to see
+static constexpr uint32 MAX_GRID_CELLS = 256;
+
+// Simulated network conditions past this are no longer a game anyone could play
+static constexpr uint32 MAX_SIM_DELAY_MS = 10000;
+
+// A whole decimal argument from min to max; false on anything else, trailing text included
+static bool parse_uint32(std::string_view text, uint32 min, uint32 max, uint32& value)
+{
+    uint32 parsed = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), parsed);
+    if (error != std::errc{} || end != text.data() + text.size() || parsed < min || parsed > max)
+        return false;
+    value = parsed;
+    return true;
+}
+
+// From 1 to 65535, for instruction rates and ports
+static bool parse_uint16(std::string_view text, uint16& value)
+{
+    uint32 parsed = 0;
+    if (!parse_uint32(text, 1, UINT16_MAX, parsed))
+        return false;
+    value = static_cast<uint16>(parsed);
+    return true;
+}
+
+// Attract mode: a wall of machines running one ROM, each pressing random keys so they play differently.
+// The keyboard drives the top left machine, F1 pauses the wall and Escape quits.  Every screen is packed into
+// one texture atlas, so the whole wall is a single draw however many machines are on it.
+static int run_grid(sdl2_handler& sdl_handler, const imgui_handler& gui, const emulator_config& config,
+    const std::string& rom_path, uint32 columns, uint32 rows, emulator_metrics* metrics)
+{
+    std::vector<std::unique_ptr<JChip8>> machines;
+    for (uint32 i = 0; i < columns * rows; ++i)
+    {
+        machines.push_back(std::make_unique<JChip8>(config.instructions_per_second));
+        try
+        {
+            machines.back()->load_ROM(rom_path.c_str(), quirks_for_rom(config, rom_path));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Could not load " << rom_path << ": " << e.what() << '\n';
+            return 1;
+        }
+        machines.back()->seed_rng(i + 1);
+    }
+
+    grid_atlas atlas{ columns, rows, config.fg_color, config.bg_color };
+    sdl_handler.set_window_size(WINDOW_WIDTH, WINDOW_HEIGHT, 0);
+    sdl_handler.show_window();
+
+    JChip8& player = *machines[0];
+    uint32 random = 0x9E3779B9;
+    uint32 gui_frames = GUI_SETTLE_FRAMES;
+    while (player.state != emulator_state::quit)
+    {
+        // A paused wall only needs redrawing when something happens to the window
+        if (player.state != emulator_state::running && gui_frames == 0)
+            sdl_handler.wait_event(IDLE_REFRESH_MS);
+
+        uint64 before_frame = sdl_handler.time();
+        if (sdl_handler.handle_input(player, gui))
+            gui_frames = GUI_SETTLE_FRAMES;
+        if (player.state == emulator_state::quit)
+            break;
+
+        uint64 instructions_executed = 0;
+        if (player.state == emulator_state::running)
+        {
+            for (uint32 i = 0; i < machines.size(); ++i)
+            {
+                JChip8& machine = *machines[i];
+                if (i > 0)
+                {
+                    // A random key goes up or down every few frames on each machine
+                    random ^= random << 13;
+                    random ^= random >> 17;
+                    random ^= random << 5;
+                    if ((random & 7) == 0)
+                        machine.set_key(static_cast<uint8>((random >> 4) & 0xF), ((random >> 8) & 1) != 0);
+                }
+                instructions_executed += machine.run_frame();
+                atlas.update(i, machine);
+            }
+        }
+
+        if (gui_frames > 0 || !atlas.dirty_cells().empty())
+        {
+            uint64 before_draw = sdl_handler.time();
+            sdl_handler.clear_framebuffer();
+            sdl_handler.draw_grid(atlas);
+            uint64 before_present = sdl_handler.time();
+            sdl_handler.render();
+            if (metrics)
+            {
+                metrics->record_draw(ticks_to_ns(sdl_handler, before_present - before_draw));
+                metrics->record_present(ticks_to_ns(sdl_handler, sdl_handler.time() - before_present));
+            }
+            if (gui_frames > 0)
+                --gui_frames;
+        }
+
+        uint64 after_frame = sdl_handler.time();
+        if (metrics)
+            metrics->record_frame(instructions_executed, instructions_executed > 0, ticks_to_ns(sdl_handler, after_frame - before_frame));
+        sdl_handler.delay(frame_delay_ms(sdl_handler, after_frame - before_frame));
+    }
+
+    return 0;
+}
+
+// Re-assembles the sources --watch saw change and writes only the bytes that differ into the running machine,
+// so it carries on with its registers, timers and screen intact.  A project that didn't assemble at startup
+// is loaded by its first good save instead.  Errors are reported and the machine keeps the last good code.
+static void hot_reload(j_assembler& assembler, const std::vector<std::filesystem::path>& changed, JChip8& chip8,
+    const chip8_quirks& quirks, const sdl2_handler& sdl_handler)
+{
+    uint64 start = sdl_handler.time();
+    try
+    {
+        std::vector<memory_patch> patches = assembler.reassemble(changed);
+        size_t bytes = 0;
+        if (!chip8.rom_loaded())
+        {
+            chip8.load_ROM(assembler.image().data(), assembler.image().size(), quirks);
+            bytes = assembler.image().size();
+        }
+        else
+        {
+            for (const memory_patch& patch : patches)
+            {
+                chip8.patch_memory(patch.address, patch.bytes.data(), patch.bytes.size());
+                bytes += patch.bytes.size();
+            }
+        }
+        double ms = static_cast<double>(sdl_handler.time() - start) * 1000.0 / static_cast<double>(sdl_handler.performance_freq());
+        std::cout << "Reloaded " << bytes << " bytes in " << patches.size() << " patches, " << assembler.encoded_sources() << " of "
+                  << assembler.sources().size() << " sources encoded, " << std::fixed << std::setprecision(2) << ms << " ms\n";
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+}
 
 int main(int argc, char* argv[])
 {
+    startup_profile profile;
+    std::string rom_path;
+    std::string trace_path;
+    uint16 ips_override = 0;
+    bool print_startup_profile = false;
+    netplay_options net_options;
+    bool use_netplay = false;
+    uint32 grid_columns = 0;
+    uint32 grid_rows = 0;
+    std::vector<std::filesystem::path> watch_sources;
+    uint16 metrics_port = 0;
+    std::string metrics_socket;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--trace") == 0)
+        {
+            if (i + 1 >= argc || argv[i + 1][0] == '-')
+            {
+                std::cerr << "--trace needs a file to write, e.g. --trace trace.json\n";
+                return 1;
+            }
+            trace_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+            config::s_config_filepath = argv[++i];
+        else if (std::strcmp(argv[i], "--ips") == 0 && i + 1 < argc)
+        {
+            if (!parse_uint16(argv[++i], ips_override))
+            {
+                std::cerr << "--ips needs an instruction rate from 1 to 65535, got " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--startup-profile") == 0)
+            print_startup_profile = true;
+        else if (std::strcmp(argv[i], "--watch") == 0 && i + 1 < argc)
+            watch_sources.emplace_back(argv[++i]);
+        else if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc)
+        {
+            // --grid <columns>x<rows>
+            std::string_view size = argv[++i];
+            size_t x = size.find('x');
+            if (x == std::string_view::npos
+                || !parse_uint32(size.substr(0, x), 1, MAX_GRID_CELLS, grid_columns)
+                || !parse_uint32(size.substr(x + 1), 1, MAX_GRID_CELLS, grid_rows)
+                || grid_columns * grid_rows > MAX_GRID_CELLS)
+            {
+                std::cerr << "--grid needs <columns>x<rows> with at most " << MAX_GRID_CELLS << " machines, got " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--netplay") == 0 && i + 2 < argc)
+        {
+            // --netplay <local port> <peer host>:<peer port>
+            use_netplay = true;
+            std::string_view local = argv[++i];
+            std::string peer = argv[++i];
+            size_t colon = peer.rfind(':');
+            net_options.peer_host = colon == std::string::npos ? "127.0.0.1" : peer.substr(0, colon);
+            if (!parse_uint16(local, net_options.local_port)
+                || !parse_uint16(colon == std::string::npos ? peer : peer.substr(colon + 1), net_options.peer_port))
+            {
+                std::cerr << "Usage: --netplay <local port> <peer host>:<peer port>, with ports from 1 to 65535\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--netplay-delay") == 0 && i + 1 < argc)
+        {
+            if (!parse_uint32(argv[++i], 0, netplay_options::MAX_INPUT_DELAY, net_options.input_delay))
+            {
+                std::cerr << "--netplay-delay needs a frame count from 0 to " << netplay_options::MAX_INPUT_DELAY << '\n';
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--netplay-rollback") == 0 && i + 1 < argc)
+        {
+            if (!parse_uint32(argv[++i], 1, netplay_options::MAX_ROLLBACK, net_options.max_rollback))
+            {
+                std::cerr << "--netplay-rollback needs a frame count from 1 to " << netplay_options::MAX_ROLLBACK << '\n';
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--netplay-sim-latency") == 0 && i + 1 < argc)
+        {
+            if (!parse_uint32(argv[++i], 0, MAX_SIM_DELAY_MS, net_options.sim_latency_ms))
+            {
+                std::cerr << "--netplay-sim-latency needs milliseconds from 0 to " << MAX_SIM_DELAY_MS << '\n';
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--netplay-sim-jitter") == 0 && i + 1 < argc)
+        {
+            if (!parse_uint32(argv[++i], 0, MAX_SIM_DELAY_MS, net_options.sim_jitter_ms))
+            {
+                std::cerr << "--netplay-sim-jitter needs milliseconds from 0 to " << MAX_SIM_DELAY_MS << '\n';
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--netplay-sim-loss") == 0 && i + 1 < argc)
+        {
+            if (!parse_uint32(argv[++i], 0, 100, net_options.sim_loss_percent))
+            {
+                std::cerr << "--netplay-sim-loss needs a percentage from 0 to 100\n";
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+        {
+            if (!parse_uint16(argv[++i], metrics_port))
+            {
+                std::cerr << "--metrics needs a port from 1 to 65535, got " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (std::strcmp(argv[i], "--metrics-socket") == 0 && i + 1 < argc)
+            metrics_socket = argv[++i];
+        else if (argv[i][0] != '-')
+            rom_path = argv[i];
+    }
+
+    if (!trace_path.empty())
+        trace::start();
+
     emulator_config config = load_configuration_file();
+    if (ips_override > 0)
+        config.instructions_per_second = ips_override;
+    profile.mark("config");
 
-    sdl2_handler sdl_handler{ WINDOW_WIDTH, WINDOW_HEIGHT, config };
+    // Declared ahead of the server and the SDL handler, which read them from their own threads until they are destroyed
+    std::unique_ptr<emulator_metrics> metrics;
+    std::unique_ptr<metrics_server> metrics_endpoint;
+    sdl2_handler sdl_handler{ WINDOW_WIDTH, WINDOW_HEIGHT, config, &profile };
     imgui_handler gui{ sdl_handler };
+    profile.mark("ImGui");
+
+    if (metrics_port > 0 || !metrics_socket.empty())
+    {
+        metrics = std::make_unique<emulator_metrics>();
+        metrics->set_target_ips(config.instructions_per_second);
+        metrics->set_rom(watch_sources.empty() ? rom_path : watch_sources.front().string());
+        try
+        {
+            if (!metrics_socket.empty())
+                metrics_endpoint = std::make_unique<metrics_server>(*metrics, metrics_socket);
+            else
+                metrics_endpoint = std::make_unique<metrics_server>(*metrics, metrics_port);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+        sdl_handler.attach_metrics(metrics.get());
+    }
+
+    // Patching one machine would desync a netplay peer, and the grid's machines are all running one ROM file
+    if (!watch_sources.empty() && (use_netplay || grid_columns > 0))
+    {
+        std::cerr << "--watch can't be combined with --netplay or --grid\n";
+        return 1;
+    }
+    if (grid_columns > 0 && grid_rows > 0)
+    {
+        if (rom_path.empty())
+        {
+            std::cerr << "--grid needs a ROM to run\n";
+            return 1;
+        }
+        return run_grid(sdl_handler, gui, config, rom_path, grid_columns, grid_rows, metrics.get());
+    }
+
     JChip8 chip8{ config.instructions_per_second };
 
+    if (!rom_path.empty())
+    {
+        try
+        {
+            chip8.load_ROM(rom_path.c_str(), quirks_for_rom(config, rom_path));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Could not load " << rom_path << ": " << e.what() << '\n';
+            return 1;
+        }
+        profile.mark("ROM load");
+    }
+
+    // --watch assembles its sources in place of a ROM, quirks are looked up by the first source's name
+    j_assembler assembler;
+    source_watcher watcher;
+    // A copy, since a settings reload replaces config and the quirks it holds
+    const chip8_quirks watch_quirks = quirks_for_rom(config, watch_sources.empty() ? std::string() : watch_sources.front().string());
+    if (!watch_sources.empty())
+    {
+        for (const std::filesystem::path& source : watch_sources)
+        {
+            assembler.add_source(source);
+            watcher.watch(source);
+        }
+        try
+        {
+            const std::vector<uint8>& program = assembler.assemble();
+            chip8.load_ROM(program.data(), program.size(), watch_quirks);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+        }
+        profile.mark("assemble");
+    }
+
     uint16 menu_height = gui.get_window_height();
     sdl_handler.set_window_size(WINDOW_WIDTH, WINDOW_HEIGHT, menu_height);
     sdl_handler.show_window();
 
+    debugger dbg;
+    rewind_buffer rewind{ config.rewind_seconds * 60, static_cast<uint64>(config.rewind_memory_mb) * 1024 * 1024 };
+#ifdef JCHIP8_PERF_OVERLAY
+    perf_stats perf;
+#endif
+    run_ahead ahead;
+    video_recorder recorder;
+    std::unique_ptr<netplay_session> netplay;
+    if (use_netplay)
+    {
+        // A port already in use or a peer that doesn't resolve
+        try
+        {
+            netplay = std::make_unique<netplay_session>(net_options);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+        if (chip8.rom_loaded())
+            netplay->reset(chip8);
+    }
+    bool first_frame = true;
+    uint32 gui_frames = GUI_SETTLE_FRAMES;
+    uint64 last_present = sdl_handler.time();
+    const uint64 idle_refresh_ticks = sdl_handler.performance_freq() * IDLE_REFRESH_MS / 1000;
+
     while (chip8.state != emulator_state::quit)
     {
-        sdl_handler.clear_framebuffer();
-        sdl_handler.handle_input(chip8, gui);
+        // Paused or without a ROM there is nothing to emulate, so sleep until the user does something or the
+        // idle refresh is due, rather than polling sixty times a second
+        if ((!chip8.rom_loaded() || chip8.state != emulator_state::running) && gui_frames == 0)
+        {
+            JCHIP8_PERF_SCOPE(perf, perf_stage::sleep);
+            JCHIP8_TRACE_SCOPE("idle", "frontend");
+            sdl_handler.wait_event(IDLE_REFRESH_MS);
+        }
 
-        if (chip8.state == emulator_state::paused)
-            continue;
+        {
+            JCHIP8_PERF_SCOPE(perf, perf_stage::input);
+            JCHIP8_TRACE_SCOPE("input", "frontend");
+            if (sdl_handler.handle_input(chip8, gui))
+                gui_frames = GUI_SETTLE_FRAMES;
+        }
+
+        if (chip8.state == emulator_state::quit)
+            break;
+
+        if (!watch_sources.empty())
+        {
+            JCHIP8_TRACE_SCOPE("hot reload", "frontend");
+            std::vector<std::filesystem::path> changed = watcher.poll();
+            if (!changed.empty())
+            {
+                hot_reload(assembler, changed, chip8, watch_quirks, sdl_handler);
+                gui_frames = GUI_SETTLE_FRAMES;
+            }
+        }
 
         uint64 before_frame = sdl_handler.time();
+        uint16 instructions_executed = 0;
+        bool ran_frame = false;
+        // Only a frame where the machine drew, the GUI is reacting to input or the idle refresh is due gets presented
+        bool present = first_frame || gui_frames > 0 || before_frame - last_present >= idle_refresh_ticks;
 
+        // Pausing only stops the machine, the screen and GUI keep drawing so the debugger stays usable
         if (chip8.rom_loaded())
         {
-            uint16 instructions_per_frame = config.instructions_per_second / 60;
+            if (chip8.state == emulator_state::running && netplay)
+            {
+                // Rewinding would desync the peers, so netplay owns the machine state
+                JCHIP8_PERF_SCOPE(perf, perf_stage::emulation);
+                JCHIP8_TRACE_SCOPE("emulation", "frontend");
+                uint64 cycles_before = chip8.cycles();
+                netplay->advance(chip8, sdl_handler.local_keys(), [](JChip8& machine)
+                {
+                    machine.run_frame();
+                });
+                instructions_executed = static_cast<uint16>(chip8.cycles() - cycles_before);
+                sdl_handler.play_device(chip8.sound_active());
+            }
+            else if (chip8.state == emulator_state::running && sdl_handler.rewind_held())
+            {
+                // Rewinding replaces the machine state, but the keys held right now still count
+                JCHIP8_TRACE_SCOPE("rewind", "frontend");
+                uint16 keypad = chip8.keypad;
+                if (rewind.step_back(chip8))
+                    chip8.keypad = keypad;
+                sdl_handler.play_device(false);
+            }
+            else if (chip8.state == emulator_state::running)
+            {
+                JCHIP8_PERF_SCOPE(perf, perf_stage::emulation);
+                JCHIP8_TRACE_SCOPE("emulation", "frontend");
+                instructions_executed = chip8.run_frame();
+                sdl_handler.play_device(chip8.sound_active());
+                rewind.capture(chip8);
+                ran_frame = true;
+            }
+            // Recorded after rewinds too, so the video shows what the player saw
+            if (chip8.state == emulator_state::running)
+            {
+                sdl_handler.update_audio(chip8);
+                recorder.submit(chip8);
+            }
+            // Netplay and rewinding own the machine state, and a debugger would stop on speculative frames
+            if (ran_frame && config.run_ahead_frames > 0 && !chip8.debugger_attached())
+            {
+                JCHIP8_PERF_SCOPE(perf, perf_stage::run_ahead);
+                JCHIP8_TRACE_SCOPE("run-ahead", "frontend");
+                ahead.advance(chip8, config.run_ahead_frames);
+            }
+            present = present || chip8.draw_flag();
+            if (present)
+            {
+                JCHIP8_PERF_SCOPE(perf, perf_stage::draw);
+                JCHIP8_TRACE_SCOPE("draw", "frontend");
+                uint64 before_draw = sdl_handler.time();
+                sdl_handler.clear_framebuffer();
+                sdl_handler.draw_graphics(chip8);
+                if (metrics)
+                    metrics->record_draw(ticks_to_ns(sdl_handler, sdl_handler.time() - before_draw));
+            }
+            if (ahead.active())
+            {
+                JCHIP8_PERF_SCOPE(perf, perf_stage::run_ahead);
+                ahead.restore(chip8);
+            }
+            chip8.reset_draw_flag();
+        }
+        else if (present)
+        {
+            sdl_handler.clear_framebuffer();
+        }
 
-            for (uint16 i = 0; i < instructions_per_frame; ++i)
+        if (present)
+        {
+            JCHIP8_PERF_SCOPE(perf, perf_stage::gui);
+            JCHIP8_TRACE_SCOPE("gui", "frontend");
+            gui.begin_frame(sdl_handler);
+            gui.draw_gui(chip8, config, recorder.recording());
+            try
             {
-                chip8.emulate_cycle();
+                if (gui.requested_recording() == recording_request::start_gif)
+                    recorder.start(gui.recording_path(), recording_format::gif, config);
+                else if (gui.requested_recording() == recording_request::start_y4m_wav)
+                    recorder.start(gui.recording_path(), recording_format::y4m_wav, config);
+            }
+            catch (const std::exception& e)
+            {
+                // An unwritable path leaves the emulator running, just not recording
+                std::cerr << "Could not start recording to " << gui.recording_path() << ": " << e.what() << '\n';
+            }
+            if (gui.requested_recording() == recording_request::stop)
+                recorder.stop();
+            gui.draw_debugger(chip8, dbg);
+            if (gui.rom_changed())
+            {
+                // The Game menu loaded something else, which the sources being watched mustn't patch
+                watch_sources.clear();
+                if (metrics)
+                    metrics->set_rom(gui.rom_path());
+                rewind.clear();
+                if (netplay)
+                    netplay->reset(chip8);
+            }
+            if (netplay)
+                gui.draw_netplay_status(netplay->stats());
+#ifdef JCHIP8_PERF_OVERLAY
+            gui.draw_perf_overlay(perf, config.instructions_per_second, rewind.stats(), sdl_handler.input_latency(), ahead.stats());
+#endif
 
-                if ((chip8.current_instruction().opcode >> 12) == DRAW_INSTRUCTION)
-                    break;
+            if (gui.init_default_config())
+                create_default_config_file();
+            if (gui.reload_config())
+            {
+                config = load_configuration_file();
+                if (ips_override > 0)
+                    config.instructions_per_second = ips_override;
+                chip8.ips = config.instructions_per_second;
+                if (metrics)
+                    metrics->set_target_ips(config.instructions_per_second);
+                sdl_handler.reload_input_map();
             }
 
-            sdl_handler.draw_graphics(chip8);
-            chip8.update_timers(sdl_handler);
+            gui.end_frame();
+        }
+        if (present)
+        {
+            JCHIP8_PERF_SCOPE(perf, perf_stage::present);
+            JCHIP8_TRACE_SCOPE("present", "frontend");
+            uint64 before_present = sdl_handler.time();
+            sdl_handler.render();
+            last_present = sdl_handler.time();
+            if (metrics)
+                metrics->record_present(ticks_to_ns(sdl_handler, last_present - before_present));
+            if (gui_frames > 0)
+                --gui_frames;
+        }
+        if (first_frame)
+        {
+            // Anything not needed to get a frame on screen waits until one is
+            first_frame = false;
+            profile.mark("first frame");
+            sdl_handler.init_deferred();
+            profile.mark("deferred init");
+            if (print_startup_profile)
+                profile.report(std::cout);
         }
 
-        gui.begin_frame(sdl_handler);
-        gui.draw_gui(chip8);
-
-        if (gui.init_default_config())
-            create_default_config_file();
-        if (gui.reload_config())
+        uint64 after_frame = sdl_handler.time();
+        if (metrics)
+            metrics->record_frame(instructions_executed, ran_frame || instructions_executed > 0, ticks_to_ns(sdl_handler, after_frame - before_frame));
         {
-            config = load_configuration_file();
-            chip8.ips = config.instructions_per_second;
+            JCHIP8_PERF_SCOPE(perf, perf_stage::sleep);
+            JCHIP8_TRACE_SCOPE("sleep", "frontend");
+            sdl_handler.delay(frame_delay_ms(sdl_handler, after_frame - before_frame));
         }
 
-        gui.end_frame();
-        sdl_handler.render();
+        JCHIP8_PERF_END_FRAME(perf, instructions_executed);
+    }
 
-        uint64 after_frame = sdl_handler.time();
-        const double frame_duration = 1000.0 / 60.0;
-        const double time_elapsed = static_cast<double>((after_frame - before_frame) / 1000) / sdl_handler.performance_freq();
-        sdl_handler.delay(frame_duration > time_elapsed ? frame_duration - time_elapsed : 0);
+    if (!trace_path.empty())
+    {
+        trace::stop();
+        try
+        {
+            trace::write_json(trace_path);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Could not write " << trace_path << ": " << e.what() << '\n';
+            return 1;
+        }
     }
 
     return 0;
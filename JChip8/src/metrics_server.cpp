@@ -0,0 +1,234 @@
+#include "metrics_server.h"
+#include "emulator_metrics.h"
+#include "typedefs.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint32 ACCEPT_POLL_MS = 250;      // how long shutting down can take
+    constexpr uint32 CLIENT_TIMEOUT_MS = 1000;
+    constexpr size_t MAX_REQUEST = 8192;
+
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;    // a scraper hanging up mustn't raise SIGPIPE and end the emulator
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+}
+
+struct metrics_server::listener
+{
+#ifdef _WIN32
+    using handle = SOCKET;
+    using io_size = int;
+    static constexpr handle INVALID = INVALID_SOCKET;
+#else
+    using handle = int;
+    using io_size = size_t;
+    static constexpr handle INVALID = -1;
+#endif
+
+    handle fd = INVALID;
+    std::string unix_path;
+
+    explicit listener(uint16 port)
+    {
+        startup();
+        fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (fd == INVALID)
+        {
+            cleanup();
+            throw std::runtime_error("Could not create metrics socket");
+        }
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        // Loopback only; anything further away should scrape through a local agent
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        local.sin_port = htons(port);
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0 || listen(fd, 4) != 0)
+        {
+            close_handle(fd);
+            cleanup();
+            throw std::runtime_error("Could not listen for metrics on 127.0.0.1:" + std::to_string(port));
+        }
+    }
+
+    explicit listener(const std::string& path)
+    {
+#ifdef _WIN32
+        (void)path;
+        throw std::runtime_error("Metrics over a Unix domain socket aren't supported on Windows, use a port instead");
+#else
+        sockaddr_un local{};
+        if (path.empty() || path.size() >= sizeof(local.sun_path))
+            throw std::runtime_error("Metrics socket path is empty or too long: " + path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == INVALID)
+            throw std::runtime_error("Could not create metrics socket");
+
+        // A socket file left behind by an earlier run would make bind fail
+        unlink(path.c_str());
+        local.sun_family = AF_UNIX;
+        std::memcpy(local.sun_path, path.c_str(), path.size());
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0 || listen(fd, 4) != 0)
+        {
+            close_handle(fd);
+            throw std::runtime_error("Could not listen for metrics on " + path);
+        }
+        unix_path = path;
+#endif
+    }
+
+    ~listener()
+    {
+        close_handle(fd);
+#ifndef _WIN32
+        if (!unix_path.empty())
+            unlink(unix_path.c_str());
+#endif
+        cleanup();
+    }
+
+    static void startup()
+    {
+#ifdef _WIN32
+        WSADATA wsa_data;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+            throw std::runtime_error("Could not initialize Winsock");
+#endif
+    }
+
+    static void cleanup()
+    {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    static void close_handle(handle& h)
+    {
+        if (h == INVALID)
+            return;
+#ifdef _WIN32
+        closesocket(h);
+#else
+        close(h);
+#endif
+        h = INVALID;
+    }
+
+    static void set_timeouts(handle h)
+    {
+#ifdef _WIN32
+        DWORD timeout = CLIENT_TIMEOUT_MS;
+#else
+        timeval timeout{ CLIENT_TIMEOUT_MS / 1000, 0 };
+#endif
+        setsockopt(h, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+        setsockopt(h, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+
+    // Waits up to timeout_ms for a client, so the serving thread still notices when it should stop
+    handle accept_client(uint32 timeout_ms) const
+    {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        timeval timeout{ 0, static_cast<decltype(timeval::tv_usec)>(timeout_ms * 1000) };
+        if (select(static_cast<int>(fd + 1), &readable, nullptr, nullptr, &timeout) <= 0)
+            return INVALID;
+        return accept(fd, nullptr, nullptr);
+    }
+
+    static void serve(handle client, const emulator_metrics& metrics)
+    {
+        set_timeouts(client);
+
+        // The request itself doesn't matter, every path gets the metrics, but it's read through to the
+        // blank line so the client doesn't see its connection reset while still sending
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST)
+        {
+            auto received = recv(client, buffer, static_cast<io_size>(sizeof(buffer)), 0);
+            if (received <= 0)
+                break;
+            request.append(buffer, static_cast<size_t>(received));
+        }
+
+        std::string body = metrics.format();
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: "
+            + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            auto written = send(client, response.data() + sent, static_cast<io_size>(response.size() - sent), SEND_FLAGS);
+            if (written <= 0)
+                break;
+            sent += static_cast<size_t>(written);
+        }
+    }
+};
+
+metrics_server::metrics_server(const emulator_metrics& metrics, uint16 port)
+    : _metrics(metrics)
+    , _listener(std::make_unique<listener>(port))
+    , _stopping(false)
+    , _scrapes(0)
+{
+    _thread = std::thread(&metrics_server::serve_loop, this);
+}
+
+metrics_server::metrics_server(const emulator_metrics& metrics, const std::string& socket_path)
+    : _metrics(metrics)
+    , _listener(std::make_unique<listener>(socket_path))
+    , _stopping(false)
+    , _scrapes(0)
+{
+    _thread = std::thread(&metrics_server::serve_loop, this);
+}
+
+metrics_server::~metrics_server()
+{
+    _stopping.store(true, std::memory_order_release);
+    _thread.join();
+}
+
+uint64 metrics_server::scrapes() const noexcept
+{
+    return _scrapes.load(std::memory_order_relaxed);
+}
+
+void metrics_server::serve_loop()
+{
+    while (!_stopping.load(std::memory_order_acquire))
+    {
+        listener::handle client = _listener->accept_client(ACCEPT_POLL_MS);
+        if (client == listener::INVALID)
+            continue;
+
+        listener::serve(client, _metrics);
+        listener::close_handle(client);
+        _scrapes.fetch_add(1, std::memory_order_relaxed);
+    }
+}
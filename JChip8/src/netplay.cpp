@@ -0,0 +1,445 @@
+#include "netplay.h"
+#include "jchip8.h"
+#include "trace_recorder.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint32 PACKET_MAGIC = 0x504E384A; // "J8NP"
+    constexpr uint8 PACKET_HELLO = 1;
+    constexpr uint8 PACKET_INPUT = 2;
+
+    void put_u32(std::vector<uint8>& out, uint32 value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back(static_cast<uint8>(value >> (i * 8)));
+    }
+
+    void put_u16(std::vector<uint8>& out, uint16 value)
+    {
+        out.push_back(static_cast<uint8>(value));
+        out.push_back(static_cast<uint8>(value >> 8));
+    }
+
+    uint32 get_u32(const uint8* in)
+    {
+        return static_cast<uint32>(in[0]) | static_cast<uint32>(in[1]) << 8
+            | static_cast<uint32>(in[2]) << 16 | static_cast<uint32>(in[3]) << 24;
+    }
+
+    uint16 get_u16(const uint8* in)
+    {
+        return static_cast<uint16>(in[0] | in[1] << 8);
+    }
+
+    uint32 fnv1a(const uint8* data, size_t size, uint32 hash = 2166136261u)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= data[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+}
+
+struct netplay_session::udp_socket
+{
+#ifdef _WIN32
+    using handle = SOCKET;
+    static constexpr handle INVALID = INVALID_SOCKET;
+#else
+    using handle = int;
+    static constexpr handle INVALID = -1;
+#endif
+
+    handle fd = INVALID;
+    sockaddr_in peer{};
+
+    udp_socket(uint16 local_port, const std::string& peer_host, uint16 peer_port)
+    {
+#ifdef _WIN32
+        WSADATA wsa_data;
+        if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+            throw std::runtime_error("Could not initialize Winsock");
+#endif
+        fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (fd == INVALID)
+            throw std::runtime_error("Could not create netplay socket");
+
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons(local_port);
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) != 0)
+        {
+            close_handle();
+            throw std::runtime_error("Could not bind netplay port " + std::to_string(local_port));
+        }
+
+#ifdef _WIN32
+        u_long non_blocking = 1;
+        ioctlsocket(fd, FIONBIO, &non_blocking);
+#else
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(peer_host.c_str(), nullptr, &hints, &result) != 0 || !result)
+        {
+            close_handle();
+            throw std::runtime_error("Could not resolve netplay peer " + peer_host);
+        }
+        std::memcpy(&peer, result->ai_addr, sizeof(peer));
+        peer.sin_port = htons(peer_port);
+        freeaddrinfo(result);
+    }
+
+    ~udp_socket()
+    {
+        close_handle();
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    void close_handle()
+    {
+        if (fd == INVALID)
+            return;
+#ifdef _WIN32
+        closesocket(fd);
+#else
+        close(fd);
+#endif
+        fd = INVALID;
+    }
+
+    void send(const std::vector<uint8>& bytes) const
+    {
+        sendto(fd, reinterpret_cast<const char*>(bytes.data()), static_cast<int>(bytes.size()), 0,
+            reinterpret_cast<const sockaddr*>(&peer), sizeof(peer));
+    }
+
+    // Returns the size of the next waiting datagram, or 0 once there are none left
+    size_t receive(uint8* buffer, size_t capacity) const
+    {
+        auto received = recvfrom(fd, reinterpret_cast<char*>(buffer), static_cast<int>(capacity), 0, nullptr, nullptr);
+        return received > 0 ? static_cast<size_t>(received) : 0;
+    }
+};
+
+netplay_session::netplay_session(const netplay_options& options)
+    : _options(options)
+    , _socket(std::make_unique<udp_socket>(options.local_port, options.peer_host, options.peer_port))
+    , _stats()
+    , _rom_hash(0)
+    , _peer_seen(false)
+    , _peer_has_seen_us(false)
+    , _frame(0)
+    , _local_count(0)
+    , _remote_confirmed(0)
+    , _peer_acked(0)
+    , _local_inputs()
+    , _remote_inputs()
+    , _remote_used()
+    , _snapshots()
+    , _last_remote_input(0)
+    , _last_checksum()
+    , _checksums()
+    , _outgoing()
+    , _loss_rng(options.local_port)
+{
+    _options.input_delay = std::min(_options.input_delay, netplay_options::MAX_INPUT_DELAY);
+    _options.max_rollback = std::clamp<uint32>(_options.max_rollback, 1, netplay_options::MAX_ROLLBACK);
+}
+
+netplay_session::~netplay_session() = default;
+
+void netplay_session::reset(JChip8& chip8)
+{
+    // Both peers must start from the same machine, including the random number generator, so the seed
+    // comes from the ROM itself.  The hash is also checked during the handshake.
+    machine_state state;
+    chip8.capture_state(state);
+    _rom_hash = fnv1a(state.memory + 0x200, sizeof(state.memory) - 0x200);
+    chip8.seed_rng(_rom_hash);
+
+    _stats = netplay_stats{};
+    _peer_seen = false;
+    _peer_has_seen_us = false;
+    _frame = 0;
+
+    // The first input_delay frames have no input from anyone, so both sides already agree on them
+    _local_count = _options.input_delay;
+    _remote_confirmed = _options.input_delay;
+    _peer_acked = _options.input_delay;
+    _local_inputs.fill(0);
+    _remote_inputs.fill(0);
+    _remote_used.fill(0);
+    _last_remote_input = 0;
+    _last_checksum = checksum_record{};
+    _checksums.fill(checksum_record{ 0xFFFFFFFF, 0 });
+}
+
+void netplay_session::advance(JChip8& chip8, uint16 local_keys, const frame_fn& run_frame)
+{
+    JCHIP8_TRACE_SCOPE("netplay", "netplay");
+    flush_outgoing();
+
+    uint32 rollback_to = _frame;
+    receive(chip8, rollback_to);
+
+    if (!_stats.synchronized)
+    {
+        send_hello();
+        flush_outgoing();
+        return;
+    }
+
+    if (rollback_to < _frame)
+    {
+        JCHIP8_TRACE_SCOPE("rollback", "netplay");
+        auto start = std::chrono::steady_clock::now();
+        uint32 depth = _frame - rollback_to;
+        // Hooks already saw these frames as they were first played, so the replay doesn't report them twice
+        const chip8_hooks* hooks = chip8.hooks();
+        chip8.attach_hooks(nullptr);
+        chip8.restore_state(_snapshots[rollback_to % SNAPSHOT_COUNT]);
+        for (uint32 frame = rollback_to; frame < _frame; ++frame)
+            simulate(chip8, frame, run_frame);
+        chip8.attach_hooks(hooks);
+
+        ++_stats.rollbacks;
+        _stats.resimulated_frames += depth;
+        _stats.max_rollback_depth = std::max(_stats.max_rollback_depth, depth);
+        _stats.last_rollback_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    update_checksums();
+
+    // Running further ahead than the rollback window would mean a misprediction could need a snapshot
+    // that no longer exists, so wait for the peer instead
+    bool too_far_ahead = _frame >= _remote_confirmed + _options.max_rollback;
+    bool too_much_unacked = _local_count - _peer_acked >= INPUT_WINDOW / 2;
+    if (too_far_ahead || too_much_unacked)
+    {
+        ++_stats.stalls;
+        send_inputs();
+        flush_outgoing();
+        return;
+    }
+
+    _local_inputs[_local_count % INPUT_WINDOW] = local_keys;
+    ++_local_count;
+
+    simulate(chip8, _frame, run_frame);
+    ++_frame;
+
+    send_inputs();
+    flush_outgoing();
+
+    _stats.frame = _frame;
+    _stats.remote_confirmed_frame = _remote_confirmed;
+}
+
+const netplay_stats& netplay_session::stats() const noexcept
+{
+    return _stats;
+}
+
+void netplay_session::simulate(JChip8& chip8, uint32 frame, const frame_fn& run_frame)
+{
+    chip8.capture_state(_snapshots[frame % SNAPSHOT_COUNT]);
+
+    uint16 remote = remote_input_for(frame);
+    _remote_used[frame % INPUT_WINDOW] = remote;
+    uint16 keys = static_cast<uint16>(_local_inputs[frame % INPUT_WINDOW] | remote);
+    // Only the exchanged inputs may touch the keypad, or the peers would see different games
+    chip8.clear_input_queue();
+    chip8.keypad = keys;
+
+    run_frame(chip8);
+}
+
+uint16 netplay_session::remote_input_for(uint32 frame) const noexcept
+{
+    // Players tend to hold keys for many frames at a time, so the best guess is whatever they held last
+    return frame < _remote_confirmed ? _remote_inputs[frame % INPUT_WINDOW] : _last_remote_input;
+}
+
+void netplay_session::receive(JChip8& chip8, uint32& rollback_to)
+{
+    uint8 buffer[1024];
+    size_t size;
+    while ((size = _socket->receive(buffer, sizeof(buffer))) > 0)
+    {
+        if (size < 5 || get_u32(buffer) != PACKET_MAGIC)
+            continue;
+        ++_stats.packets_received;
+
+        if (buffer[4] == PACKET_HELLO && size >= 10)
+        {
+            if (get_u32(buffer + 5) != _rom_hash)
+            {
+                _stats.desynced = true;
+                continue;
+            }
+            _peer_seen = true;
+            _peer_has_seen_us |= buffer[9] != 0;
+            // The peer is still waiting on us, so answer even once synchronized
+            if (_stats.synchronized)
+                send_hello();
+        }
+        else if (buffer[4] == PACKET_INPUT && size >= 22)
+        {
+            // An input packet means the peer finished its handshake, so ours is done too
+            _peer_seen = true;
+            _peer_has_seen_us = true;
+
+            uint32 ack = get_u32(buffer + 5);
+            uint32 first = get_u32(buffer + 9);
+            uint8 count = buffer[13];
+            uint32 checksum_frame = get_u32(buffer + 14);
+            uint32 checksum = get_u32(buffer + 18);
+            if (size < 22 + static_cast<size_t>(count) * 2)
+                continue;
+
+            if (ack > _peer_acked && ack <= _local_count)
+                _peer_acked = ack;
+
+            for (uint32 i = 0; i < count; ++i)
+            {
+                uint32 frame = first + i;
+                if (frame < _remote_confirmed)
+                    continue;
+                if (frame > _remote_confirmed || frame >= _frame + INPUT_WINDOW / 2)
+                    break;
+
+                uint16 input = get_u16(buffer + 22 + i * 2);
+                _remote_inputs[frame % INPUT_WINDOW] = input;
+                ++_remote_confirmed;
+                _last_remote_input = input;
+                if (frame < _frame && _remote_used[frame % INPUT_WINDOW] != input)
+                    rollback_to = std::min(rollback_to, frame);
+            }
+
+            const checksum_record& local = _checksums[(checksum_frame / CHECKSUM_INTERVAL) % _checksums.size()];
+            if (checksum_frame != 0 && local.frame == checksum_frame && local.checksum != checksum)
+                _stats.desynced = true;
+        }
+    }
+
+    if (!_stats.synchronized && _peer_seen && _peer_has_seen_us)
+    {
+        _stats.synchronized = true;
+        chip8.reset_draw_flag();
+    }
+}
+
+void netplay_session::update_checksums()
+{
+    // A snapshot is final once every input before it is confirmed.  Only the newest confirmed
+    // checkpoint is sent, older ones are kept so a slow peer can still compare against them.
+    uint32 next = _last_checksum.frame + CHECKSUM_INTERVAL;
+    while (next < _frame && next <= _remote_confirmed && _frame - next < SNAPSHOT_COUNT)
+    {
+        machine_state state = _snapshots[next % SNAPSHOT_COUNT];
+        // The frontend writes these between frames, so they aren't part of the simulation
+        state.draw_flag = false;
+        state.keys = 0;
+
+        _last_checksum = checksum_record{ next, state_checksum(state) };
+        _checksums[(next / CHECKSUM_INTERVAL) % _checksums.size()] = _last_checksum;
+        next += CHECKSUM_INTERVAL;
+    }
+}
+
+uint32 netplay_session::state_checksum(const machine_state& state) noexcept
+{
+    return fnv1a(reinterpret_cast<const uint8*>(&state), sizeof(state));
+}
+
+void netplay_session::send_hello()
+{
+    std::vector<uint8> packet;
+    put_u32(packet, PACKET_MAGIC);
+    packet.push_back(PACKET_HELLO);
+    put_u32(packet, _rom_hash);
+    packet.push_back(_peer_seen ? 1 : 0);
+    queue_packet(std::move(packet));
+}
+
+void netplay_session::send_inputs()
+{
+    // Every input the peer hasn't acknowledged goes in every packet, so losing one only costs time
+    uint32 count = std::min<uint32>(_local_count - _peer_acked, 255);
+
+    std::vector<uint8> packet;
+    packet.reserve(22 + count * 2);
+    put_u32(packet, PACKET_MAGIC);
+    packet.push_back(PACKET_INPUT);
+    put_u32(packet, _remote_confirmed);
+    put_u32(packet, _peer_acked);
+    packet.push_back(static_cast<uint8>(count));
+    put_u32(packet, _last_checksum.frame);
+    put_u32(packet, _last_checksum.checksum);
+    for (uint32 i = 0; i < count; ++i)
+        put_u16(packet, _local_inputs[(_peer_acked + i) % INPUT_WINDOW]);
+    queue_packet(std::move(packet));
+}
+
+void netplay_session::queue_packet(std::vector<uint8> bytes)
+{
+    if (_options.sim_loss_percent > 0 && _loss_rng() % 100 < _options.sim_loss_percent)
+    {
+        ++_stats.packets_dropped;
+        return;
+    }
+
+    uint32 delay_ms = _options.sim_latency_ms;
+    if (_options.sim_jitter_ms > 0)
+        delay_ms += static_cast<uint32>(_loss_rng() % (_options.sim_jitter_ms + 1));
+
+    _outgoing.push_back(pending_packet{ std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms), std::move(bytes) });
+}
+
+void netplay_session::flush_outgoing()
+{
+    // Jitter can release packets out of order, which is exactly what a real network does too
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = _outgoing.begin(); it != _outgoing.end();)
+    {
+        if (it->release <= now)
+        {
+            _socket->send(it->bytes);
+            ++_stats.packets_sent;
+            it = _outgoing.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,147 @@
+#include "perf_timer.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+
+perf_stats::perf_stats()
+    : _stage_ms{ }
+    , _current_ms{ }
+    , _frame_ms{ }
+    , _instructions{ }
+    , _index{ 0 }
+    , _frames_recorded{ 0 }
+    , _last_frame_end{ clock::now() }
+{
+
+}
+
+void perf_stats::record(perf_stage stage, float ms) noexcept
+{
+    // A stage can be timed more than once per frame, so accumulate until the frame ends
+    _current_ms[static_cast<uint32>(stage)] += ms;
+}
+
+void perf_stats::end_frame(uint32 instructions_executed) noexcept
+{
+    clock::time_point now = clock::now();
+    std::chrono::duration<float, std::milli> frame_time = now - _last_frame_end;
+    _last_frame_end = now;
+
+    for (uint32 stage = 0; stage < STAGE_COUNT; ++stage)
+    {
+        _stage_ms[stage][_index] = _current_ms[stage];
+        _current_ms[stage] = 0.0f;
+    }
+
+    _frame_ms[_index] = frame_time.count();
+    _instructions[_index] = instructions_executed;
+    _index = (_index + 1) % FRAME_HISTORY;
+    _frames_recorded = std::min(_frames_recorded + 1, FRAME_HISTORY);
+}
+
+perf_summary perf_stats::summarize(perf_stage stage) const
+{
+    return summarize_samples(_stage_ms[static_cast<uint32>(stage)].data());
+}
+
+perf_summary perf_stats::summarize_frame() const
+{
+    return summarize_samples(_frame_ms.data());
+}
+
+double perf_stats::achieved_ips() const noexcept
+{
+    double total_ms = 0.0;
+    uint64 total_instructions = 0;
+    for (uint32 i = 0; i < _frames_recorded; ++i)
+    {
+        total_ms += _frame_ms[i];
+        total_instructions += _instructions[i];
+    }
+
+    return total_ms > 0.0 ? static_cast<double>(total_instructions) / (total_ms / 1000.0) : 0.0;
+}
+
+uint32 perf_stats::last_instructions() const noexcept
+{
+    return _instructions[(_index + FRAME_HISTORY - 1) % FRAME_HISTORY];
+}
+
+const float* perf_stats::frame_times() const noexcept { return _frame_ms.data(); }
+uint32 perf_stats::frame_offset() const noexcept { return _index; }
+uint32 perf_stats::frames_recorded() const noexcept { return _frames_recorded; }
+
+const char* perf_stats::stage_name(perf_stage stage) noexcept
+{
+    switch (stage)
+    {
+        case perf_stage::input:     return "Input";
+        case perf_stage::emulation: return "Emulation";
+        case perf_stage::run_ahead: return "Run-ahead";
+        case perf_stage::draw:      return "Draw";
+        case perf_stage::gui:       return "GUI";
+        case perf_stage::present:   return "Present";
+        case perf_stage::sleep:     return "Sleep";
+        default:                    return "Unknown";
+    }
+}
+
+perf_summary perf_stats::summarize_samples(const float* samples) const
+{
+    if (_frames_recorded == 0)
+        return perf_summary{ 0.0f, 0.0f, 0.0f };
+
+    std::array<float, FRAME_HISTORY> sorted;
+    std::copy(samples, samples + _frames_recorded, sorted.begin());
+    std::sort(sorted.begin(), sorted.begin() + _frames_recorded);
+
+    float total = 0.0f;
+    for (uint32 i = 0; i < _frames_recorded; ++i)
+        total += sorted[i];
+
+    uint32 p99_index = std::min(_frames_recorded - 1, (_frames_recorded * 99) / 100);
+    return perf_summary{ sorted[0], total / static_cast<float>(_frames_recorded), sorted[p99_index] };
+}
+
+scoped_perf_timer::scoped_perf_timer(perf_stats& stats, perf_stage stage) noexcept
+    : _stats(stats)
+    , _stage(stage)
+    , _start(std::chrono::steady_clock::now())
+{
+
+}
+
+scoped_perf_timer::~scoped_perf_timer()
+{
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - _start;
+    _stats.record(_stage, elapsed.count());
+}
+
+startup_profile::startup_profile()
+    : _stages()
+    , _start(clock::now())
+    , _last(_start)
+{
+
+}
+
+void startup_profile::mark(const char* stage)
+{
+    clock::time_point now = clock::now();
+    _stages.emplace_back(stage, std::chrono::duration<double, std::milli>(now - _last).count());
+    _last = now;
+}
+
+void startup_profile::report(std::ostream& out) const
+{
+    std::ios_base::fmtflags flags = out.flags();
+    out << "Startup profile:\n" << std::fixed << std::setprecision(2);
+    for (const auto& [stage, ms] : _stages)
+        out << "  " << std::left << std::setw(24) << stage << std::right << std::setw(9) << ms << " ms\n";
+    out << "  " << std::left << std::setw(24) << "total" << std::right << std::setw(9)
+        << std::chrono::duration<double, std::milli>(_last - _start).count() << " ms\n";
+    out.flags(flags);
+}
@@ -1,26 +1,103 @@
 #include "sdl2_handler.h"
 #include "emulator_config.h"
+#include "emulator_metrics.h"
+#include "grid_atlas.h"
 #include "imgui_handler.h"
-#include "JChip8.h"
+#include "jchip8.h"
+#include "perf_timer.h"
 #include "typedefs.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-sdl2_handler::sdl2_handler(uint32 window_width, uint32 window_height, const emulator_config& config)
+namespace
+{
+    constexpr uint8 SOURCE_KEYBOARD = 1 << 0;
+    constexpr uint8 SOURCE_GAMEPAD  = 1 << 1;
+
+    bool parse_chip8_key(const std::string& value, uint8& key)
+    {
+        char* end = nullptr;
+        unsigned long parsed = std::strtoul(value.c_str(), &end, 16);
+        if (value.empty() || *end != '\0' || parsed > 0xF)
+            return false;
+
+        key = static_cast<uint8>(parsed);
+        return true;
+    }
+}
+
+float input_stats::avg_ms() const noexcept
+{
+    if (latency_count == 0)
+        return 0.0f;
+
+    float total = 0.0f;
+    for (uint32 i = 0; i < latency_count; ++i)
+        total += latencies_ms[i];
+    return total / static_cast<float>(latency_count);
+}
+
+float input_stats::max_ms() const noexcept
+{
+    float highest = 0.0f;
+    for (uint32 i = 0; i < latency_count; ++i)
+        highest = std::max(highest, latencies_ms[i]);
+    return highest;
+}
+
+sdl2_handler::sdl2_handler(uint32 window_width, uint32 window_height, const emulator_config& config, startup_profile* profile)
     : _window(nullptr)
     , _renderer(nullptr)
+    , _grid_texture(nullptr)
+    , _grid_texture_width(0)
+    , _grid_texture_height(0)
+    , _want()
+    , _have()
+    , _audio_device(0)
+    , _audio_unavailable(false)
+    , _audio_playing(false)
+    , _last_callback(0)
+    , _metrics(nullptr)
+    , _deferred_init_done(false)
     , _window_width(window_width)
     , _window_height(window_height)
     , _window_scale(2.0f)
     , _menu_height()
+    , _rewind_held(false)
+    , _local_keys(0)
+    , _key_map()
+    , _button_map()
+    , _gamepad(nullptr)
+    , _key_sources{ 0 }
+    , _press_cycle{ 0 }
+    , _poll_first_ticks(0)
+    , _poll_base_cycle(0)
+    , _poll_started(false)
+    , _input_stats()
     , _config(config)
+    , _synth(config.frequency, config.volume)
+    , _tone_pattern{ 0 }
+    , _tone_pitch(0)
+    , _tone_pattern_loaded(false)
+    , _tone_frequency(config.wave_frequency)
+    , _tone_volume(config.volume)
 {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_EVENTS) < 0)
+    _synth.set_square(config.wave_frequency);
+
+    // Only what the first frame needs starts here.  Audio opens the first time a ROM beeps, and the
+    // icon and game controllers wait until that first frame is on screen (init_deferred).
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_EVENTS) < 0)
     {
         std::cerr << "SDL could not initialize! SDL_Error: " << SDL_GetError() << '\n';
         exit(1);
     }
+    if (profile) profile->mark("SDL init");
+
+    reload_input_map();
 
     _window = SDL_CreateWindow("JChip8",
         SDL_WINDOWPOS_UNDEFINED,
@@ -34,11 +111,7 @@ sdl2_handler::sdl2_handler(uint32 window_width, uint32 window_height, const emul
         std::cerr << "Window could not be created! SDL_Error: " << SDL_GetError() << '\n';
         exit(1);
     }
-
-    SDL_Surface* icon = IMG_Load("assets/icon.png");
-    if (icon) SDL_SetWindowIcon(_window, icon);
-
-    SDL_FreeSurface(icon);
+    if (profile) profile->mark("window");
 
     _renderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     if (!_renderer)
@@ -46,33 +119,19 @@ sdl2_handler::sdl2_handler(uint32 window_width, uint32 window_height, const emul
         std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << '\n';
         exit(1);
     }
-
-    _want.freq = config.frequency;
-    _want.format = AUDIO_S16LSB;
-    _want.channels = 1;
-    _want.samples = 4096;
-    _want.callback = audio_callback;
-    _want.userdata = (void*)&config;
-
-    _audio_device = SDL_OpenAudioDevice(nullptr, 0, &_want, &_have, 0);
-    if (!_audio_device)
-    {
-        std::cerr << "Audio device could not be created! SDL_Error: " << SDL_GetError() << '\n';
-        exit(1);
-    }
-
-    if (_want.freq != _have.freq)
-    {
-        std::cerr << "Audio frequency requested in config is not available: " << SDL_GetError() << '\n';
-        exit(1);
-    }
+    if (profile) profile->mark("renderer");
 }
 
 sdl2_handler::~sdl2_handler()
 {
+    if (_grid_texture)
+        SDL_DestroyTexture(_grid_texture);
     SDL_DestroyRenderer(_renderer);
     SDL_DestroyWindow(_window);
-    SDL_CloseAudioDevice(_audio_device);
+    if (_audio_device)
+        SDL_CloseAudioDevice(_audio_device);
+    if (_gamepad)
+        SDL_GameControllerClose(_gamepad);
     SDL_Quit();
 }
 
@@ -91,6 +150,12 @@ void sdl2_handler::delay(uint32 time_ms) const noexcept
     SDL_Delay(time_ms);
 }
 
+bool sdl2_handler::wait_event(uint32 timeout_ms) const noexcept
+{
+    // Sleeps in the OS until an event arrives, leaving it queued for handle_input
+    return SDL_WaitEventTimeout(nullptr, static_cast<int>(timeout_ms)) != 0;
+}
+
 SDL_Window* sdl2_handler::window() const noexcept { return _window; }
 SDL_Renderer* sdl2_handler::renderer() const noexcept { return _renderer; }
 
@@ -133,16 +198,68 @@ void sdl2_handler::draw_graphics(JChip8& chip8)
     }
 }
 
+void sdl2_handler::draw_grid(grid_atlas& atlas)
+{
+    if (!_grid_texture || _grid_texture_width != atlas.width() || _grid_texture_height != atlas.height())
+    {
+        if (_grid_texture)
+            SDL_DestroyTexture(_grid_texture);
+
+        _grid_texture = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+            static_cast<int>(atlas.width()), static_cast<int>(atlas.height()));
+        if (!_grid_texture)
+        {
+            std::cerr << "Grid texture could not be created! SDL_Error: " << SDL_GetError() << '\n';
+            return;
+        }
+        SDL_SetTextureScaleMode(_grid_texture, SDL_ScaleModeNearest);
+        _grid_texture_width = atlas.width();
+        _grid_texture_height = atlas.height();
+        SDL_UpdateTexture(_grid_texture, nullptr, atlas.pixels(), static_cast<int>(atlas.pitch()));
+        atlas.clear_dirty();
+    }
+
+    // Uploads follow what changed: one call per redrawn cell, or the whole atlas once most of them have
+    const std::vector<uint32>& dirty = atlas.dirty_cells();
+    if (dirty.size() * 2 > atlas.cells())
+    {
+        SDL_UpdateTexture(_grid_texture, nullptr, atlas.pixels(), static_cast<int>(atlas.pitch()));
+    }
+    else
+    {
+        for (uint32 cell : dirty)
+        {
+            uint32 x = 0;
+            uint32 y = 0;
+            atlas.cell_origin(cell, x, y);
+            SDL_Rect rect{ static_cast<int>(x), static_cast<int>(y), GRAPHICS_WIDTH, GRAPHICS_HEIGHT };
+            SDL_UpdateTexture(_grid_texture, &rect, atlas.cell_pixels(cell), static_cast<int>(atlas.pitch()));
+        }
+    }
+    atlas.clear_dirty();
+
+    SDL_Rect area{ 0, static_cast<int>(_menu_height),
+        static_cast<int>(_window_width * _window_scale), static_cast<int>(_window_height * _window_scale) };
+    SDL_RenderCopy(_renderer, _grid_texture, nullptr, &area);
+}
+
 void sdl2_handler::clear_framebuffer() const
 {
     SDL_RenderClear(_renderer);
 }
 
-void sdl2_handler::handle_input(JChip8& chip8, const imgui_handler& gui_handler)
+bool sdl2_handler::handle_input(JChip8& chip8, const imgui_handler& gui_handler)
 {
+    // Every event in this poll happened during the last frame, so each is placed at the same distance
+    // into the coming batch as it was from the first event, which keeps taps and their order intact
+    uint32 now = SDL_GetTicks();
+    _poll_started = false;
+
+    bool received = false;
     SDL_Event event;
     while (SDL_PollEvent(&event))
     {
+        received = true;
         gui_handler.process_event(&event);
         switch (event.type)
         {
@@ -152,29 +269,27 @@ void sdl2_handler::handle_input(JChip8& chip8, const imgui_handler& gui_handler)
                 break;
             }
             case SDL_KEYDOWN:
+            case SDL_KEYUP:
             {
+                bool pressed = event.type == SDL_KEYDOWN;
+                if (event.key.repeat)
+                    break;
+
+                auto mapped = _key_map.find(event.key.keysym.sym);
+                if (mapped != _key_map.end())
+                {
+                    key_event(chip8, mapped->second, pressed, SOURCE_KEYBOARD, event.key.timestamp, now);
+                    break;
+                }
+
                 switch (event.key.keysym.sym)
                 {
-                    case SDLK_1: chip8.keypad[0x1] = true; break;
-                    case SDLK_2: chip8.keypad[0x2] = true; break;
-                    case SDLK_3: chip8.keypad[0x3] = true; break;
-                    case SDLK_4: chip8.keypad[0xC] = true; break;
-                    case SDLK_q: chip8.keypad[0x4] = true; break;
-                    case SDLK_w: chip8.keypad[0x5] = true; break;
-                    case SDLK_f: chip8.keypad[0x6] = true; break;
-                    case SDLK_p: chip8.keypad[0xD] = true; break;
-                    case SDLK_a: chip8.keypad[0x7] = true; break;
-                    case SDLK_r: chip8.keypad[0x8] = true; break;
-                    case SDLK_s: chip8.keypad[0x9] = true; break;
-                    case SDLK_t: chip8.keypad[0xE] = true; break;
-                    case SDLK_z: chip8.keypad[0xA] = true; break;
-                    case SDLK_x: chip8.keypad[0x0] = true; break;
-                    case SDLK_c: chip8.keypad[0xB] = true; break;
-                    case SDLK_d: chip8.keypad[0xF] = true; break;
-                    case SDLK_ESCAPE: chip8.state = emulator_state::quit; break;
+                    case SDLK_ESCAPE: if (pressed) chip8.state = emulator_state::quit; break;
+                    case SDLK_BACKSPACE: _rewind_held = pressed; break;
                     case SDLK_F1:
                     {
-                        chip8.state == emulator_state::running ? chip8.state = emulator_state::paused : chip8.state = emulator_state::running;
+                        if (pressed)
+                            chip8.state == emulator_state::running ? chip8.state = emulator_state::paused : chip8.state = emulator_state::running;
                         break;
                     }
                     default:
@@ -182,38 +297,236 @@ void sdl2_handler::handle_input(JChip8& chip8, const imgui_handler& gui_handler)
                 }
                 break;
             }
-            case SDL_KEYUP:
+            case SDL_CONTROLLERBUTTONDOWN:
+            case SDL_CONTROLLERBUTTONUP:
             {
-                switch (event.key.keysym.sym)
+                uint8 button = event.cbutton.button;
+                if (button < _button_map.size() && _button_map[button] >= 0)
                 {
-                    case SDLK_1: chip8.keypad[0x1] = false; break;
-                    case SDLK_2: chip8.keypad[0x2] = false; break;
-                    case SDLK_3: chip8.keypad[0x3] = false; break;
-                    case SDLK_4: chip8.keypad[0xC] = false; break;
-                    case SDLK_q: chip8.keypad[0x4] = false; break;
-                    case SDLK_w: chip8.keypad[0x5] = false; break;
-                    case SDLK_f: chip8.keypad[0x6] = false; break;
-                    case SDLK_p: chip8.keypad[0xD] = false; break;
-                    case SDLK_a: chip8.keypad[0x7] = false; break;
-                    case SDLK_r: chip8.keypad[0x8] = false; break;
-                    case SDLK_s: chip8.keypad[0x9] = false; break;
-                    case SDLK_t: chip8.keypad[0xE] = false; break;
-                    case SDLK_z: chip8.keypad[0xA] = false; break;
-                    case SDLK_x: chip8.keypad[0x0] = false; break;
-                    case SDLK_c: chip8.keypad[0xB] = false; break;
-                    case SDLK_d: chip8.keypad[0xF] = false; break;
-                    default:
-                        break;
+                    key_event(chip8, static_cast<uint8>(_button_map[button]), event.type == SDL_CONTROLLERBUTTONDOWN,
+                        SOURCE_GAMEPAD, event.cbutton.timestamp, now);
                 }
                 break;
             }
+            case SDL_CONTROLLERDEVICEADDED:
+            {
+                if (!_gamepad)
+                    _gamepad = SDL_GameControllerOpen(event.cdevice.which);
+                break;
+            }
+            case SDL_CONTROLLERDEVICEREMOVED:
+            {
+                if (_gamepad && SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(_gamepad)) == event.cdevice.which)
+                {
+                    SDL_GameControllerClose(_gamepad);
+                    _gamepad = nullptr;
+                    for (uint8 key = 0; key < 16; ++key)
+                    {
+                        if (_key_sources[key] & SOURCE_GAMEPAD)
+                            key_event(chip8, key, false, SOURCE_GAMEPAD, event.cdevice.timestamp, now);
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return received;
+}
+
+void sdl2_handler::reload_input_map()
+{
+    _key_map.clear();
+    for (const auto& [name, value] : _config.key_map)
+    {
+        SDL_Keycode keycode = SDL_GetKeyFromName(name.c_str());
+        uint8 key;
+        if (keycode == SDLK_UNKNOWN || !parse_chip8_key(value, key))
+        {
+            std::cerr << "Ignoring key_map entry \"" << name << "\": \"" << value << "\"\n";
+            continue;
+        }
+        _key_map[keycode] = key;
+    }
+
+    _button_map.fill(-1);
+    for (const auto& [name, value] : _config.gamepad_map)
+    {
+        int button = SDL_GameControllerGetButtonFromString(name.c_str());
+        uint8 key;
+        if (button < 0 || button >= static_cast<int>(_button_map.size()) || !parse_chip8_key(value, key))
+        {
+            std::cerr << "Ignoring gamepad_map entry \"" << name << "\": \"" << value << "\"\n";
+            continue;
         }
+        _button_map[static_cast<size_t>(button)] = static_cast<int8>(key);
     }
 }
 
-void sdl2_handler::play_device(bool play) const
+void sdl2_handler::init_deferred()
+{
+    if (_deferred_init_done)
+        return;
+    _deferred_init_done = true;
+
+    SDL_Surface* icon = IMG_Load("assets/icon.png");
+    if (icon) SDL_SetWindowIcon(_window, icon);
+
+    SDL_FreeSurface(icon);
+
+    // Controllers already plugged in announce themselves with SDL_CONTROLLERDEVICEADDED once this is up
+    if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) < 0)
+        std::cerr << "Game controllers are unavailable! SDL_Error: " << SDL_GetError() << '\n';
+}
+
+void sdl2_handler::play_device(bool play)
 {
+    if (play && !_audio_device && !_audio_unavailable)
+        open_audio();
+    if (!_audio_device)
+        return;
+
     play ? SDL_PauseAudioDevice(_audio_device, 0) : SDL_PauseAudioDevice(_audio_device, 1);
+    if (_audio_playing && !play)
+    {
+        // The gap while paused isn't an underrun, so the next callback starts the timing afresh
+        SDL_LockAudioDevice(_audio_device);
+        _last_callback = 0;
+        SDL_UnlockAudioDevice(_audio_device);
+    }
+    _audio_playing = play;
+}
+
+void sdl2_handler::attach_metrics(emulator_metrics* metrics)
+{
+    if (_audio_device)
+        SDL_LockAudioDevice(_audio_device);
+    _metrics = metrics;
+    if (_audio_device)
+        SDL_UnlockAudioDevice(_audio_device);
+}
+
+void sdl2_handler::open_audio()
+{
+    // A missing or unsuitable device mutes the game rather than ending it, since this can happen mid-play
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+    {
+        std::cerr << "Audio could not initialize! SDL_Error: " << SDL_GetError() << '\n';
+        _audio_unavailable = true;
+        return;
+    }
+
+    _want.freq = _config.frequency;
+    _want.format = AUDIO_S16LSB;
+    _want.channels = 1;
+    _want.samples = 4096;
+    _want.callback = audio_callback;
+    _want.userdata = this;
+
+    _audio_device = SDL_OpenAudioDevice(nullptr, 0, &_want, &_have, 0);
+    if (!_audio_device)
+    {
+        std::cerr << "Audio device could not be created! SDL_Error: " << SDL_GetError() << '\n';
+        _audio_unavailable = true;
+        return;
+    }
+
+    if (_want.freq != _have.freq)
+    {
+        std::cerr << "Audio frequency requested in config is not available: " << SDL_GetError() << '\n';
+        SDL_CloseAudioDevice(_audio_device);
+        _audio_device = 0;
+        _audio_unavailable = true;
+    }
+}
+
+void sdl2_handler::update_audio(const JChip8& chip8)
+{
+    // Only a change of tone re-renders the loop, which is rare enough to do under the audio lock
+    bool pattern_changed = chip8.audio_pattern_loaded() != _tone_pattern_loaded
+        || (chip8.audio_pattern_loaded() && (chip8.audio_pitch() != _tone_pitch
+            || std::memcmp(chip8.audio_pattern(), _tone_pattern, sizeof(_tone_pattern)) != 0));
+    bool tone_changed = pattern_changed || _config.wave_frequency != _tone_frequency;
+    bool volume_changed = _config.volume != _tone_volume;
+    if (!tone_changed && !volume_changed)
+        return;
+
+    _tone_pattern_loaded = chip8.audio_pattern_loaded();
+    _tone_pitch = chip8.audio_pitch();
+    std::memcpy(_tone_pattern, chip8.audio_pattern(), sizeof(_tone_pattern));
+    _tone_frequency = _config.wave_frequency;
+    _tone_volume = _config.volume;
+
+    // Before the device is open there is no callback to race with
+    if (_audio_device)
+        SDL_LockAudioDevice(_audio_device);
+    if (volume_changed)
+        _synth.set_volume(_tone_volume);
+    if (tone_changed && _tone_pattern_loaded)
+        _synth.set_pattern(_tone_pattern, _tone_pitch);
+    else if (tone_changed)
+        _synth.set_square(_tone_frequency);
+    if (_audio_device)
+        SDL_UnlockAudioDevice(_audio_device);
+}
+
+bool sdl2_handler::rewind_held() const noexcept
+{
+    return _rewind_held;
+}
+
+uint16 sdl2_handler::local_keys() const noexcept
+{
+    return _local_keys;
+}
+
+const input_stats& sdl2_handler::input_latency() const noexcept
+{
+    return _input_stats;
+}
+
+void sdl2_handler::key_event(JChip8& chip8, uint8 key, bool pressed, uint8 source, uint32 timestamp, uint32 now)
+{
+    // Only the first device to press a key and the last to let go of it change the keypad
+    uint8 sources = _key_sources[key];
+    _key_sources[key] = pressed ? static_cast<uint8>(sources | source) : static_cast<uint8>(sources & ~source);
+    if ((sources != 0) == (_key_sources[key] != 0))
+        return;
+
+    if (!_poll_started)
+    {
+        _poll_started = true;
+        _poll_first_ticks = timestamp;
+        _poll_base_cycle = chip8.cycles();
+    }
+
+    // Nothing is placed past the coming batch, so a stalled poll can't hold input back by more than a frame
+    uint64 frame_cycles = std::max<uint64>(chip8.ips / 60, 1);
+    uint64 offset = std::min<uint64>(static_cast<uint64>(timestamp - _poll_first_ticks) * chip8.ips / 1000, frame_cycles - 1);
+    uint64 cycle = _poll_base_cycle + offset;
+    float latency = static_cast<float>(now - timestamp) + static_cast<float>(offset) * 1000.0f / std::max<float>(chip8.ips, 1.0f);
+
+    // A release is held for at least a frame after its press, or a game that reads the keypad once per
+    // frame could miss a quick tap entirely
+    if (pressed)
+    {
+        _press_cycle[key] = cycle;
+    }
+    else if (cycle < _press_cycle[key] + frame_cycles)
+    {
+        cycle = _press_cycle[key] + frame_cycles;
+        ++_input_stats.extended_taps;
+    }
+
+    chip8.queue_input({ cycle, key, pressed });
+
+    // Netplay rewrites the machine's keypad, so the keys held on this machine are also tracked here
+    if (pressed) _local_keys = static_cast<uint16>(_local_keys | (1 << key));
+    else         _local_keys = static_cast<uint16>(_local_keys & ~(1 << key));
+
+    _input_stats.latencies_ms[_input_stats.latency_offset] = latency;
+    _input_stats.latency_offset = (_input_stats.latency_offset + 1) % input_stats::HISTORY;
+    _input_stats.latency_count = std::min(_input_stats.latency_count + 1, input_stats::HISTORY);
+    ++_input_stats.events;
 }
 
 void sdl2_handler::set_window_size(uint32 width, uint32 height, uint32 menu_height)
@@ -245,16 +558,17 @@ void sdl2_handler::extract_rgba(uint32 color, uint8& r, uint8& g, uint8& b, uint
 
 void sdl2_handler::audio_callback(void* userdata, uint8* stream, int len)
 {
-    emulator_config* config = static_cast<emulator_config*>(userdata);
-
-    int16* audio_data = (int16*)stream;
-    static uint32 running_sample_index = 0;
-    const int32 square_wave_period = config->frequency / config->wave_frequency;
-    const int32 half_square_wave_period = square_wave_period / 2;
-
-    for (int i = 0; i < len / 2; ++i)
-    {
-        audio_data[i] = ((running_sample_index++ / half_square_wave_period) % 2) ?  config->volume : -config->volume;
-    }
+    sdl2_handler* handler = static_cast<sdl2_handler*>(userdata);
+    handler->_synth.fill(reinterpret_cast<int16*>(stream), static_cast<size_t>(len) / sizeof(int16));
+
+    // SDL pulls a buffer when the last one is nearly played out, so a callback arriving well over a
+    // buffer's length after the previous one means the device ran dry in between
+    if (!handler->_metrics)
+        return;
+    uint64 now = SDL_GetPerformanceCounter();
+    uint64 buffer_ticks = SDL_GetPerformanceFrequency() * handler->_have.samples / static_cast<uint64>(handler->_have.freq);
+    bool underrun = handler->_last_callback != 0 && now - handler->_last_callback > buffer_ticks + buffer_ticks / 2;
+    handler->_last_callback = now;
+    handler->_metrics->record_audio_callback(underrun);
 }
 
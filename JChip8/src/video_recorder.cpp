@@ -0,0 +1,510 @@
+#include "video_recorder.h"
+#include "audio_synth.h"
+#include "emulator_config.h"
+#include "jchip8.h"
+#include "trace_recorder.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr uint32 FRAMES_PER_SECOND = 60;
+
+    void put_u16(std::vector<uint8>& out, uint16 value)
+    {
+        out.push_back(static_cast<uint8>(value));
+        out.push_back(static_cast<uint8>(value >> 8));
+    }
+
+    void put_u32(std::vector<uint8>& out, uint32 value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back(static_cast<uint8>(value >> (i * 8)));
+    }
+
+    // Colours are 0xRRGGBBAA, as the config loads them and sdl2_handler::extract_rgba reads them
+    void put_rgb(std::vector<uint8>& out, uint32 color)
+    {
+        out.push_back(static_cast<uint8>(color >> 24));
+        out.push_back(static_cast<uint8>(color >> 16));
+        out.push_back(static_cast<uint8>(color >> 8));
+    }
+
+    // BT.601 limited range, which is what every Y4M reader assumes
+    void rgb_to_yuv(uint32 color, uint8& y, uint8& u, uint8& v)
+    {
+        double r = (color >> 24) & 0xFF;
+        double g = (color >> 16) & 0xFF;
+        double b = (color >> 8) & 0xFF;
+        y = static_cast<uint8>(16.0 + (65.481 * r + 128.553 * g + 24.966 * b) / 255.0 + 0.5);
+        u = static_cast<uint8>(128.0 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255.0 + 0.5);
+        v = static_cast<uint8>(128.0 + (112.0 * r - 93.786 * g - 18.214 * b) / 255.0 + 0.5);
+    }
+
+    // Centiseconds from the start of the recording to the start of a frame, rounded so that frame
+    // delays of 1 and 2 centiseconds alternate into an exact 60 Hz on average
+    uint64 frame_to_centiseconds(uint64 frame)
+    {
+        return (frame * 100 * 2 + FRAMES_PER_SECOND) / (FRAMES_PER_SECOND * 2);
+    }
+}
+
+struct video_recorder::encoder
+{
+    recording_format format;
+    std::ofstream video;
+    std::ofstream audio;
+    uint32 bg_color;
+    uint32 fg_color;
+
+    recorded_frame pending;
+    bool has_pending = false;
+    uint64 pending_start = 0;
+    uint64 frames = 0;
+
+    std::vector<uint8> yuv;
+    std::vector<uint8> indices;
+    std::vector<uint8> block;
+
+    uint32 sample_rate;
+    uint32 wave_frequency;
+    std::unique_ptr<audio_synth> synth;
+    bool tone_pattern_loaded = false;
+    uint8 tone_pitch = 0;
+    uint8 tone_pattern[16] = {};
+    uint64 samples_written = 0;
+    std::vector<int16> samples;
+
+    uint64 bytes = 0;
+
+    void write(std::ofstream& file, const uint8* data, size_t size)
+    {
+        file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        bytes += size;
+    }
+
+    void begin()
+    {
+        block.clear();
+        if (format == recording_format::gif)
+        {
+            const char header[] = "GIF89a";
+            block.insert(block.end(), header, header + 6);
+            put_u16(block, GRAPHICS_WIDTH);
+            put_u16(block, GRAPHICS_HEIGHT);
+            block.push_back(0x80);      // two entry global colour table
+            block.push_back(0);
+            block.push_back(0);
+            put_rgb(block, bg_color);
+            put_rgb(block, fg_color);
+
+            const char loop[] = "\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00";
+            block.insert(block.end(), loop, loop + sizeof(loop) - 1);
+            write(video, block.data(), block.size());
+        }
+        else
+        {
+            std::string header = "YUV4MPEG2 W" + std::to_string(GRAPHICS_WIDTH) + " H" + std::to_string(GRAPHICS_HEIGHT)
+                + " F60:1 Ip A1:1 C444\n";
+            write(video, reinterpret_cast<const uint8*>(header.data()), header.size());
+
+            // Sizes are patched in once the recording ends
+            block.clear();
+            block.insert(block.end(), { 'R', 'I', 'F', 'F' });
+            put_u32(block, 0);
+            block.insert(block.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+            put_u32(block, 16);
+            put_u16(block, 1);
+            put_u16(block, 1);
+            put_u32(block, sample_rate);
+            put_u32(block, sample_rate * 2);
+            put_u16(block, 2);
+            put_u16(block, 16);
+            block.insert(block.end(), { 'd', 'a', 't', 'a' });
+            put_u32(block, 0);
+            write(audio, block.data(), block.size());
+        }
+    }
+
+    void add(const recorded_frame& frame)
+    {
+        if (format == recording_format::y4m_wav)
+            write_audio(frame);
+
+        if (has_pending && std::memcmp(pending.pixels, frame.pixels, FRAME_BYTES) == 0)
+        {
+            ++frames;
+            return;
+        }
+
+        flush_pending();
+        pending = frame;
+        has_pending = true;
+        pending_start = frames++;
+    }
+
+    // Writes the held frame now that its duration is known.  Returns whether there was one.
+    bool flush_pending()
+    {
+        if (!has_pending)
+            return false;
+
+        uint64 repeats = frames - pending_start;
+        if (format == recording_format::gif)
+        {
+            uint64 delay = frame_to_centiseconds(frames) - frame_to_centiseconds(pending_start);
+            // A GIF delay is 16 bits, so a screen that sits still for over ten minutes takes more than one image
+            while (delay > 0)
+            {
+                uint16 chunk = static_cast<uint16>(std::min<uint64>(delay, 0xFFFF));
+                write_gif_image(chunk);
+                delay -= chunk;
+            }
+        }
+        else
+        {
+            // Y4M has no frame durations, but the conversion happens once however many times it repeats
+            convert_yuv();
+            const uint8 marker[] = { 'F', 'R', 'A', 'M', 'E', '\n' };
+            for (uint64 i = 0; i < repeats; ++i)
+            {
+                write(video, marker, sizeof(marker));
+                write(video, yuv.data(), yuv.size());
+            }
+        }
+
+        has_pending = false;
+        return true;
+    }
+
+    void write_gif_image(uint16 delay)
+    {
+        indices.resize(GRAPHICS_WIDTH * GRAPHICS_HEIGHT);
+        for (uint32 i = 0; i < indices.size(); ++i)
+            indices[i] = (pending.pixels[i >> 3] >> (7 - (i & 7))) & 1;
+
+        block.clear();
+        block.insert(block.end(), { 0x21, 0xF9, 0x04, 0x04 });
+        put_u16(block, delay);
+        block.insert(block.end(), { 0x00, 0x00 });
+
+        block.push_back(0x2C);
+        put_u16(block, 0);
+        put_u16(block, 0);
+        put_u16(block, GRAPHICS_WIDTH);
+        put_u16(block, GRAPHICS_HEIGHT);
+        block.push_back(0);
+
+        block.push_back(2);
+        gif_lzw_encode(indices.data(), indices.size(), 2, block);
+        write(video, block.data(), block.size());
+    }
+
+    void convert_yuv()
+    {
+        uint8 bg[3];
+        uint8 fg[3];
+        rgb_to_yuv(bg_color, bg[0], bg[1], bg[2]);
+        rgb_to_yuv(fg_color, fg[0], fg[1], fg[2]);
+
+        const uint32 plane = GRAPHICS_WIDTH * GRAPHICS_HEIGHT;
+        yuv.resize(plane * 3);
+        for (uint32 i = 0; i < plane; ++i)
+        {
+            const uint8* color = ((pending.pixels[i >> 3] >> (7 - (i & 7))) & 1) ? fg : bg;
+            yuv[i] = color[0];
+            yuv[plane + i] = color[1];
+            yuv[plane * 2 + i] = color[2];
+        }
+    }
+
+    void write_audio(const recorded_frame& frame)
+    {
+        // Same synthesis as the speakers, retuned whenever the ROM changes its XO-CHIP pattern or pitch
+        if (frame.audio_pattern_loaded != tone_pattern_loaded || (frame.audio_pattern_loaded
+            && (frame.audio_pitch != tone_pitch || std::memcmp(frame.audio_pattern, tone_pattern, sizeof(tone_pattern)) != 0)))
+        {
+            tone_pattern_loaded = frame.audio_pattern_loaded;
+            tone_pitch = frame.audio_pitch;
+            std::memcpy(tone_pattern, frame.audio_pattern, sizeof(tone_pattern));
+            if (tone_pattern_loaded)
+                synth->set_pattern(tone_pattern, tone_pitch);
+            else
+                synth->set_square(wave_frequency);
+        }
+
+        // Spread the sample rate over 60 frames exactly, rather than rounding every frame the same way
+        uint64 end = (frames + 1) * sample_rate / FRAMES_PER_SECOND;
+        samples.resize(static_cast<size_t>(end - samples_written));
+        if (frame.sound)
+        {
+            synth->fill(samples.data(), samples.size());
+        }
+        else
+        {
+            std::fill(samples.begin(), samples.end(), int16{ 0 });
+            synth->restart();
+        }
+
+        samples_written = end;
+        write(audio, reinterpret_cast<const uint8*>(samples.data()), samples.size() * sizeof(int16));
+    }
+
+    void finish()
+    {
+        flush_pending();
+        if (format == recording_format::gif)
+        {
+            const uint8 trailer = 0x3B;
+            write(video, &trailer, 1);
+        }
+        else
+        {
+            uint32 data_bytes = static_cast<uint32>(samples_written * sizeof(int16));
+            std::vector<uint8> size;
+            put_u32(size, 36 + data_bytes);
+            audio.seekp(4);
+            audio.write(reinterpret_cast<const char*>(size.data()), 4);
+
+            size.clear();
+            put_u32(size, data_bytes);
+            audio.seekp(40);
+            audio.write(reinterpret_cast<const char*>(size.data()), 4);
+        }
+    }
+};
+
+void pack_framebuffer(const bool* graphics, uint8* out) noexcept
+{
+    // Eight one-byte bools at a time, gathered into one byte with a multiply
+    for (uint32 i = 0; i < GRAPHICS_WIDTH * GRAPHICS_HEIGHT / 8; ++i)
+    {
+        uint64 lanes;
+        std::memcpy(&lanes, graphics + i * 8, sizeof(lanes));
+        out[i] = static_cast<uint8>(((lanes & 0x0101010101010101ull) * 0x8040201008040201ull) >> 56);
+    }
+}
+
+void gif_lzw_encode(const uint8* indices, size_t count, uint8 min_code_size, std::vector<uint8>& out)
+{
+    const uint32 alphabet = 1u << min_code_size;
+    const uint32 clear_code = alphabet;
+    const uint32 end_code = alphabet + 1;
+
+    // children[code * alphabet + symbol] is the code for that string extended by symbol, or 0 if none yet
+    std::vector<uint16> children(4096 * alphabet, 0);
+    uint32 next_code = end_code + 1;
+    uint32 code_size = min_code_size + 1u;
+
+    size_t block_start = out.size();
+    out.push_back(0);
+    uint32 bit_buffer = 0;
+    uint32 bit_count = 0;
+
+    auto emit = [&](uint32 code)
+    {
+        bit_buffer |= code << bit_count;
+        bit_count += code_size;
+        while (bit_count >= 8)
+        {
+            out.push_back(static_cast<uint8>(bit_buffer));
+            bit_buffer >>= 8;
+            bit_count -= 8;
+            if (out.size() - block_start == 256)
+            {
+                out[block_start] = 255;
+                block_start = out.size();
+                out.push_back(0);
+            }
+        }
+    };
+
+    emit(clear_code);
+    if (count == 0)
+    {
+        emit(end_code);
+    }
+    else
+    {
+        uint32 current = indices[0];
+        for (size_t i = 1; i < count; ++i)
+        {
+            uint32 symbol = indices[i];
+            uint16 child = children[current * alphabet + symbol];
+            if (child)
+            {
+                current = child;
+                continue;
+            }
+
+            emit(current);
+            if (next_code < 4096)
+            {
+                if (next_code == (1u << code_size))
+                    ++code_size;
+                children[current * alphabet + symbol] = static_cast<uint16>(next_code++);
+            }
+            else
+            {
+                emit(clear_code);
+                std::fill(children.begin(), children.end(), uint16{ 0 });
+                next_code = end_code + 1;
+                code_size = min_code_size + 1u;
+            }
+            current = symbol;
+        }
+        emit(current);
+        emit(end_code);
+    }
+
+    if (bit_count > 0)
+    {
+        out.push_back(static_cast<uint8>(bit_buffer));
+        if (out.size() - block_start == 256)
+        {
+            out[block_start] = 255;
+            block_start = out.size();
+            out.push_back(0);
+        }
+    }
+
+    out[block_start] = static_cast<uint8>(out.size() - block_start - 1);
+    if (out[block_start] != 0)
+        out.push_back(0);
+}
+
+video_recorder::video_recorder()
+    : _queue()
+    , _encoder()
+    , _writer()
+    , _recording(false)
+    , _stopping(false)
+    , _frames_submitted(0)
+    , _unique_frames(0)
+    , _frames_dropped(0)
+    , _bytes_written(0)
+{
+}
+
+video_recorder::~video_recorder()
+{
+    stop();
+}
+
+void video_recorder::start(const std::string& path, recording_format format, const emulator_config& config)
+{
+    stop();
+
+    auto enc = std::make_unique<encoder>();
+    enc->format = format;
+    enc->bg_color = config.bg_color;
+    enc->fg_color = config.fg_color;
+    enc->sample_rate = config.frequency;
+    enc->wave_frequency = config.wave_frequency;
+    enc->synth = std::make_unique<audio_synth>(config.frequency, config.volume);
+    enc->synth->set_square(config.wave_frequency);
+
+    if (format == recording_format::gif)
+    {
+        enc->video.open(path + ".gif", std::ios::binary);
+    }
+    else
+    {
+        enc->video.open(path + ".y4m", std::ios::binary);
+        enc->audio.open(path + ".wav", std::ios::binary);
+        if (!enc->audio)
+            throw std::runtime_error("Could not open recording audio file for writing");
+    }
+    if (!enc->video)
+        throw std::runtime_error("Could not open recording video file for writing");
+
+    enc->begin();
+    _encoder = std::move(enc);
+    _frames_submitted = 0;
+    _unique_frames = 0;
+    _frames_dropped = 0;
+    _bytes_written = _encoder->bytes;
+    _stopping = false;
+    _writer = std::thread(&video_recorder::writer_loop, this);
+    _recording.store(true, std::memory_order_release);
+}
+
+void video_recorder::stop()
+{
+    if (!_writer.joinable())
+        return;
+
+    _recording.store(false, std::memory_order_release);
+    _stopping.store(true, std::memory_order_release);
+    _writer.join();
+    _encoder.reset();
+}
+
+void video_recorder::submit(const JChip8& chip8) noexcept
+{
+    if (!_recording.load(std::memory_order_acquire))
+        return;
+
+    JCHIP8_TRACE_SCOPE("record submit", "recorder");
+    recorded_frame frame;
+    pack_framebuffer(chip8.graphics, frame.pixels);
+    frame.sound = chip8.sound_timer > 0;
+    frame.audio_pattern_loaded = chip8.audio_pattern_loaded();
+    frame.audio_pitch = chip8.audio_pitch();
+    std::memcpy(frame.audio_pattern, chip8.audio_pattern(), sizeof(frame.audio_pattern));
+
+    _frames_submitted.fetch_add(1, std::memory_order_relaxed);
+    if (!_queue.try_push(frame))
+        _frames_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool video_recorder::recording() const noexcept
+{
+    return _recording.load(std::memory_order_acquire);
+}
+
+recorder_stats video_recorder::stats() const noexcept
+{
+    return recorder_stats{
+        _frames_submitted.load(std::memory_order_relaxed),
+        _unique_frames.load(std::memory_order_relaxed),
+        _frames_dropped.load(std::memory_order_relaxed),
+        _bytes_written.load(std::memory_order_relaxed),
+    };
+}
+
+void video_recorder::writer_loop()
+{
+    encoder& enc = *_encoder;
+    recorded_frame frame;
+    uint32 unique = 0;
+
+    for (;;)
+    {
+        if (_queue.try_pop(frame))
+        {
+            uint64 frames_before = enc.frames;
+            enc.add(frame);
+            if (enc.pending_start == frames_before)
+                _unique_frames.store(++unique, std::memory_order_relaxed);
+            _bytes_written.store(enc.bytes, std::memory_order_relaxed);
+            continue;
+        }
+
+        // The emulator has stopped pushing by the time stopping is set, so an empty queue is final
+        if (_stopping.load(std::memory_order_acquire) && _queue.empty())
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    enc.finish();
+    _bytes_written.store(enc.bytes, std::memory_order_relaxed);
+}
@@ -1,10 +1,90 @@
 #ifndef JUMI_JCHIP8ASM_ASSEMBLER_H
 #define JUMI_JCHIP8ASM_ASSEMBLER_H
+#include "typedefs.h"
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+// Thrown with the file and line of the first problem; a failed reassemble leaves the previous program intact
+class assembler_error : public std::runtime_error
+{
+public:
+    assembler_error(const std::filesystem::path& file, uint32 line, const std::string& message);
+
+    [[nodiscard]] const std::filesystem::path& file() const noexcept;
+    [[nodiscard]] uint32 line() const noexcept;
+
+private:
+    std::filesystem::path _file;
+    uint32 _line;
+};
+
+// Bytes that differ between two assemblies of a program, to be written into a running machine's memory
+struct memory_patch
+{
+    uint16 address;
+    std::vector<uint8> bytes;
+};
+
+// One source line that emits bytes
+struct asm_statement
+{
+    uint32 line;
+    std::string mnemonic;                   // upper case
+    std::vector<std::string> operands;
+    uint16 offset;                          // from the start of its source
+    uint16 size;
+};
+
+struct asm_label
+{
+    std::string name;
+    uint32 line;
+    uint16 offset;                          // from the start of its source
+};
+
+struct asm_source
+{
+    std::filesystem::path path;
+    std::vector<asm_statement> statements;
+    std::vector<asm_label> labels;
+    std::vector<std::string> references;    // every symbol an operand uses, sorted
+    uint16 address = 0;
+    uint16 size = 0;
+};
+
+// Assembles the mnemonics the debugger disassembles to (CLS, LD V0, 0x12, DRW V0, V1, 5, ...) plus labels,
+// DB and DW, with ';' comments.  A project is a list of source files laid out back to back from the ROM
+// start address.  Every statement's size is known without resolving symbols, so after an edit only the
+// changed files are parsed again, and only those, the ones that moved and the ones using a symbol that moved
+// are encoded again.  reassemble() returns what changed as patches for JChip8::patch_memory, or the whole
+// program if nothing has assembled yet.
 class j_assembler
 {
 public:
-    void parse_input_file(const char* filepath);
+    void add_source(const std::filesystem::path& path);
+    [[nodiscard]] const std::vector<asm_source>& sources() const noexcept;
+
+    const std::vector<uint8>& assemble();
+    std::vector<memory_patch> reassemble(const std::vector<std::filesystem::path>& changed);
+
+    [[nodiscard]] const std::vector<uint8>& image() const noexcept;        // the program, from ROM_START_LOCATION
+    [[nodiscard]] std::optional<uint16> symbol(const std::string& name) const;
+    [[nodiscard]] uint32 encoded_sources() const noexcept;                 // sources the last assembly encoded
+
+private:
+    std::vector<asm_source> _sources;
+    std::unordered_map<std::string, uint16> _symbols;
+    std::vector<uint8> _image;
+    uint32 _encoded_sources = 0;
+    bool _assembled = false;
+
+    static asm_source parse(const std::filesystem::path& path);
+    static std::unordered_map<std::string, uint16> layout(std::vector<asm_source>& sources);
+    static void encode(const asm_source& source, const std::unordered_map<std::string, uint16>& symbols, std::vector<uint8>& image);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,25 @@
+#ifndef JUMI_JCHIP8ASM_SOURCE_WATCHER_H
+#define JUMI_JCHIP8ASM_SOURCE_WATCHER_H
+#include <filesystem>
+#include <vector>
+
+// Notices edits to a set of files by polling their modification times.  A project is a handful of files, so
+// polling once a frame costs a few microseconds and behaves the same on every platform.  A file that is
+// missing for a moment, as some editors leave it while saving, is simply checked again on the next poll.
+class source_watcher
+{
+public:
+    void watch(const std::filesystem::path& path);
+    std::vector<std::filesystem::path> poll();     // the files that changed since the last poll
+
+private:
+    struct watched_file
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type modified;
+    };
+
+    std::vector<watched_file> _files;
+};
+
+#endif
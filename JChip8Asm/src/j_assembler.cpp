@@ -1,16 +1,538 @@
 #include "j_assembler.h"
+#include "jchip8.h"
+#include <algorithm>
+#include <cctype>
 #include <fstream>
+#include <iterator>
 #include <string>
+#include <utility>
 
-void j_assembler::parse_input_file(const char* filepath)
+namespace
 {
-    std::ifstream file(filepath);
+    constexpr const char* SPECIAL_OPERANDS[] = { "I", "[I]", "DT", "ST", "K", "F", "B" };
 
-    if (!file) 
+    std::string upper(std::string text)
     {
-        std::string message = std::string("File with filename: ") + filepath + " does not exist\n";
-        throw std::runtime_error(message.c_str());
+        for (char& c : text)
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        return text;
     }
 
+    std::string trim(const std::string& text)
+    {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+        size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+
+    bool identifier_start(char c) noexcept { return std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '.'; }
+    bool identifier_char(char c) noexcept { return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.'; }
+
+    // V0-VF, or -1
+    int register_index(const std::string& operand) noexcept
+    {
+        if (operand.size() != 2 || (operand[0] != 'V' && operand[0] != 'v') || !std::isxdigit(static_cast<unsigned char>(operand[1])))
+            return -1;
+        char digit = static_cast<char>(std::toupper(static_cast<unsigned char>(operand[1])));
+        return digit <= '9' ? digit - '0' : digit - 'A' + 10;
+    }
+
+    bool is_special(const std::string& operand)
+    {
+        std::string name = upper(operand);
+        return std::find(std::begin(SPECIAL_OPERANDS), std::end(SPECIAL_OPERANDS), name) != std::end(SPECIAL_OPERANDS);
+    }
+
+    bool is_keyword(const std::string& name)
+    {
+        return register_index(name) >= 0 || is_special(name);
+    }
+
+    // Decimal, 0x/#/$ hex or 0b/% binary
+    bool parse_number(const std::string& token, int32& value) noexcept
+    {
+        int base = 10;
+        size_t start = 0;
+        if (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X'))
+            base = 16, start = 2;
+        else if (token.size() > 2 && token[0] == '0' && (token[1] == 'b' || token[1] == 'B'))
+            base = 2, start = 2;
+        else if (token.size() > 1 && (token[0] == '#' || token[0] == '$'))
+            base = 16, start = 1;
+        else if (token.size() > 1 && token[0] == '%')
+            base = 2, start = 1;
+
+        if (start >= token.size())
+            return false;
+        int32 result = 0;
+        for (size_t i = start; i < token.size(); ++i)
+        {
+            int digit = std::isdigit(static_cast<unsigned char>(token[i])) ? token[i] - '0'
+                : std::isxdigit(static_cast<unsigned char>(token[i])) ? std::toupper(static_cast<unsigned char>(token[i])) - 'A' + 10
+                : base;
+            if (digit >= base || result > 0xFFFF)
+                return false;
+            result = result * base + digit;
+        }
+        value = result;
+        return true;
+    }
+
+    // An expression is numbers and symbols joined by + and -.  Collects the symbols it uses, or returns the
+    // first thing in it that is neither.
+    std::optional<std::string> scan_expression(const std::string& expression, std::vector<std::string>& symbols)
+    {
+        size_t i = 0;
+        bool expect_term = true;
+        while (i < expression.size())
+        {
+            char c = expression[i];
+            if (c == ' ' || c == '\t')
+            {
+                ++i;
+                continue;
+            }
+            if (expect_term && (c == '-' || c == '+') )
+            {
+                ++i;
+                continue;
+            }
+            if (!expect_term && (c == '-' || c == '+'))
+            {
+                expect_term = true;
+                ++i;
+                continue;
+            }
+            if (!expect_term)
+                return expression.substr(i);
+
+            size_t end = i;
+            while (end < expression.size() && (identifier_char(expression[end]) || expression[end] == '#' || expression[end] == '$' || expression[end] == '%'))
+                ++end;
+            if (end == i)
+                return expression.substr(i);
+
+            std::string term = expression.substr(i, end - i);
+            int32 value = 0;
+            if (identifier_start(term[0]) && !is_keyword(term))
+                symbols.push_back(term);
+            else if (!parse_number(term, value))
+                return term;
+            expect_term = false;
+            i = end;
+        }
+        if (expect_term)
+            return std::string("end of expression");
+        return std::nullopt;
+    }
+
+    int32 evaluate(const std::string& expression, const std::unordered_map<std::string, uint16>& symbols,
+        const asm_source& source, uint32 line)
+    {
+        int32 total = 0;
+        int32 sign = 1;
+        size_t i = 0;
+        while (i < expression.size())
+        {
+            char c = expression[i];
+            if (c == ' ' || c == '\t' || c == '+')
+            {
+                ++i;
+                continue;
+            }
+            if (c == '-')
+            {
+                sign = -sign;
+                ++i;
+                continue;
+            }
+
+            size_t end = i;
+            while (end < expression.size() && expression[end] != '+' && expression[end] != '-' && expression[end] != ' ' && expression[end] != '\t')
+                ++end;
+            std::string term = expression.substr(i, end - i);
+            int32 value = 0;
+            if (identifier_start(term[0]))
+            {
+                std::unordered_map<std::string, uint16>::const_iterator symbol = symbols.find(term);
+                if (symbol == symbols.end())
+                    throw assembler_error(source.path, line, "Undefined symbol '" + term + "'");
+                value = symbol->second;
+            }
+            else
+            {
+                parse_number(term, value);
+            }
+            total += sign * value;
+            sign = 1;
+            i = end;
+        }
+        return total;
+    }
+
+    uint16 statement_size(const std::string& mnemonic, size_t operands) noexcept
+    {
+        if (mnemonic == "DB")
+            return static_cast<uint16>(operands);
+        if (mnemonic == "DW")
+            return static_cast<uint16>(operands * 2);
+        static const char* const instructions[] = {
+            "CLS", "RET", "SYS", "JP", "CALL", "SE", "SNE", "LD", "ADD", "OR", "AND", "XOR", "SUB", "SUBN",
+            "SHR", "SHL", "RND", "DRW", "SKP", "SKNP", "AUDIO", "PITCH"
+        };
+        for (const char* instruction : instructions)
+        {
+            if (mnemonic == instruction)
+                return 2;
+        }
+        return 0;
+    }
+}
+
+assembler_error::assembler_error(const std::filesystem::path& file, uint32 line, const std::string& message)
+    : std::runtime_error(file.filename().string() + (line > 0 ? ":" + std::to_string(line) : std::string()) + ": " + message)
+    , _file(file)
+    , _line(line)
+{
+
+}
+
+const std::filesystem::path& assembler_error::file() const noexcept { return _file; }
+uint32 assembler_error::line() const noexcept { return _line; }
+
+void j_assembler::add_source(const std::filesystem::path& path)
+{
+    _sources.push_back(asm_source{});
+    _sources.back().path = std::filesystem::absolute(path).lexically_normal();
+}
+
+const std::vector<asm_source>& j_assembler::sources() const noexcept { return _sources; }
+const std::vector<uint8>& j_assembler::image() const noexcept { return _image; }
+uint32 j_assembler::encoded_sources() const noexcept { return _encoded_sources; }
+
+std::optional<uint16> j_assembler::symbol(const std::string& name) const
+{
+    std::unordered_map<std::string, uint16>::const_iterator found = _symbols.find(name);
+    if (found == _symbols.end())
+        return std::nullopt;
+    return found->second;
+}
+
+const std::vector<uint8>& j_assembler::assemble()
+{
+    std::vector<asm_source> sources;
+    for (const asm_source& source : _sources)
+        sources.push_back(parse(source.path));
+
+    std::unordered_map<std::string, uint16> symbols = layout(sources);
+    std::vector<uint8> image(sources.empty() ? 0 : static_cast<size_t>(sources.back().address + sources.back().size - ROM_START_LOCATION), 0);
+    for (const asm_source& source : sources)
+        encode(source, symbols, image);
 
+    _sources = std::move(sources);
+    _symbols = std::move(symbols);
+    _image = std::move(image);
+    _encoded_sources = static_cast<uint32>(_sources.size());
+    _assembled = true;
+    return _image;
+}
+
+std::vector<memory_patch> j_assembler::reassemble(const std::vector<std::filesystem::path>& changed)
+{
+    // Nothing has assembled yet, so there is nothing to patch against: the whole program is the patch
+    if (!_assembled)
+    {
+        assemble();
+        return { memory_patch{ ROM_START_LOCATION, _image } };
+    }
+
+    // Parsing is the only step that reads files, so it happens before anything is touched
+    std::vector<std::pair<size_t, asm_source>> parsed;
+    for (const std::filesystem::path& path : changed)
+    {
+        std::filesystem::path normal = std::filesystem::absolute(path).lexically_normal();
+        for (size_t i = 0; i < _sources.size(); ++i)
+        {
+            if (_sources[i].path == normal)
+                parsed.emplace_back(i, parse(normal));
+        }
+    }
+    if (parsed.empty())
+        return {};
+
+    std::vector<uint16> old_addresses;
+    for (const asm_source& source : _sources)
+        old_addresses.push_back(source.address);
+
+    // Swapped in place rather than copying the project, and swapped back if it doesn't assemble
+    for (std::pair<size_t, asm_source>& source : parsed)
+        std::swap(_sources[source.first], source.second);
+
+    std::vector<uint8> image;
+    std::unordered_map<std::string, uint16> symbols;
+    uint32 encoded = 0;
+    try
+    {
+        symbols = layout(_sources);
+        image = _image;
+        image.resize(static_cast<size_t>(_sources.back().address + _sources.back().size - ROM_START_LOCATION), 0);
+        for (size_t i = 0; i < _sources.size(); ++i)
+        {
+            const asm_source& source = _sources[i];
+            bool dirty = source.address != old_addresses[i]
+                || std::any_of(parsed.begin(), parsed.end(), [i](const std::pair<size_t, asm_source>& p) { return p.first == i; });
+            for (size_t r = 0; r < source.references.size() && !dirty; ++r)
+            {
+                std::unordered_map<std::string, uint16>::const_iterator before = _symbols.find(source.references[r]);
+                std::unordered_map<std::string, uint16>::const_iterator after = symbols.find(source.references[r]);
+                dirty = (before == _symbols.end()) != (after == symbols.end())
+                    || (before != _symbols.end() && before->second != after->second);
+            }
+            if (dirty)
+            {
+                encode(source, symbols, image);
+                ++encoded;
+            }
+        }
+    }
+    catch (...)
+    {
+        for (std::pair<size_t, asm_source>& source : parsed)
+            std::swap(_sources[source.first], source.second);
+        layout(_sources);
+        throw;
+    }
+
+    // Bytes the old program had past the end of the new one are cleared, as a fresh load would have them
+    std::vector<memory_patch> patches;
+    size_t length = std::max(image.size(), _image.size());
+    for (size_t i = 0; i < length; ++i)
+    {
+        uint8 before = i < _image.size() ? _image[i] : 0;
+        uint8 after = i < image.size() ? image[i] : 0;
+        if (before == after)
+            continue;
+        if (patches.empty() || patches.back().address + patches.back().bytes.size() != ROM_START_LOCATION + i)
+            patches.push_back(memory_patch{ static_cast<uint16>(ROM_START_LOCATION + i), {} });
+        patches.back().bytes.push_back(after);
+    }
+
+    _symbols = std::move(symbols);
+    _image = std::move(image);
+    _encoded_sources = encoded;
+    return patches;
+}
+
+asm_source j_assembler::parse(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw assembler_error(path, 0, "Could not open the source file");
+
+    asm_source source;
+    source.path = path;
+    std::string text;
+    uint32 line = 0;
+    uint32 offset = 0;
+    while (std::getline(file, text))
+    {
+        ++line;
+        text = trim(text.substr(0, text.find(';')));
+
+        // Any number of labels can lead a line
+        size_t colon = text.find(':');
+        while (colon != std::string::npos)
+        {
+            std::string name = trim(text.substr(0, colon));
+            if (name.empty() || !identifier_start(name[0]) || !std::all_of(name.begin(), name.end(), identifier_char))
+                break;
+            if (is_keyword(name))
+                throw assembler_error(path, line, "'" + name + "' is a register name and can't be a label");
+            if (std::any_of(source.labels.begin(), source.labels.end(), [&name](const asm_label& label) { return label.name == name; }))
+                throw assembler_error(path, line, "Label '" + name + "' is already defined");
+            source.labels.push_back(asm_label{ name, line, static_cast<uint16>(offset) });
+            text = trim(text.substr(colon + 1));
+            colon = text.find(':');
+        }
+        if (text.empty())
+            continue;
+
+        asm_statement statement{ line, "", {}, static_cast<uint16>(offset), 0 };
+        size_t space = text.find_first_of(" \t");
+        statement.mnemonic = upper(text.substr(0, space));
+        if (space != std::string::npos)
+        {
+            std::string operands = text.substr(space);
+            size_t start = 0;
+            while (start <= operands.size())
+            {
+                size_t comma = operands.find(',', start);
+                std::string operand = trim(operands.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+                if (operand.empty())
+                    throw assembler_error(path, line, "Empty operand");
+                statement.operands.push_back(operand);
+                if (comma == std::string::npos)
+                    break;
+                start = comma + 1;
+            }
+        }
+
+        statement.size = statement_size(statement.mnemonic, statement.operands.size());
+        if (statement.size == 0)
+            throw assembler_error(path, line, statement.operands.empty() && (statement.mnemonic == "DB" || statement.mnemonic == "DW")
+                ? statement.mnemonic + " needs at least one value" : "Unknown instruction '" + statement.mnemonic + "'");
+
+        for (const std::string& operand : statement.operands)
+        {
+            if (is_keyword(operand))
+                continue;
+            std::optional<std::string> bad = scan_expression(operand, source.references);
+            if (bad)
+                throw assembler_error(path, line, "Unexpected '" + *bad + "' in '" + operand + "'");
+        }
+
+        offset += statement.size;
+        if (offset > MEMORY_SIZE - ROM_START_LOCATION)
+            throw assembler_error(path, line, "The program doesn't fit in memory");
+        source.statements.push_back(std::move(statement));
+    }
+
+    source.size = static_cast<uint16>(offset);
+    std::sort(source.references.begin(), source.references.end());
+    source.references.erase(std::unique(source.references.begin(), source.references.end()), source.references.end());
+    return source;
+}
+
+std::unordered_map<std::string, uint16> j_assembler::layout(std::vector<asm_source>& sources)
+{
+    std::unordered_map<std::string, uint16> symbols;
+    uint32 address = ROM_START_LOCATION;
+    for (asm_source& source : sources)
+    {
+        if (address + source.size > MEMORY_SIZE)
+            throw assembler_error(source.path, 0, "The program doesn't fit in memory");
+        source.address = static_cast<uint16>(address);
+        for (const asm_label& label : source.labels)
+        {
+            if (!symbols.emplace(label.name, static_cast<uint16>(address + label.offset)).second)
+                throw assembler_error(source.path, label.line, "Label '" + label.name + "' is already defined in another source");
+        }
+        address += source.size;
+    }
+    return symbols;
+}
+
+void j_assembler::encode(const asm_source& source, const std::unordered_map<std::string, uint16>& symbols, std::vector<uint8>& image)
+{
+    for (const asm_statement& statement : source.statements)
+    {
+        const std::vector<std::string>& ops = statement.operands;
+        uint32 line = statement.line;
+        auto fail = [&](const std::string& message) { return assembler_error(source.path, line, message); };
+        auto operands = [&](size_t count)
+        {
+            if (ops.size() != count)
+                throw fail(statement.mnemonic + " takes " + std::to_string(count) + " operand" + (count == 1 ? "" : "s"));
+        };
+        auto reg = [&](size_t index)
+        {
+            int found = register_index(ops[index]);
+            if (found < 0)
+                throw fail("Expected a register, not '" + ops[index] + "'");
+            return static_cast<uint32>(found);
+        };
+        // Negative values are accepted down to the two's complement of the field, so ADD V0, -1 works
+        auto value = [&](size_t index, int32 max)
+        {
+            if (is_keyword(ops[index]))
+                throw fail("Expected a value, not '" + ops[index] + "'");
+            int32 result = evaluate(ops[index], symbols, source, line);
+            if (result > max || result < -(max + 1) / 2)
+                throw fail("'" + ops[index] + "' is out of range");
+            return static_cast<uint32>(result & max);
+        };
+        auto is = [&](size_t index, const char* name) { return ops.size() > index && upper(ops[index]) == name; };
+        auto is_reg = [&](size_t index) { return ops.size() > index && register_index(ops[index]) >= 0; };
+
+        size_t at = static_cast<size_t>(statement.offset + source.address - ROM_START_LOCATION);
+        if (statement.mnemonic == "DB")
+        {
+            for (size_t i = 0; i < ops.size(); ++i)
+                image[at + i] = static_cast<uint8>(value(i, 0xFF));
+            continue;
+        }
+        if (statement.mnemonic == "DW")
+        {
+            for (size_t i = 0; i < ops.size(); ++i)
+            {
+                uint32 word = value(i, 0xFFFF);
+                image[at + i * 2] = static_cast<uint8>(word >> 8);
+                image[at + i * 2 + 1] = static_cast<uint8>(word);
+            }
+            continue;
+        }
+
+        const std::string& m = statement.mnemonic;
+        uint32 opcode = 0;
+        if (m == "CLS") { operands(0); opcode = 0x00E0; }
+        else if (m == "RET") { operands(0); opcode = 0x00EE; }
+        else if (m == "AUDIO") { operands(0); opcode = 0xF002; }
+        else if (m == "SYS") { operands(1); opcode = value(0, 0xFFF); }
+        else if (m == "CALL") { operands(1); opcode = 0x2000 | value(0, 0xFFF); }
+        else if (m == "JP" && ops.size() == 2) { if (!is(0, "V0")) throw fail("Only JP V0, addr takes two operands"); opcode = 0xB000 | value(1, 0xFFF); }
+        else if (m == "JP") { operands(1); opcode = 0x1000 | value(0, 0xFFF); }
+        else if (m == "SE" || m == "SNE")
+        {
+            operands(2);
+            bool skip_equal = m == "SE";
+            opcode = is_reg(1) ? (skip_equal ? 0x5000u : 0x9000u) | reg(0) << 8 | reg(1) << 4
+                : (skip_equal ? 0x3000u : 0x4000u) | reg(0) << 8 | value(1, 0xFF);
+        }
+        else if (m == "LD")
+        {
+            operands(2);
+            if (is(0, "I")) opcode = 0xA000 | value(1, 0xFFF);
+            else if (is(0, "DT")) opcode = 0xF015 | reg(1) << 8;
+            else if (is(0, "ST")) opcode = 0xF018 | reg(1) << 8;
+            else if (is(0, "F")) opcode = 0xF029 | reg(1) << 8;
+            else if (is(0, "B")) opcode = 0xF033 | reg(1) << 8;
+            else if (is(0, "[I]")) opcode = 0xF055 | reg(1) << 8;
+            else if (is(1, "DT")) opcode = 0xF007 | reg(0) << 8;
+            else if (is(1, "K")) opcode = 0xF00A | reg(0) << 8;
+            else if (is(1, "[I]")) opcode = 0xF065 | reg(0) << 8;
+            else if (is_reg(1)) opcode = 0x8000 | reg(0) << 8 | reg(1) << 4;
+            else opcode = 0x6000 | reg(0) << 8 | value(1, 0xFF);
+        }
+        else if (m == "ADD")
+        {
+            operands(2);
+            if (is(0, "I")) opcode = 0xF01E | reg(1) << 8;
+            else if (is_reg(1)) opcode = 0x8004 | reg(0) << 8 | reg(1) << 4;
+            else opcode = 0x7000 | reg(0) << 8 | value(1, 0xFF);
+        }
+        else if (m == "OR" || m == "AND" || m == "XOR" || m == "SUB" || m == "SUBN")
+        {
+            operands(2);
+            uint32 low = m == "OR" ? 0x1 : m == "AND" ? 0x2 : m == "XOR" ? 0x3 : m == "SUB" ? 0x5 : 0x7;
+            opcode = 0x8000 | reg(0) << 8 | reg(1) << 4 | low;
+        }
+        else if (m == "SHR" || m == "SHL")
+        {
+            // Vy only matters under the shift quirk, so it can be left out
+            if (ops.size() != 1)
+                operands(2);
+            uint32 y = ops.size() == 2 ? reg(1) : reg(0);
+            opcode = 0x8000 | reg(0) << 8 | y << 4 | (m == "SHR" ? 0x6 : 0xE);
+        }
+        else if (m == "RND") { operands(2); opcode = 0xC000 | reg(0) << 8 | value(1, 0xFF); }
+        else if (m == "DRW") { operands(3); opcode = 0xD000 | reg(0) << 8 | reg(1) << 4 | value(2, 0xF); }
+        else if (m == "SKP") { operands(1); opcode = 0xE09E | reg(0) << 8; }
+        else if (m == "SKNP") { operands(1); opcode = 0xE0A1 | reg(0) << 8; }
+        else if (m == "PITCH") { operands(1); opcode = 0xF03A | reg(0) << 8; }
+
+        image[at] = static_cast<uint8>(opcode >> 8);
+        image[at + 1] = static_cast<uint8>(opcode);
+    }
 }
@@ -0,0 +1,23 @@
+#include "source_watcher.h"
+
+void source_watcher::watch(const std::filesystem::path& path)
+{
+    std::error_code error;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+    _files.push_back(watched_file{ path, error ? std::filesystem::file_time_type::min() : modified });
+}
+
+std::vector<std::filesystem::path> source_watcher::poll()
+{
+    std::vector<std::filesystem::path> changed;
+    for (watched_file& file : _files)
+    {
+        std::error_code error;
+        std::filesystem::file_time_type modified = std::filesystem::last_write_time(file.path, error);
+        if (error || modified == file.modified)
+            continue;
+        file.modified = modified;
+        changed.push_back(file.path);
+    }
+    return changed;
+}
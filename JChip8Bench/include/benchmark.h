@@ -0,0 +1,79 @@
+#ifndef JUMI_CHIP8_BENCHMARK_H
+#define JUMI_CHIP8_BENCHMARK_H
+#include "jchip8.h"
+#include "typedefs.h"
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+
+struct bench_result
+{
+    std::string name;
+    uint64 operations;
+    double seconds;
+
+    [[nodiscard]] double per_second() const noexcept { return seconds > 0.0 ? static_cast<double>(operations) / seconds : 0.0; }
+    [[nodiscard]] double ns_per_op() const noexcept { return operations > 0 ? (seconds * 1e9) / static_cast<double>(operations) : 0.0; }
+};
+
+// Calls body repeatedly until at least min_seconds have passed.  body returns how many operations
+// it performed, so one call can stand for a whole batch of work.
+template <typename Body>
+bench_result measure(const std::string& name, double min_seconds, Body&& body)
+{
+    using clock = std::chrono::steady_clock;
+
+    uint64 operations = 0;
+    clock::time_point start = clock::now();
+    std::chrono::duration<double> elapsed{ 0.0 };
+
+    while (elapsed.count() < min_seconds)
+    {
+        operations += body();
+        elapsed = clock::now() - start;
+    }
+
+    return bench_result{ name, operations, elapsed.count() };
+}
+
+// Times JChip8::run on a machine that setup has loaded and configured, 64 frames' worth of instruction
+// budget per call, so variants of the engine are compared on exactly the same loop
+template <typename Setup>
+bench_result measure_run(const std::string& name, double min_seconds, Setup&& setup)
+{
+    JChip8 chip8;
+    setup(chip8);
+
+    return measure(name, min_seconds, [&]()
+    {
+        uint64 executed = 0;
+        for (int batch = 0; batch < 64; ++batch)
+            executed += chip8.run(std::numeric_limits<uint16>::max());
+        return executed;
+    });
+}
+
+void print_results(const std::string& title, const std::vector<bench_result>& results, const char* unit);
+std::string write_temp_rom(const std::string& name, const std::vector<uint8>& rom);
+
+const std::vector<uint8>& workload_rom();
+const std::vector<uint8>& game_rom();
+std::string write_workload_rom();
+bench_result bench_baseline_interpreter(const std::string& name, double min_seconds);
+
+void run_interpreter_benchmarks(double min_seconds);
+void run_recompiled_benchmarks(double min_seconds);
+void run_hooks_benchmarks(double min_seconds);
+void run_core_api_benchmarks(double min_seconds, const std::string& rom_path);
+void run_rewind_benchmarks(double min_seconds, const std::string& rom_path);
+void run_run_ahead_benchmarks(double min_seconds, const std::string& rom_path);
+void run_recorder_benchmarks(double min_seconds, const std::string& rom_path);
+void run_audio_benchmarks(double min_seconds);
+void run_batch_benchmarks(double min_seconds);
+void run_clone_benchmarks(double min_seconds);
+void run_grid_benchmarks(double min_seconds);
+void run_assembler_benchmarks(double min_seconds);
+void run_metrics_benchmarks(double min_seconds);
+
+#endif
@@ -0,0 +1,79 @@
+#include "benchmark.h"
+#include "j_assembler.h"
+#include "jchip8.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr uint32 PROJECT_SOURCES = 24;
+    constexpr uint32 ROUTINE_LINES = 36;
+
+    // One routine per file that calls the next, so every file references a label defined in another
+    std::string routine_source(uint32 index, uint32 variant)
+    {
+        std::string source = "routine" + std::to_string(index) + ":\n";
+        for (uint32 line = 0; line < ROUTINE_LINES; ++line)
+        {
+            source += "    LD V" + std::string(1, "0123456789ABCDEF"[line % 16]) + ", " + std::to_string((line + variant) % 256) + "\n";
+            source += "    CALL routine" + std::to_string((index + 1) % PROJECT_SOURCES) + "\n";
+        }
+        return source;
+    }
+
+    void write_source(const std::filesystem::path& path, const std::string& text)
+    {
+        std::ofstream file(path);
+        if (!file) throw std::runtime_error("Could not write benchmark source");
+        file << text;
+    }
+}
+
+// The edit-to-running path of --watch: a save to one file of a project filling memory, re-assembled and
+// patched into a machine that is running it, against assembling the project from scratch
+void run_assembler_benchmarks(double min_seconds)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "jchip8_bench_project";
+    std::filesystem::create_directories(directory);
+    j_assembler assembler;
+    std::vector<std::filesystem::path> paths;
+    for (uint32 i = 0; i < PROJECT_SOURCES; ++i)
+    {
+        paths.push_back(directory / ("routine" + std::to_string(i) + ".asm"));
+        write_source(paths.back(), routine_source(i, 0));
+        assembler.add_source(paths.back());
+    }
+
+    std::vector<bench_result> results;
+    results.push_back(measure("assemble the whole project", min_seconds, [&]()
+    {
+        return uint64{ assembler.assemble().size() > 0 };
+    }));
+
+    JChip8 chip8;
+    chip8.enable_history(false);
+    chip8.load_ROM(assembler.image().data(), assembler.image().size());
+    const std::filesystem::path& edited = paths[PROJECT_SOURCES / 2];
+    std::vector<std::filesystem::path> changed{ edited };
+    uint32 variant = 0;
+    uint64 patched = 0;
+    results.push_back(measure("edit one source, reassemble + patch", min_seconds, [&]()
+    {
+        write_source(edited, routine_source(PROJECT_SOURCES / 2, ++variant));
+        for (const memory_patch& patch : assembler.reassemble(changed))
+        {
+            chip8.patch_memory(patch.address, patch.bytes.data(), patch.bytes.size());
+            patched += patch.bytes.size();
+        }
+        chip8.run(16);
+        return uint64{ 1 };
+    }));
+
+    print_results("Assembler hot reload", results, "op");
+    std::cout << "  " << assembler.image().size() << " byte program in " << PROJECT_SOURCES << " sources, "
+              << assembler.encoded_sources() << " encoded per edit, " << patched / results.back().operations << " bytes patched\n";
+    std::filesystem::remove_all(directory);
+}
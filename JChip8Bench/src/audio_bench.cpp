@@ -0,0 +1,57 @@
+#include "benchmark.h"
+#include "audio_synth.h"
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+void run_audio_benchmarks(double min_seconds)
+{
+    constexpr uint32 SAMPLE_RATE = 44100;
+    constexpr size_t BUFFER_SAMPLES = 1024;
+    std::vector<int16> buffer(BUFFER_SAMPLES);
+
+    std::vector<bench_result> results;
+
+    // What sdl2_handler::audio_callback used to do, kept as the baseline
+    uint32 wave_frequency = 440;
+    int16 volume = 1200;
+    uint32 running_sample_index = 0;
+    results.push_back(measure("naive square, div + mod per sample", min_seconds, [&]()
+    {
+        const uint32 half_period = SAMPLE_RATE / wave_frequency / 2;
+        for (size_t i = 0; i < BUFFER_SAMPLES; ++i)
+            buffer[i] = ((running_sample_index++ / half_period) % 2) ? volume : static_cast<int16>(-volume);
+        return uint64{ 1 };
+    }));
+
+    audio_synth square{ SAMPLE_RATE, volume };
+    square.set_square(wave_frequency);
+    results.push_back(measure("synth fill, square", min_seconds, [&]()
+    {
+        square.fill(buffer.data(), buffer.size());
+        return uint64{ 1 };
+    }));
+
+    const uint8 pattern[16] = { 0x00, 0xFF, 0x0F, 0xF0, 0x33, 0xCC, 0x55, 0xAA, 0x01, 0x80, 0x7E, 0x81, 0x3C, 0xC3, 0x18, 0xE7 };
+    audio_synth xo{ SAMPLE_RATE, volume };
+    xo.set_pattern(pattern, 64);
+    results.push_back(measure("synth fill, XO-CHIP pattern", min_seconds, [&]()
+    {
+        xo.fill(buffer.data(), buffer.size());
+        return uint64{ 1 };
+    }));
+
+    // ROMs that change pitch every frame pay this once per frame on the emulation thread
+    uint8 pitch = 0;
+    results.push_back(measure("set_pattern (re-render loop)", min_seconds, [&]()
+    {
+        xo.set_pattern(pattern, pitch++);
+        return uint64{ 1 };
+    }));
+
+    print_results("Audio synthesis (1024 sample buffers)", results, "buffer");
+
+    double instances = results[1].per_second() * BUFFER_SAMPLES / SAMPLE_RATE;
+    std::cout << std::fixed << std::setprecision(0) << "  one core fills square wave audio for ~" << instances
+              << " instances at " << SAMPLE_RATE << " Hz (loop " << square.loop_length() << " samples)\n";
+}
@@ -0,0 +1,284 @@
+#include "benchmark.h"
+#include "jchip8.h"
+#include <array>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <utility>
+
+// The interpreter as it was before quirk specialisation, kept as the reference the templated engines are
+// measured against: one emulate_cycle per instruction, an instruction history entry every cycle and a
+// switch with the VIP quirks hard-coded.  Addresses aren't masked, as they weren't then, so it only runs
+// the workload ROM, which stays inside memory and the stack.
+namespace
+{
+    class baseline_chip8
+    {
+    public:
+        explicit baseline_chip8(const std::vector<uint8>& rom)
+        {
+            std::memcpy(memory + ROM_START_LOCATION, rom.data(), rom.size());
+        }
+
+        void emulate_cycle()
+        {
+            instruction instr = fetch_instruction();
+            _ip = (_ip + 1) % _history.size();
+            _history[_ip] = std::make_pair(pc, instr);
+            pc += 2;
+            execute_instruction(instr);
+        }
+
+    private:
+        uint8 memory[MEMORY_SIZE] = {};
+        bool graphics[GRAPHICS_WIDTH * GRAPHICS_HEIGHT] = {};
+        uint16 stack[16] = {};
+        uint8 V[16] = {};
+        bool keypad[16] = {};
+        uint16 pc = ROM_START_LOCATION;
+        uint16 I = 0;
+        uint16 sp = 0;
+        uint8 delay_timer = 0;
+        uint8 sound_timer = 0;
+        bool _draw_flag = false;
+        bool _key_pressed = false;
+        uint8 _key = 0xFF;
+        std::mt19937 _rng{ 1 };
+        std::array<std::pair<uint16, instruction>, 1024> _history{};
+        size_t _ip = 0;
+
+        instruction fetch_instruction()
+        {
+            instruction instr
+            {
+                .opcode = static_cast<uint16>(memory[pc] << 8 | memory[pc + 1]),
+                .NNN    = static_cast<uint16>(instr.opcode & 0x0FFF),
+                .NN     = static_cast<uint8>(instr.opcode & 0x00FF),
+                .N      = static_cast<uint8>(instr.opcode & 0x000F),
+                .X      = static_cast<uint8>((instr.opcode & 0x0F00) >> 8),
+                .Y      = static_cast<uint8>((instr.opcode & 0x00F0) >> 4)
+            };
+            return instr;
+        }
+
+        uint8 generate_random_number()
+        {
+            static std::uniform_int_distribution<int> uid(0, std::numeric_limits<uint8>::max());
+            return static_cast<uint8>(uid(_rng));
+        }
+
+        void execute_instruction(const instruction& instr)
+        {
+            bool carry;
+            switch (instr.opcode >> 12)
+            {
+                case 0x00:
+                    if (instr.NN == 0xE0)
+                    {
+                        std::memset(graphics, false, sizeof(graphics));
+                        _draw_flag = true;
+                    }
+                    else if (instr.NN == 0xEE)
+                    {
+                        pc = stack[--sp];
+                    }
+                    break;
+
+                case 0x01:
+                    pc = instr.NNN;
+                    break;
+
+                case 0x02:
+                    stack[sp++] = pc;
+                    pc = instr.NNN;
+                    break;
+
+                case 0x03:
+                    if (V[instr.X] == instr.NN) pc += 2;
+                    break;
+
+                case 0x04:
+                    if (V[instr.X] != instr.NN) pc += 2;
+                    break;
+
+                case 0x05:
+                    if (V[instr.X] == V[instr.Y]) pc += 2;
+                    break;
+
+                case 0x06:
+                    V[instr.X] = instr.NN;
+                    break;
+
+                case 0x07:
+                    V[instr.X] = static_cast<uint8>(V[instr.X] + instr.NN);
+                    break;
+
+                case 0x08:
+                    switch (instr.N)
+                    {
+                        case 0x00: V[instr.X] = V[instr.Y]; break;
+                        case 0x01: V[instr.X] |= V[instr.Y]; V[0xF] = 0; break;
+                        case 0x02: V[instr.X] &= V[instr.Y]; V[0xF] = 0; break;
+                        case 0x03: V[instr.X] ^= V[instr.Y]; V[0xF] = 0; break;
+
+                        case 0x04:
+                            carry = (V[instr.X] + V[instr.Y]) > 255;
+                            V[instr.X] = static_cast<uint8>(V[instr.X] + V[instr.Y]);
+                            V[0xF] = carry;
+                            break;
+
+                        case 0x05:
+                            carry = V[instr.Y] <= V[instr.X];
+                            V[instr.X] = static_cast<uint8>(V[instr.X] - V[instr.Y]);
+                            V[0xF] = carry;
+                            break;
+
+                        case 0x06:
+                            carry = V[instr.Y] & 0x1;
+                            V[instr.X] = static_cast<uint8>(V[instr.Y] >> 1);
+                            V[0xF] = carry;
+                            break;
+
+                        case 0x07:
+                            carry = V[instr.X] <= V[instr.Y];
+                            V[instr.X] = static_cast<uint8>(V[instr.Y] - V[instr.X]);
+                            V[0xF] = carry;
+                            break;
+
+                        case 0x0E:
+                            carry = (V[instr.Y] & 0x80) >> 7;
+                            V[instr.X] = static_cast<uint8>(V[instr.Y] << 1);
+                            V[0xF] = carry;
+                            break;
+                    }
+                    break;
+
+                case 0x09:
+                    if (V[instr.X] != V[instr.Y]) pc += 2;
+                    break;
+
+                case 0x0A:
+                    I = instr.NNN;
+                    break;
+
+                case 0x0B:
+                    pc = static_cast<uint16>(instr.NNN + V[0]);
+                    break;
+
+                case 0x0C:
+                    V[instr.X] = generate_random_number() & instr.NN;
+                    break;
+
+                case 0x0D:
+                {
+                    V[0xF] = 0;
+                    uint8 start_x = V[instr.X];
+                    uint8 start_y = V[instr.Y];
+                    for (uint8 i = 0; i < instr.N; ++i)
+                    {
+                        uint8 sprite = memory[I + i];
+                        uint8 row = static_cast<uint8>(start_y + i);
+                        if (row >= GRAPHICS_HEIGHT)
+                        {
+                            if (start_y >= GRAPHICS_HEIGHT) row %= GRAPHICS_HEIGHT;
+                            else break;
+                        }
+
+                        for (int8 j = 0; j < 8; ++j)
+                        {
+                            uint8 bit = (sprite & 0x80) >> 7;
+                            uint8 col = static_cast<uint8>(start_x + j);
+                            if (col >= GRAPHICS_WIDTH)
+                            {
+                                if (start_x >= GRAPHICS_WIDTH) col %= GRAPHICS_WIDTH;
+                                else break;
+                            }
+
+                            uint16 offset = static_cast<uint16>(row * GRAPHICS_WIDTH + col);
+                            if (bit == 1)
+                            {
+                                if (graphics[offset])
+                                {
+                                    graphics[offset] = false;
+                                    V[0xF] = 1;
+                                }
+                                else
+                                {
+                                    graphics[offset] = true;
+                                }
+                            }
+                            sprite = static_cast<uint8>(sprite << 1);
+                        }
+                        _draw_flag = true;
+                    }
+                    break;
+                }
+
+                case 0x0E:
+                    if (instr.NN == 0x9E && keypad[V[instr.X]]) pc += 2;
+                    else if (instr.NN == 0xA1 && !keypad[V[instr.X]]) pc += 2;
+                    break;
+
+                case 0x0F:
+                    switch (instr.NN)
+                    {
+                        case 0x0A:
+                            for (uint8 i = 0; _key == 0xFF && i < sizeof(keypad); ++i)
+                            {
+                                if (keypad[i])
+                                {
+                                    _key = i;
+                                    _key_pressed = true;
+                                    break;
+                                }
+                            }
+                            if (!_key_pressed || keypad[_key])
+                            {
+                                pc -= 2;
+                            }
+                            else
+                            {
+                                V[instr.X] = _key;
+                                _key = 0xFF;
+                                _key_pressed = false;
+                            }
+                            break;
+
+                        case 0x07: V[instr.X] = delay_timer; break;
+                        case 0x15: delay_timer = V[instr.X]; break;
+                        case 0x18: sound_timer = V[instr.X]; break;
+                        case 0x1E: I = static_cast<uint16>(I + V[instr.X]); break;
+                        case 0x29: I = static_cast<uint16>(V[instr.X] * 5); break;
+
+                        case 0x33:
+                            memory[I + 2] = V[instr.X] % 10;
+                            memory[I + 1] = (V[instr.X] / 10) % 10;
+                            memory[I] = static_cast<uint8>(V[instr.X] / 100);
+                            break;
+
+                        case 0x55:
+                            for (uint8 i = 0; i <= instr.X; ++i)
+                                memory[I++] = V[i];
+                            break;
+
+                        case 0x65:
+                            for (uint8 i = 0; i <= instr.X; ++i)
+                                V[i] = memory[I++];
+                            break;
+                    }
+                    break;
+            }
+        }
+    };
+}
+
+bench_result bench_baseline_interpreter(const std::string& name, double min_seconds)
+{
+    baseline_chip8 chip8{ workload_rom() };
+    return measure(name, min_seconds, [&]()
+    {
+        for (int i = 0; i < 4096; ++i)
+            chip8.emulate_cycle();
+        return uint64{ 4096 };
+    });
+}
@@ -0,0 +1,181 @@
+#include "batch_interpreter.h"
+#include "benchmark.h"
+#include "jchip8.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // A game loop that moves a sprite while keys 5 and 8 are held, then burns 1 to 32 iterations of ALU work
+    // depending on its position before drawing.  Machines given different keys drift apart inside the
+    // inner loop and meet again at its exit and at the top of the frame.
+    const std::vector<uint8> s_input_rom =
+    {
+        0xA0, 0x00,     // 200: I = font '0'
+        0x62, 0x00,     // 202: V2 = 0
+        0x63, 0x00,     // 204: V3 = 0
+        0x60, 0x05,     // 206: V0 = 5
+        0xE0, 0xA1,     // 208: skip unless key V0 held
+        0x72, 0x01,     // 20A: V2 += 1
+        0x60, 0x08,     // 20C: V0 = 8
+        0xE0, 0xA1,     // 20E: skip unless key V0 held
+        0x73, 0x01,     // 210: V3 += 1
+        0x81, 0x20,     // 212: V1 = V2
+        0x64, 0x1F,     // 214: V4 = 0x1F
+        0x81, 0x42,     // 216: V1 &= V4
+        0x71, 0x01,     // 218: V1 += 1
+        0x85, 0x30,     // 21A: V5 = V3
+        0x85, 0x14,     // 21C: V5 += V1
+        0x85, 0x56,     // 21E: V5 >>= 1
+        0x71, 0xFF,     // 220: V1 -= 1
+        0x31, 0x00,     // 222: skip if V1 == 0
+        0x12, 0x1A,     // 224: jump 21A
+        0xD2, 0x35,     // 226: draw at V2, V3
+        0x12, 0x06,     // 228: jump 206
+    };
+
+    struct batch_workload
+    {
+        const char* name;
+        std::vector<uint8> rom;
+        bool random_keys;
+    };
+
+    uint16 frame_keys(std::mt19937& gen, bool random_keys)
+    {
+        if (!random_keys)
+            return 0;
+        uint32 roll = gen() % 4;
+        return static_cast<uint16>((roll & 1 ? 1 << 5 : 0) | (roll & 2 ? 1 << 8 : 0));
+    }
+
+    // Runs the batch and one JChip8 per machine over the same keys and compares every machine's state
+    bool matches_scalar(const batch_workload& workload, uint32 machines, uint16 instructions_per_frame, uint32 frames)
+    {
+        batch_interpreter batch(machines);
+        batch.load_ROM(workload.rom.data(), workload.rom.size());
+        std::vector<std::unique_ptr<JChip8>> scalar;
+        for (uint32 m = 0; m < machines; ++m)
+        {
+            scalar.push_back(std::make_unique<JChip8>());
+            // The batch only ticks its timers when told to, as JChip8 does on the host clock
+            scalar[m]->set_timer_clock(timer_clock::host);
+            scalar[m]->load_ROM(workload.rom.data(), workload.rom.size());
+            scalar[m]->seed_rng(m + 1);
+            batch.seed_rng(m, m + 1);
+        }
+
+        std::mt19937 gen(7);
+        for (uint32 frame = 0; frame < frames; ++frame)
+        {
+            for (uint32 m = 0; m < machines; ++m)
+            {
+                uint16 keys = frame_keys(gen, workload.random_keys);
+                batch.set_keys(m, keys);
+                scalar[m]->keypad = keys;
+                scalar[m]->run(instructions_per_frame);
+                scalar[m]->tick_timers();
+            }
+            batch.run(instructions_per_frame);
+            batch.tick_timers();
+        }
+
+        machine_state expected;
+        machine_state actual;
+        for (uint32 m = 0; m < machines; ++m)
+        {
+            scalar[m]->capture_state(expected);
+            batch.capture_state(m, actual);
+            if (std::memcmp(&expected, &actual, sizeof(machine_state)) != 0)
+                return false;
+        }
+        return true;
+    }
+}
+
+void run_batch_benchmarks(double min_seconds)
+{
+    const uint16 instructions_per_frame = 1000;
+    const uint32 frames_per_call = 8;
+    std::vector<batch_workload> workloads =
+    {
+        { "workload ROM, identical machines", workload_rom(), false },
+        { "input-driven ROM, random keys", s_input_rom, true },
+    };
+
+    std::vector<bench_result> results;
+    std::vector<std::string> notes;
+    for (const batch_workload& workload : workloads)
+    {
+        for (uint32 machines : { 64u, 1024u })
+        {
+            std::string suffix = std::string(workload.name) + ", " + std::to_string(machines);
+
+            // Keys are drawn up front so both sides spend their time emulating rather than in the generator
+            std::mt19937 gen(7);
+            std::vector<uint16> keys(static_cast<size_t>(machines) * frames_per_call);
+            for (uint16& k : keys)
+                k = frame_keys(gen, workload.random_keys);
+
+            std::vector<std::unique_ptr<JChip8>> scalar;
+            for (uint32 m = 0; m < machines; ++m)
+            {
+                scalar.push_back(std::make_unique<JChip8>());
+                scalar[m]->load_ROM(workload.rom.data(), workload.rom.size());
+            }
+            results.push_back(measure("scalar, " + suffix, min_seconds, [&]()
+            {
+                uint64 executed = 0;
+                for (uint32 frame = 0; frame < frames_per_call; ++frame)
+                {
+                    for (uint32 m = 0; m < machines; ++m)
+                    {
+                        uint16 held = keys[frame * machines + m];
+                        scalar[m]->keypad = held;
+                        executed += scalar[m]->run(instructions_per_frame);
+                        scalar[m]->tick_timers();
+                    }
+                }
+                return executed;
+            }));
+
+            batch_interpreter batch(machines);
+            batch.load_ROM(workload.rom.data(), workload.rom.size());
+            results.push_back(measure("batch,  " + suffix, min_seconds, [&]()
+            {
+                uint64 executed = 0;
+                for (uint32 frame = 0; frame < frames_per_call; ++frame)
+                {
+                    for (uint32 m = 0; m < machines; ++m)
+                        batch.set_keys(m, keys[frame * machines + m]);
+                    executed += batch.run(instructions_per_frame);
+                    batch.tick_timers();
+                }
+                return executed;
+            }));
+
+            const batch_stats& stats = batch.stats();
+            std::ostringstream note;
+            note << std::fixed << std::setprecision(2) << suffix << ": "
+                 << results[results.size() - 1].per_second() / results[results.size() - 2].per_second() << "x scalar, "
+                 << std::setprecision(1) << stats.occupancy() << " machines per issue, "
+                 << 100.0 * static_cast<double>(stats.divergent_issues) / static_cast<double>(std::max<uint64>(stats.issues, 1))
+                 << "% divergent issues, "
+                 << 100.0 * static_cast<double>(stats.scalar_cycles) / static_cast<double>(std::max<uint64>(stats.machine_cycles, 1))
+                 << "% scalar cycles, "
+                 << (matches_scalar(workload, machines, instructions_per_frame, 32) ? "matches" : "DIFFERS FROM") << " JChip8";
+            notes.push_back(note.str());
+        }
+    }
+
+    print_results("Batch interpreter (machine-cycles)", results, "cycle");
+    for (const std::string& note : notes)
+        std::cout << "  " << note << '\n';
+}
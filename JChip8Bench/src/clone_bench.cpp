@@ -0,0 +1,131 @@
+#include "benchmark.h"
+#include "jchip8.h"
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+    // Grows a search tree breadth first: every frontier node is restored, tried under each key, run for a
+    // frame and captured as a child, then the first beam_width children become the next frontier
+    uint64 expand_tree(JChip8& chip8, const machine_clone& root, uint32 depth, uint32 beam_width, std::vector<machine_clone>& tree)
+    {
+        static constexpr uint8 branch_keys[] = { 0x4, 0x5, 0x6, 0x8 };
+
+        std::vector<machine_clone> frontier{ root };
+        std::vector<machine_clone> children;
+        uint64 expanded = 0;
+        for (uint32 level = 0; level < depth; ++level)
+        {
+            children.clear();
+            for (const machine_clone& parent : frontier)
+            {
+                for (uint8 key : branch_keys)
+                {
+                    chip8.restore_clone(parent);
+                    chip8.set_key(key, true);
+                    chip8.run_frame();
+                    children.emplace_back();
+                    chip8.capture_clone(children.back());
+                    ++expanded;
+                }
+            }
+            tree.insert(tree.end(), children.begin(), children.end());
+            frontier.assign(children.begin(), children.begin() + static_cast<std::ptrdiff_t>(std::min<size_t>(children.size(), beam_width)));
+        }
+        return expanded;
+    }
+}
+
+void run_clone_benchmarks(double min_seconds)
+{
+    const std::vector<uint8>& rom = workload_rom();
+    JChip8 chip8;
+    chip8.enable_history(false);
+    chip8.load_ROM(rom.data(), rom.size());
+    for (int i = 0; i < 60; ++i)
+        chip8.run_frame();
+
+    std::vector<bench_result> results;
+    machine_clone clone;
+    machine_state state;
+    chip8.capture_clone(clone);
+    chip8.capture_state(state);
+    results.push_back(measure("copy machine_clone", min_seconds, [&]()
+    {
+        std::vector<machine_clone> copies(256, clone);
+        return uint64{ copies.size() };
+    }));
+    results.push_back(measure("copy machine_state", min_seconds, [&]()
+    {
+        std::vector<machine_state> copies(256, state);
+        return uint64{ copies.size() };
+    }));
+
+    results.push_back(measure("emulate one frame + capture_clone", min_seconds, [&]()
+    {
+        chip8.run_frame();
+        chip8.capture_clone(clone);
+        return uint64{ 1 };
+    }));
+    results.push_back(measure("emulate one frame + capture_state", min_seconds, [&]()
+    {
+        chip8.run_frame();
+        chip8.capture_state(state);
+        return uint64{ 1 };
+    }));
+
+    // Flipping between two neighbouring frames, the way a search backtracks to a sibling
+    machine_clone before;
+    machine_clone after;
+    chip8.capture_clone(before);
+    chip8.run_frame();
+    chip8.capture_clone(after);
+    results.push_back(measure("restore_clone, neighbouring frames", min_seconds, [&]()
+    {
+        chip8.restore_clone(before);
+        chip8.restore_clone(after);
+        return uint64{ 2 };
+    }));
+    machine_state state_before;
+    machine_state state_after;
+    chip8.restore_clone(before);
+    chip8.capture_state(state_before);
+    chip8.restore_clone(after);
+    chip8.capture_state(state_after);
+    results.push_back(measure("restore_state, neighbouring frames", min_seconds, [&]()
+    {
+        chip8.restore_state(state_before);
+        chip8.restore_state(state_after);
+        return uint64{ 2 };
+    }));
+
+    const uint32 depth = 12;
+    const uint32 beam_width = 64;
+    std::vector<machine_clone> tree;
+    results.push_back(measure("beam search node (restore, frame, capture)", min_seconds, [&]()
+    {
+        tree.clear();
+        return expand_tree(chip8, before, depth, beam_width, tree);
+    }));
+
+    print_results("State cloning", results, "op");
+
+    // Pages shared between nodes are counted once, which is what the tree actually holds in memory
+    std::unordered_set<const clone_page*> pages;
+    for (const machine_clone& node : tree)
+    {
+        for (const std::shared_ptr<const clone_page>& page : node.pages)
+            pages.insert(page.get());
+    }
+    double page_bytes = static_cast<double>(pages.size() * sizeof(clone_page));
+    double clone_bytes = static_cast<double>(tree.size() * sizeof(machine_clone));
+    double bytes_per_node = (page_bytes + clone_bytes) / static_cast<double>(std::max<size_t>(tree.size(), 1));
+    std::cout << std::fixed << std::setprecision(1)
+              << "  beam search, depth " << depth << ", width " << beam_width << ": " << tree.size() << " nodes sharing "
+              << pages.size() << " pages, " << bytes_per_node << " bytes/node (" << sizeof(machine_clone)
+              << " bytes of clone, " << sizeof(machine_state) << " bytes per machine_state)\n";
+}
@@ -0,0 +1,51 @@
+#include "benchmark.h"
+#include "jchip8_api.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+void run_core_api_benchmarks(double min_seconds, const std::string& rom_path)
+{
+    std::ifstream file(rom_path, std::ios::binary);
+    std::vector<uint8> rom{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+    // What an embedder pays to get a headless machine to its first frame
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    jchip8_core* core = jchip8_create(1000);
+    if (!core || jchip8_load_rom(core, rom.data(), rom.size(), JCHIP8_QUIRKS_DEFAULT) != JCHIP8_OK)
+        throw std::runtime_error("Could not start the core");
+    jchip8_run_frame(core);
+    double first_frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<bench_result> results;
+    results.push_back(measure("create + load_rom + destroy", min_seconds, [&]()
+    {
+        jchip8_core* scratch = jchip8_create(1000);
+        jchip8_load_rom(scratch, rom.data(), rom.size(), JCHIP8_QUIRKS_DEFAULT);
+        jchip8_destroy(scratch);
+        return uint64{ 1 };
+    }));
+
+    results.push_back(measure("jchip8_run in 10000 cycle batches", min_seconds, [&]()
+    {
+        return uint64{ jchip8_run(core, 10000) };
+    }));
+
+    std::vector<uint8> state(jchip8_state_size());
+    results.push_back(measure("save_state + load_state", min_seconds, [&]()
+    {
+        jchip8_save_state(core, state.data(), state.size());
+        jchip8_load_state(core, state.data(), state.size());
+        return uint64{ 1 };
+    }));
+
+    jchip8_destroy(core);
+
+    print_results("Core C API", results, "op");
+    std::cout << std::fixed << std::setprecision(3)
+              << "  headless start to first frame: " << first_frame_ms << " ms, state blob " << state.size() << " bytes\n";
+}
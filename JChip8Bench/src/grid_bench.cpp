@@ -0,0 +1,52 @@
+#include "benchmark.h"
+#include "grid_atlas.h"
+#include "jchip8.h"
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// The CPU side of the grid view: packing changed screens into the atlas.  The GPU side is one texture
+// upload per changed cell and one draw, where drawing each machine as rectangles would be a fill call per pixel.
+void run_grid_benchmarks(double min_seconds)
+{
+    const uint32 columns = 8;
+    const uint32 rows = 8;
+    const std::vector<uint8>& rom = workload_rom();
+    std::vector<std::unique_ptr<JChip8>> machines;
+    for (uint32 i = 0; i < columns * rows; ++i)
+    {
+        machines.push_back(std::make_unique<JChip8>());
+        machines[i]->load_ROM(rom.data(), rom.size());
+    }
+
+    grid_atlas atlas{ columns, rows, 0x66CCFFFF, 0x003366FF };
+    std::vector<bench_result> results;
+    results.push_back(measure("pack every cell of an 8x8 wall", min_seconds, [&]()
+    {
+        for (uint32 i = 0; i < atlas.cells(); ++i)
+            atlas.update(i, machines[i]->graphics);
+        atlas.clear_dirty();
+        return uint64{ 1 };
+    }));
+
+    uint64 frames = 0;
+    uint64 uploads = 0;
+    results.push_back(measure("emulate + pack an 8x8 wall", min_seconds, [&]()
+    {
+        for (uint32 i = 0; i < atlas.cells(); ++i)
+        {
+            machines[i]->run_frame();
+            atlas.update(i, *machines[i]);
+        }
+        uploads += atlas.dirty_cells().size();
+        atlas.clear_dirty();
+        ++frames;
+        return uint64{ 1 };
+    }));
+
+    print_results("Grid view atlas", results, "frame");
+    std::cout << std::fixed << std::setprecision(1) << "  " << static_cast<double>(uploads) / static_cast<double>(frames)
+              << " cell uploads and 1 draw call per frame, against " << columns * rows * GRAPHICS_WIDTH * GRAPHICS_HEIGHT
+              << " rectangle fills drawing each machine directly\n";
+}
@@ -0,0 +1,52 @@
+#include "benchmark.h"
+#include "chip8_hooks.h"
+#include "jchip8.h"
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    bench_result bench_hooks(const std::string& name, const chip8_hooks* hooks, double min_seconds)
+    {
+        return measure_run(name, min_seconds, [&](JChip8& chip8)
+        {
+            const std::vector<uint8>& rom = workload_rom();
+            chip8.attach_hooks(hooks);
+            chip8.load_ROM(rom.data(), rom.size());
+        });
+    }
+}
+
+void run_hooks_benchmarks(double min_seconds)
+{
+    // What a scoring or achievement plugin does: count, and look at the odd address
+    uint64 instructions = 0;
+    uint64 writes = 0;
+    uint64 frames = 0;
+    uint64 loads = 0;
+
+    chip8_hooks frame_only;
+    frame_only.on_frame = [&](JChip8&) { ++frames; };
+    frame_only.on_rom_loaded = [&](JChip8&, const uint8*, size_t) { ++loads; };
+
+    chip8_hooks instruction_only;
+    instruction_only.on_instruction = [&](JChip8&, uint16 address, const instruction&) { instructions += address != 0; };
+
+    chip8_hooks all;
+    all.on_instruction = instruction_only.on_instruction;
+    all.on_memory_write = [&](JChip8&, uint16 address, uint8 value) { writes += (address ^ value) != 0; };
+    all.on_frame = frame_only.on_frame;
+    all.on_sound_start = [&](JChip8&) { ++frames; };
+    all.on_rom_loaded = frame_only.on_rom_loaded;
+
+    // No hooks and frame-only hooks should both run the plain engine at the same speed
+    std::vector<bench_result> results;
+    results.push_back(bench_hooks("run(), no hooks", nullptr, min_seconds));
+    results.push_back(bench_hooks("run(), frame + ROM hooks only", &frame_only, min_seconds));
+    results.push_back(bench_hooks("run(), instruction hook", &instruction_only, min_seconds));
+    results.push_back(bench_hooks("run(), every hook", &all, min_seconds));
+
+    print_results("Plugin hooks", results, "instr");
+    std::cout << "  hooks saw " << instructions << " instructions, " << writes << " writes, " << frames << " frames and "
+              << loads << " ROM loads\n";
+}
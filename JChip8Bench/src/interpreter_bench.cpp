@@ -0,0 +1,106 @@
+#include "benchmark.h"
+#include "chip8_quirks.h"
+#include "debugger.h"
+#include "jchip8.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    bench_result bench_quirks(const std::string& name, const std::string& rom_path, const chip8_quirks& quirks, double min_seconds,
+        debugger* dbg = nullptr)
+    {
+        return measure_run(name, min_seconds, [&](JChip8& chip8)
+        {
+            chip8.load_ROM(rom_path.c_str(), quirks);
+            chip8.attach_debugger(dbg);
+        });
+    }
+
+    // Emulated time rather than an instruction count: the core runs straight through to each 60 Hz event
+    bench_result bench_run_until(const std::string& name, const std::string& rom_path, const chip8_quirks& quirks, double min_seconds)
+    {
+        JChip8 chip8;
+        chip8.load_ROM(rom_path.c_str(), quirks);
+
+        return measure(name, min_seconds, [&]()
+        {
+            return chip8.run_until(chip8.cycles() + 64 * 1024);
+        });
+    }
+}
+
+std::string write_workload_rom()
+{
+    return write_temp_rom("jchip8_bench_workload.ch8", workload_rom());
+}
+
+void run_interpreter_benchmarks(double min_seconds)
+{
+    std::string rom_path = write_workload_rom();
+
+    chip8_quirks modern;
+    modern.shift_uses_vy = false;
+    modern.load_store_increments_i = false;
+    modern.logic_resets_vf = false;
+    modern.clip_sprites = false;
+
+    chip8_quirks mixed;
+    mixed.shift_uses_vy = false;
+    mixed.logic_resets_vf = false;
+
+    std::vector<bench_result> results;
+    results.push_back(bench_quirks("run(), default quirks (VIP)", rom_path, chip8_quirks{}, min_seconds));
+    results.push_back(bench_quirks("run(), modern quirks", rom_path, modern, min_seconds));
+    results.push_back(bench_quirks("run(), mixed quirks", rom_path, mixed, min_seconds));
+
+    // With the display wait quirk each draw idles out the rest of its frame, so fewer instructions run per cycle
+    chip8_quirks display_wait;
+    display_wait.display_wait = true;
+    results.push_back(bench_run_until("run_until(), default quirks", rom_path, chip8_quirks{}, min_seconds));
+    results.push_back(bench_run_until("run_until(), display wait", rom_path, display_wait, min_seconds));
+
+    // An idle debugger must leave the plain engine in place; a watchpoint nothing touches shows the instrumented cost
+    debugger idle_debugger;
+    debugger watching_debugger;
+    watching_debugger.add_watchpoint(watchpoint{ 0xF00, 0xF00, WATCH_READ | WATCH_WRITE });
+    results.push_back(bench_quirks("run(), idle debugger attached", rom_path, chip8_quirks{}, min_seconds, &idle_debugger));
+    results.push_back(bench_quirks("run(), instrumented (1 watchpoint)", rom_path, chip8_quirks{}, min_seconds, &watching_debugger));
+
+    // The interpreter before quirk specialisation, against the same one-instruction-at-a-time dispatch today
+    results.push_back(bench_baseline_interpreter("baseline interpreter, emulate_cycle()", min_seconds));
+    {
+        JChip8 chip8;
+        chip8.load_ROM(rom_path.c_str());
+        results.push_back(measure("emulate_cycle(), default quirks", min_seconds, [&]()
+        {
+            for (int i = 0; i < 4096; ++i)
+                chip8.emulate_cycle();
+            return uint64{ 4096 };
+        }));
+    }
+
+    // Hundreds of machines in one process, each running a short slice in turn, so every switch to the next
+    // machine starts with its state out of L1 and the size of the hot part of JChip8 shows up in the rate
+    {
+        const uint32 machine_count = 512;
+        std::vector<std::unique_ptr<JChip8>> machines;
+        for (uint32 i = 0; i < machine_count; ++i)
+        {
+            machines.push_back(std::make_unique<JChip8>());
+            machines[i]->enable_history(false);
+            machines[i]->load_ROM(rom_path.c_str());
+        }
+        results.push_back(measure("run(), 512 machines, 16 instr slices", min_seconds, [&]()
+        {
+            uint64 executed = 0;
+            for (const std::unique_ptr<JChip8>& machine : machines)
+                executed += machine->run(16);
+            return executed;
+        }));
+    }
+
+    print_results("Interpreter throughput", results, "instr");
+    std::cout << "  sizeof(JChip8) " << sizeof(JChip8) << " bytes, sizeof(machine_state) " << sizeof(machine_state) << " bytes\n";
+}
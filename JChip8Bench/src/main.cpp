@@ -0,0 +1,54 @@
+#include "benchmark.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+void print_results(const std::string& title, const std::vector<bench_result>& results, const char* unit)
+{
+    std::cout << "\n== " << title << " ==\n";
+    for (const bench_result& result : results)
+    {
+        std::cout << "  " << std::left << std::setw(40) << result.name << std::right
+                  << std::setw(14) << std::fixed << std::setprecision(2) << result.per_second() / 1e6 << " M" << unit << "/s"
+                  << std::setw(12) << std::setprecision(2) << result.ns_per_op() << " ns/op\n";
+    }
+}
+
+std::string write_temp_rom(const std::string& name, const std::vector<uint8>& rom)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Could not write benchmark ROM");
+
+    file.write(reinterpret_cast<const char*>(rom.data()), static_cast<std::streamsize>(rom.size()));
+    return path.string();
+}
+
+int main(int argc, char* argv[])
+{
+    // --quick trades accuracy for a fast smoke run of every benchmark
+    double min_seconds = 1.0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0)
+            min_seconds = 0.05;
+    }
+
+    run_interpreter_benchmarks(min_seconds);
+    run_recompiled_benchmarks(min_seconds);
+    run_hooks_benchmarks(min_seconds);
+    run_batch_benchmarks(min_seconds);
+    run_clone_benchmarks(min_seconds);
+    std::string workload = write_workload_rom();
+    run_core_api_benchmarks(min_seconds, workload);
+    run_rewind_benchmarks(min_seconds, workload);
+    run_run_ahead_benchmarks(min_seconds, workload);
+    run_recorder_benchmarks(min_seconds, workload);
+    run_audio_benchmarks(min_seconds);
+    run_grid_benchmarks(min_seconds);
+    run_assembler_benchmarks(min_seconds);
+    run_metrics_benchmarks(min_seconds);
+    return 0;
+}
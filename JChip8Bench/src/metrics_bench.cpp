@@ -0,0 +1,65 @@
+#include "benchmark.h"
+#include "emulator_metrics.h"
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Everything the main loop records in one presented frame
+    void record_pass(emulator_metrics& metrics, uint64 frame)
+    {
+        metrics.record_draw(40'000);
+        metrics.record_present(250'000);
+        metrics.record_frame(11, true, 1'000'000 + (frame & 0xFFFF) * 256);
+    }
+}
+
+void run_metrics_benchmarks(double min_seconds)
+{
+    std::vector<bench_result> results;
+
+    emulator_metrics metrics;
+    metrics.set_target_ips(700);
+    metrics.set_rom("roms/workload.ch8");
+    uint64 frame = 0;
+    results.push_back(measure("record a frame", min_seconds, [&]()
+    {
+        for (int i = 0; i < 1024; ++i)
+            record_pass(metrics, frame++);
+        return uint64{ 1024 };
+    }));
+
+    // A scraper far more eager than any Prometheus job, to show scrapes don't hold the main loop up
+    std::atomic<bool> stopping{ false };
+    std::atomic<uint64> scrapes{ 0 };
+    std::thread scraper([&]()
+    {
+        while (!stopping.load(std::memory_order_acquire))
+        {
+            std::string text = metrics.format();
+            scrapes.fetch_add(text.empty() ? 0 : 1, std::memory_order_relaxed);
+        }
+    });
+    results.push_back(measure("record a frame, scraped continuously", min_seconds, [&]()
+    {
+        for (int i = 0; i < 1024; ++i)
+            record_pass(metrics, frame++);
+        return uint64{ 1024 };
+    }));
+    stopping.store(true, std::memory_order_release);
+    scraper.join();
+
+    size_t size = 0;
+    results.push_back(measure("format (one scrape)", min_seconds, [&]()
+    {
+        size = metrics.format().size();
+        return uint64{ 1 };
+    }));
+
+    print_results("Metrics", results, "op");
+    std::cout << std::fixed << std::setprecision(0) << "  " << scrapes.load() << " scrapes ran alongside the second run, "
+              << size << " bytes each\n";
+}
@@ -0,0 +1,98 @@
+#include "benchmark.h"
+#include "chip8_quirks.h"
+#include "jchip8.h"
+#include "recompiled.h"
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Generated from the workload and game ROMs at build time by JChip8Recomp --symbol
+extern const recompiled_program workload_recompiled_default;
+extern const recompiled_program workload_recompiled_modern;
+extern const recompiled_program game_recompiled_default;
+extern const recompiled_program game_recompiled_modern;
+
+namespace
+{
+    bench_result bench_run(const std::string& name, const std::vector<uint8>& rom, const chip8_quirks& quirks,
+        const recompiled_program* program, double min_seconds)
+    {
+        return measure_run(name, min_seconds, [&](JChip8& chip8)
+        {
+            chip8.load_ROM(rom.data(), rom.size(), quirks);
+            chip8.attach_recompiled(program);
+        });
+    }
+
+    bool same_state(const machine_state& a, const machine_state& b)
+    {
+        return a.cycles == b.cycles && a.pc == b.pc && a.I == b.I && a.sp == b.sp && a.delay_timer == b.delay_timer
+            && a.sound_timer == b.sound_timer && a.rng_state == b.rng_state && a.vblank_wait == b.vblank_wait && a.sound_playing == b.sound_playing
+            && std::memcmp(a.V, b.V, sizeof(a.V)) == 0 && std::memcmp(a.stack, b.stack, sizeof(a.stack)) == 0
+            && std::memcmp(a.memory, b.memory, sizeof(a.memory)) == 0 && std::memcmp(a.graphics, b.graphics, sizeof(a.graphics)) == 0;
+    }
+
+    // Runs both machines frame by frame and compares the whole state after each one
+    bool matches_interpreter(const std::vector<uint8>& rom, const chip8_quirks& quirks, const recompiled_program* program, uint32 frames)
+    {
+        JChip8 interpreted;
+        JChip8 recompiled;
+        interpreted.load_ROM(rom.data(), rom.size(), quirks);
+        recompiled.load_ROM(rom.data(), rom.size(), quirks);
+        recompiled.attach_recompiled(program);
+        interpreted.seed_rng(1);
+        recompiled.seed_rng(1);
+
+        machine_state expected;
+        machine_state actual;
+        for (uint32 frame = 0; frame < frames; ++frame)
+        {
+            interpreted.run_frame();
+            recompiled.run_frame();
+            interpreted.capture_state(expected);
+            recompiled.capture_state(actual);
+            if (!same_state(expected, actual))
+                return false;
+        }
+        return recompiled.recompiled_active();
+    }
+}
+
+void run_recompiled_benchmarks(double min_seconds)
+{
+    chip8_quirks modern;
+    modern.shift_uses_vy = false;
+    modern.load_store_increments_i = false;
+    modern.logic_resets_vf = false;
+    modern.clip_sprites = false;
+
+    struct
+    {
+        const char* title;
+        const std::vector<uint8>& rom;
+        const recompiled_program& default_program;
+        const recompiled_program& modern_program;
+    } const roms[] =
+    {
+        { "Recompiled workload", workload_rom(), workload_recompiled_default, workload_recompiled_modern },
+        { "Recompiled game", game_rom(), game_recompiled_default, game_recompiled_modern },
+    };
+
+    for (const auto& rom : roms)
+    {
+        std::vector<bench_result> results;
+        results.push_back(bench_run("run(), default quirks, interpreted", rom.rom, chip8_quirks{}, nullptr, min_seconds));
+        results.push_back(bench_run("run(), default quirks, recompiled", rom.rom, chip8_quirks{}, &rom.default_program, min_seconds));
+        results.push_back(bench_run("run(), modern quirks, interpreted", rom.rom, modern, nullptr, min_seconds));
+        results.push_back(bench_run("run(), modern quirks, recompiled", rom.rom, modern, &rom.modern_program, min_seconds));
+
+        print_results(rom.title, results, "instr");
+        std::cout << "  default quirks: recompiled " << (matches_interpreter(rom.rom, chip8_quirks{}, &rom.default_program, 600) ? "matches" : "DIFFERS FROM")
+                  << " the interpreter over 600 frames\n";
+        std::cout << "  modern quirks: recompiled " << (matches_interpreter(rom.rom, modern, &rom.modern_program, 600) ? "matches" : "DIFFERS FROM")
+                  << " the interpreter over 600 frames\n";
+        std::cout << std::fixed << std::setprecision(2) << "  recompiled speedup: " << results[1].per_second() / results[0].per_second() << "x default, "
+                  << results[3].per_second() / results[2].per_second() << "x modern\n";
+    }
+}
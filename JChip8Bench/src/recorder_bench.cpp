@@ -0,0 +1,65 @@
+#include "benchmark.h"
+#include "emulator_config.h"
+#include "jchip8.h"
+#include "video_recorder.h"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+void run_recorder_benchmarks(double min_seconds, const std::string& rom_path)
+{
+    JChip8 chip8;
+    chip8.load_ROM(rom_path.c_str());
+    emulator_config config;
+
+    std::vector<bench_result> results;
+    // The emulation thread only pays for packing and queueing the frame, the writer does the rest
+    uint8 packed[video_recorder::FRAME_BYTES];
+    results.push_back(measure("pack framebuffer", min_seconds, [&]()
+    {
+        pack_framebuffer(chip8.graphics, packed);
+        return uint64{ 1 };
+    }));
+
+    std::string base = (std::filesystem::temp_directory_path() / "jchip8_bench_recording").string();
+    std::vector<std::string> notes;
+    for (recording_format format : { recording_format::gif, recording_format::y4m_wav })
+    {
+        video_recorder recorder;
+        recorder.start(base, format, config);
+        const char* name = format == recording_format::gif ? "submit, GIF writer running" : "submit, Y4M + WAV writer running";
+
+        // Only the submit is timed, the frames in between are emulated so the writer sees real content.
+        // Capped at a minute of gameplay, since uncompressed video fills the disk quickly.
+        bench_result submit{ name, 0, 0.0 };
+        while (submit.seconds < min_seconds && submit.operations < 60 * 60)
+        {
+            chip8.run(std::numeric_limits<uint16>::max());
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            recorder.submit(chip8);
+            submit.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            ++submit.operations;
+        }
+        results.push_back(submit);
+        recorder.stop();
+
+        recorder_stats stats = recorder.stats();
+        std::ostringstream note;
+        note << std::fixed << std::setprecision(1) << name << ": " << stats.frames_submitted << " frames, " << stats.unique_frames
+             << " unique, " << stats.frames_dropped << " dropped, " << static_cast<double>(stats.bytes_written) / 1024.0 << " KB";
+        notes.push_back(note.str());
+    }
+
+    std::filesystem::remove(base + ".gif");
+    std::filesystem::remove(base + ".y4m");
+    std::filesystem::remove(base + ".wav");
+
+    print_results("Video recorder", results, "frame");
+    for (const std::string& note : notes)
+        std::cout << "  " << note << '\n';
+}
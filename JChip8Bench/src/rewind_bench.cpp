@@ -0,0 +1,48 @@
+#include "benchmark.h"
+#include "jchip8.h"
+#include "rewind_buffer.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+void run_rewind_benchmarks(double min_seconds, const std::string& rom_path)
+{
+    JChip8 chip8;
+    chip8.load_ROM(rom_path.c_str());
+    rewind_buffer rewind{ 300 * 60, 64ull * 1024 * 1024 };
+
+    std::vector<bench_result> results;
+    results.push_back(measure("emulate one frame + capture", min_seconds, [&]()
+    {
+        chip8.run(std::numeric_limits<uint16>::max());
+        rewind.capture(chip8);
+        return uint64{ 1 };
+    }));
+
+    // Rewinding runs out of history, so refill outside the timed region whenever it does
+    bench_result step_back{ "step_back", 0, 0.0 };
+    while (step_back.seconds < min_seconds)
+    {
+        for (int i = 0; i < 600; ++i)
+        {
+            chip8.run(std::numeric_limits<uint16>::max());
+            rewind.capture(chip8);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        while (rewind.step_back(chip8))
+            ++step_back.operations;
+        step_back.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    results.push_back(step_back);
+
+    print_results("Rewind buffer", results, "frame");
+
+    rewind_stats stats = rewind.stats();
+    double five_minutes_mb = stats.avg_bytes_per_frame * 300 * 60 / (1024.0 * 1024.0);
+    std::cout << std::fixed << std::setprecision(2)
+              << "  capture cost " << stats.avg_capture_us << " us avg, " << stats.avg_bytes_per_frame << " bytes/frame ("
+              << sizeof(machine_state) << " bytes uncompressed), ~" << five_minutes_mb << " MB per 5 minutes at 60 Hz\n";
+}
@@ -0,0 +1,48 @@
+#include "benchmark.h"
+#include "jchip8.h"
+#include "run_ahead.h"
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+void run_run_ahead_benchmarks(double min_seconds, const std::string& rom_path)
+{
+    JChip8 chip8;
+    // The fastest speed there is, so every frame is as heavy as one can get
+    chip8.ips = std::numeric_limits<uint16>::max();
+    chip8.load_ROM(rom_path.c_str());
+    chip8.state = emulator_state::running;
+    run_ahead ahead;
+
+    std::vector<bench_result> results;
+    results.push_back(measure("save + restore only", min_seconds, [&]()
+    {
+        ahead.advance(chip8, 0);
+        ahead.restore(chip8);
+        return uint64{ 1 };
+    }));
+
+    for (uint32 frames = 0; frames <= 4; frames = frames ? frames * 2 : 1)
+    {
+        std::string name = frames ? "frame + run-ahead " + std::to_string(frames) : "frame, no run-ahead";
+        results.push_back(measure(name, min_seconds, [&]()
+        {
+            chip8.run_frame();
+            if (frames)
+            {
+                ahead.advance(chip8, frames);
+                ahead.restore(chip8);
+            }
+            return uint64{ 1 };
+        }));
+    }
+
+    print_results("Run-ahead", results, "frame");
+
+    double base = results[1].ns_per_op();
+    std::cout << std::fixed << std::setprecision(2);
+    for (size_t i = 2; i < results.size(); ++i)
+        std::cout << "  " << results[i].name << ": " << results[i].ns_per_op() / base << "x the cost of a plain frame\n";
+}
@@ -0,0 +1,120 @@
+#include "benchmark.h"
+#include <vector>
+
+namespace
+{
+    // A tight loop of ALU, shift, logic and load/store work with a draw every 246 iterations,
+    // roughly the instruction mix of the Timendus test ROMs.
+    const std::vector<uint8> s_workload_rom =
+    {
+        0xA3, 0x00,     // 200: I = 0x300
+        0x60, 0x05,     // 202: V0 = 5
+        0x61, 0x0A,     // 204: V1 = 10
+        0x80, 0x14,     // 206: V0 += V1
+        0x80, 0x16,     // 208: V0 >>= 1
+        0x80, 0x1E,     // 20A: V0 <<= 1
+        0x80, 0x11,     // 20C: V0 |= V1
+        0x80, 0x12,     // 20E: V0 &= V1
+        0x80, 0x13,     // 210: V0 ^= V1
+        0x71, 0x01,     // 212: V1 += 1
+        0xA3, 0x00,     // 214: I = 0x300
+        0xF2, 0x55,     // 216: store V0..V2 at I
+        0xA3, 0x00,     // 218: I = 0x300
+        0xF2, 0x65,     // 21A: load V0..V2 from I
+        0xF0, 0x33,     // 21C: BCD of V0 at I
+        0x31, 0x00,     // 21E: skip if V1 == 0
+        0x12, 0x06,     // 220: jump 206
+        0xA0, 0x00,     // 222: I = font '0'
+        0xD0, 0x15,     // 224: draw
+        0x12, 0x00,     // 226: jump 200
+    };
+
+    // A small game in the shape most ROMs take: a frame loop that waits out the delay timer, then erases, moves
+    // and redraws a ball, a paddle that chases it and a score, through subroutines.  Most of its instructions are
+    // the timer poll and it draws five sprites a frame, where the workload above is all arithmetic.
+    const std::vector<uint8> s_game_rom =
+    {
+        0x00, 0xE0,     // 200: clear
+        0x6A, 0x00,     // 202: VA = 0, the score
+        0x6B, 0x20,     // 204: VB = 32, ball x
+        0x6C, 0x10,     // 206: VC = 16, ball y
+        0x6D, 0x01,     // 208: VD = 1, ball dx
+        0x6E, 0x01,     // 20A: VE = 1, ball dy
+        0x68, 0x1C,     // 20C: V8 = 28, paddle x
+        0x22, 0x24,     // 20E: call draw_all
+        0x60, 0x02,     // 210: V0 = 2
+        0xF0, 0x15,     // 212: delay timer = V0
+        0xF0, 0x07,     // 214: V0 = delay timer
+        0x30, 0x00,     // 216: skip if V0 == 0
+        0x12, 0x14,     // 218: jump 214
+        0x22, 0x24,     // 21A: call draw_all, erasing
+        0x22, 0x3C,     // 21C: call move_paddle
+        0x22, 0x58,     // 21E: call move_ball
+        0x22, 0x24,     // 220: call draw_all
+        0x12, 0x10,     // 222: jump 210
+        0xA2, 0x8A,     // 224: draw_all: I = ball
+        0xDB, 0xC1,     // 226: draw ball at VB, VC
+        0x63, 0x1C,     // 228: V3 = 28
+        0xA2, 0x8B,     // 22A: I = paddle
+        0xD8, 0x31,     // 22C: draw paddle at V8, V3
+        0xA2, 0x8C,     // 22E: I = score digits
+        0xFA, 0x33,     // 230: BCD of VA at I
+        0xF2, 0x65,     // 232: load V0..V2 from I
+        0xF2, 0x29,     // 234: I = font for V2
+        0x64, 0x00,     // 236: V4 = 0
+        0xD4, 0x45,     // 238: draw score at V4, V4
+        0x00, 0xEE,     // 23A: return
+        0x80, 0xB0,     // 23C: move_paddle: V0 = VB
+        0x80, 0x85,     // 23E: V0 -= V8
+        0x3F, 0x00,     // 240: skip if VF == 0
+        0x12, 0x48,     // 242: jump 248
+        0x78, 0xFF,     // 244: V8 -= 1
+        0x12, 0x4A,     // 246: jump 24A
+        0x78, 0x01,     // 248: V8 += 1
+        0x60, 0x04,     // 24A: V0 = 4
+        0xE0, 0x9E,     // 24C: skip if key V0 is down
+        0x12, 0x52,     // 24E: jump 252
+        0x78, 0xFE,     // 250: V8 -= 2
+        0x60, 0x3F,     // 252: V0 = 63
+        0x88, 0x02,     // 254: V8 &= V0
+        0x00, 0xEE,     // 256: return
+        0x8B, 0xD4,     // 258: move_ball: VB += VD
+        0x8C, 0xE4,     // 25A: VC += VE
+        0x60, 0x3F,     // 25C: V0 = 63
+        0x8B, 0x02,     // 25E: VB &= V0
+        0x60, 0x1F,     // 260: V0 = 31
+        0x8C, 0x02,     // 262: VC &= V0
+        0x4B, 0x00,     // 264: skip if VB != 0
+        0x22, 0x78,     // 266: call bounce_x
+        0x4B, 0x3F,     // 268: skip if VB != 63
+        0x22, 0x78,     // 26A: call bounce_x
+        0x4C, 0x00,     // 26C: skip if VC != 0
+        0x22, 0x80,     // 26E: call bounce_y
+        0x4C, 0x1B,     // 270: skip if VC != 27, the row above the paddle
+        0x22, 0x80,     // 272: call bounce_y
+        0xC0, 0x07,     // 274: V0 = random & 7
+        0x00, 0xEE,     // 276: return
+        0x60, 0x00,     // 278: bounce_x: V0 = 0
+        0x80, 0xD5,     // 27A: V0 -= VD
+        0x8D, 0x00,     // 27C: VD = V0
+        0x00, 0xEE,     // 27E: return
+        0x60, 0x00,     // 280: bounce_y: V0 = 0
+        0x80, 0xE5,     // 282: V0 -= VE
+        0x8E, 0x00,     // 284: VE = V0
+        0x7A, 0x01,     // 286: VA += 1
+        0x00, 0xEE,     // 288: return
+        0x80,           // 28A: ball
+        0xFF,           // 28B: paddle
+        0x00, 0x00, 0x00,   // 28C: score digits
+    };
+}
+
+const std::vector<uint8>& workload_rom()
+{
+    return s_workload_rom;
+}
+
+const std::vector<uint8>& game_rom()
+{
+    return s_game_rom;
+}
@@ -0,0 +1,30 @@
+#include "benchmark.h"
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    bool write_rom(const char* path, const std::vector<uint8>& rom)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(rom.data()), static_cast<std::streamsize>(rom.size()));
+        if (!file)
+        {
+            std::cerr << "Could not write " << path << '\n';
+            return false;
+        }
+        return true;
+    }
+}
+
+// Writes the workload and game ROMs at build time so JChip8Recomp can translate them for the recompiled benchmarks
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: JChip8BenchWorkload <workload.ch8> <game.ch8>\n";
+        return 1;
+    }
+
+    return write_rom(argv[1], workload_rom()) && write_rom(argv[2], game_rom()) ? 0 : 1;
+}
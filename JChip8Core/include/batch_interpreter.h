@@ -0,0 +1,109 @@
+#ifndef JUMI_CHIP8_BATCH_INTERPRETER_H
+#define JUMI_CHIP8_BATCH_INTERPRETER_H
+#include "chip8_quirks.h"
+#include "jchip8.h"
+#include "typedefs.h"
+#include <cstddef>
+#include <vector>
+
+// How well a batch kept its machines together
+struct batch_stats
+{
+    uint64 issues = 0;              // instructions issued to a group of machines sharing a PC
+    uint64 divergent_issues = 0;    // issues that left other runnable machines waiting at a different PC
+    uint64 machine_cycles = 0;      // instructions executed, summed over every machine
+    uint64 scalar_cycles = 0;       // of those, the ones run one machine at a time rather than by a lane kernel
+
+    [[nodiscard]] double occupancy() const noexcept { return issues ? static_cast<double>(machine_cycles) / static_cast<double>(issues) : 0.0; }
+};
+
+// Many machines running the same ROM in lockstep, for searches that try one game under thousands of input
+// sequences.  State is stored structure-of-arrays: row r of each table holds that value for every machine,
+// so one opcode applied to a group of machines is a straight pass over contiguous bytes, done 32 machines per
+// AVX2 instruction when built with them and the CPU has it, and by plain lane loops otherwise.
+//
+// Each issue picks the lowest PC among machines that still have cycles left and executes it for every machine
+// sitting there.  Machines that branch differently split into separate groups at different PCs, and since the
+// lowest one always runs next, the stragglers catch up and merge back at the next PC they share, like a join
+// point after an if.  Opcodes that index per machine state (the stack, keypad, BCD, sprites at differing
+// coordinates) run one machine at a time within the group.
+//
+// Each machine executes exactly what JChip8 would: run() follows JChip8::run, ending a machine's batch early
+// on a draw, and capture_state() produces the same machine_state.  Keys are set per machine between batches,
+// there is no cycle-stamped input queue, and the timers only move on tick_timers(), as JChip8's do on the
+// host timer clock.  tick_timers() is the vblank too, releasing machines the display wait quirk is holding.
+class batch_interpreter
+{
+public:
+    static constexpr uint32 LANE_BLOCK = 32;    // machines per AVX2 register of byte state
+
+    explicit batch_interpreter(uint32 machines);
+
+    void load_ROM(const uint8* data, size_t size, const chip8_quirks& quirks = chip8_quirks{});
+    uint64 run(uint16 max_cycles);
+    void tick_timers() noexcept;
+
+    void set_keys(uint32 machine, uint16 keys) noexcept;
+    void seed_rng(uint32 machine, uint32 seed) noexcept;
+    void capture_state(uint32 machine, machine_state& out) const noexcept;
+    void restore_state(uint32 machine, const machine_state& in) noexcept;
+
+    [[nodiscard]] uint32 machines() const noexcept;
+    [[nodiscard]] uint64 cycles(uint32 machine) const noexcept;
+    [[nodiscard]] bool draw_flag(uint32 machine) const noexcept;
+    [[nodiscard]] const batch_stats& stats() const noexcept;
+    void reset_stats() noexcept;
+
+private:
+    uint32 _machines;
+    uint32 _stride;                 // machines rounded up to LANE_BLOCK, the length of every row
+    chip8_quirks _quirks;
+
+    std::vector<uint8> _memory;     // MEMORY_SIZE rows
+    std::vector<uint8> _graphics;   // GRAPHICS_WIDTH * GRAPHICS_HEIGHT rows of 0 or 1
+    std::vector<uint8> _V;          // 16 rows
+    std::vector<uint16> _stack;     // 16 rows
+    std::vector<uint16> _pc;
+    std::vector<uint16> _sp;
+    std::vector<uint16> _I;
+    std::vector<uint8> _delay_timer;
+    std::vector<uint8> _sound_timer;
+    std::vector<uint16> _keys;      // bit k set while key k is held
+    std::vector<uint8> _key_wait_pressed;
+    std::vector<uint8> _key_wait_key;
+    std::vector<uint8> _audio_pattern;  // 16 rows
+    std::vector<uint8> _audio_pitch;
+    std::vector<uint8> _audio_pattern_loaded;
+    std::vector<uint8> _draw_flag;
+    std::vector<uint8> _vblank_wait;
+    std::vector<uint8> _sound_playing;
+    std::vector<chip8_rng> _rng;
+    std::vector<uint64> _cycles;
+
+    // Addresses a write may have left different between machines.  Everywhere else one machine's byte
+    // stands for all of them, which is what lets a group share one fetched opcode.
+    std::vector<uint8> _divergent_memory;
+
+    // Per batch scratch: 0xFF marks a machine that is still running, or that takes part in the current issue
+    std::vector<uint8> _running;
+    std::vector<uint8> _group;
+    std::vector<uint16> _executed;
+    std::vector<uint8> _immediate;  // an instruction's NN repeated across a row, so immediates use the lane kernels
+    batch_stats _stats;
+
+    uint16 lowest_pc() const noexcept;
+    uint32 gather_group(uint16 pc, uint32& leader) noexcept;
+    uint32 narrow_group(uint16 pc, uint16 opcode) noexcept;
+    uint32 retire(uint16 max_cycles, bool drew) noexcept;
+    void execute(uint16 opcode, uint32 group_size, uint32 leader);
+    void execute_machine(uint32 machine, uint16 opcode);
+    void execute_each(uint16 opcode, uint32 group_size, uint32 leader);
+    void draw_uniform(uint16 I, uint8 start_x, uint8 start_y, uint8 height);
+    void write_state(uint32 machine, const machine_state& in) noexcept;
+    [[nodiscard]] bool uniform(const uint8* row, uint8& value) const noexcept;
+    [[nodiscard]] bool uniform(const uint16* row, uint16& value) const noexcept;
+    [[nodiscard]] uint8* row(std::vector<uint8>& table, uint32 index) noexcept;
+    [[nodiscard]] uint8& memory_at(uint16 address, uint32 machine) noexcept;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef JUMI_CHIP8_HOOKS_H
+#define JUMI_CHIP8_HOOKS_H
+#include "typedefs.h"
+#include <cstddef>
+#include <functional>
+
+class JChip8;
+struct instruction;
+
+// Callbacks for scoring, achievement detection and telemetry, so games can be watched without patching the
+// interpreter.  Leave any of them empty.  The instruction and memory write hooks are compiled into an engine
+// variant of their own, which attaching hooks that set either switches to; the frame, sound and ROM hooks
+// fire at most once a frame and leave the plain engine, or a recompiled ROM, running.
+//
+// Hooks see each frame once, as it is first played.  run_ahead detaches them while it runs its speculative frames,
+// and a netplay rollback while it replays frames with corrected input, so counts aren't inflated by either.  Code
+// of your own that runs frames it will undo, such as a search over clones or a fuzz replay, should detach them too.
+struct chip8_hooks
+{
+    // After each instruction, with the address it was fetched from.  cycles() only catches up when the batch ends.
+    std::function<void(JChip8&, uint16 address, const instruction&)> on_instruction;
+    // After each byte a ROM stores through I, which FX33 and FX55 do one byte at a time
+    std::function<void(JChip8&, uint16 address, uint8 value)> on_memory_write;
+    // At every vblank, once the timers have ticked
+    std::function<void(JChip8&)> on_frame;
+    // At the vblank the beeper starts
+    std::function<void(JChip8&)> on_sound_start;
+    // Once the ROM is in memory and the machine is ready to run it
+    std::function<void(JChip8&, const uint8* rom, size_t size)> on_rom_loaded;
+
+    [[nodiscard]] bool per_instruction() const noexcept { return on_instruction || on_memory_write; }
+};
+
+#endif
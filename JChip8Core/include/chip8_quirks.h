@@ -0,0 +1,44 @@
+#ifndef JUMI_CHIP8_QUIRKS_H
+#define JUMI_CHIP8_QUIRKS_H
+#include "typedefs.h"
+
+// Behaviour that differs between CHIP-8 interpreters.  The defaults are what JChip8 has always
+// done, so ROMs that ran before keep running the same way unless a config file says otherwise.
+struct chip8_quirks
+{
+    bool shift_uses_vy = true;              // 8XY6/8XYE shift VY into VX, rather than shifting VX in place
+    bool load_store_increments_i = true;    // FX55/FX65 leave I pointing one past the last register
+    bool logic_resets_vf = true;            // 8XY1/8XY2/8XY3 reset VF to 0
+    bool clip_sprites = true;               // DXYN clips sprites that start onscreen, rather than wrapping every pixel
+    bool display_wait = false;              // DXYN waits for the next vblank before the machine carries on, as on the VIP
+};
+
+static constexpr uint8 QUIRK_SHIFT_USES_VY           = 1 << 0;
+static constexpr uint8 QUIRK_LOAD_STORE_INCREMENTS_I = 1 << 1;
+static constexpr uint8 QUIRK_LOGIC_RESETS_VF         = 1 << 2;
+static constexpr uint8 QUIRK_CLIP_SPRITES            = 1 << 3;
+static constexpr uint8 QUIRK_DISPLAY_WAIT            = 1 << 4;
+static constexpr uint8 QUIRK_COMBINATIONS            = 1 << 5;
+
+[[nodiscard]] constexpr uint8 quirk_mask(const chip8_quirks& quirks) noexcept
+{
+    return static_cast<uint8>((quirks.shift_uses_vy ? QUIRK_SHIFT_USES_VY : 0)
+        | (quirks.load_store_increments_i ? QUIRK_LOAD_STORE_INCREMENTS_I : 0)
+        | (quirks.logic_resets_vf ? QUIRK_LOGIC_RESETS_VF : 0)
+        | (quirks.clip_sprites ? QUIRK_CLIP_SPRITES : 0)
+        | (quirks.display_wait ? QUIRK_DISPLAY_WAIT : 0));
+}
+
+// Compile time view of a quirk mask.  The interpreter is instantiated once per mask, so every quirk
+// check in an opcode handler folds to a constant and the selected variant has no extra branches.
+template <uint8 Mask>
+struct quirk_policy
+{
+    static constexpr bool shift_uses_vy           = (Mask & QUIRK_SHIFT_USES_VY) != 0;
+    static constexpr bool load_store_increments_i = (Mask & QUIRK_LOAD_STORE_INCREMENTS_I) != 0;
+    static constexpr bool logic_resets_vf         = (Mask & QUIRK_LOGIC_RESETS_VF) != 0;
+    static constexpr bool clip_sprites            = (Mask & QUIRK_CLIP_SPRITES) != 0;
+    static constexpr bool display_wait            = (Mask & QUIRK_DISPLAY_WAIT) != 0;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef JUMI_CHIP8_DEBUGGER_H
+#define JUMI_CHIP8_DEBUGGER_H
+#include "typedefs.h"
+#include <array>
+#include <bitset>
+#include <string>
+#include <vector>
+
+class JChip8;
+
+static constexpr uint16 DEBUGGER_ADDRESS_SPACE = 4096;
+static constexpr uint8 WATCH_READ  = 1 << 0;
+static constexpr uint8 WATCH_WRITE = 1 << 1;
+static constexpr uint8 CONDITION_REGISTER_I = 16;
+
+struct watchpoint
+{
+    uint16 start;
+    uint16 end;         // inclusive
+    uint8 access;       // WATCH_READ and/or WATCH_WRITE
+};
+
+enum class compare_op
+{
+    equal,
+    not_equal,
+    less,
+    greater,
+};
+
+struct register_condition
+{
+    uint8 reg;          // 0x0-0xF for V0-VF, CONDITION_REGISTER_I for I
+    compare_op op;
+    uint16 value;
+};
+
+// Breakpoints, watchpoints and register conditions for one JChip8.  The machine only consults the
+// debugger while it is attached, which switches it onto the instrumented engine; detached, or
+// attached with nothing to check, the interpreter runs its normal path untouched.
+class debugger
+{
+public:
+    debugger();
+
+    [[nodiscard]] bool active() const noexcept;
+    [[nodiscard]] const std::string& break_reason() const noexcept;
+
+    void toggle_breakpoint(uint16 address);
+    [[nodiscard]] bool has_breakpoint(uint16 address) const noexcept;
+    [[nodiscard]] std::vector<uint16> breakpoints() const;
+    void add_watchpoint(const watchpoint& watch);
+    void remove_watchpoint(size_t index);
+    [[nodiscard]] const std::vector<watchpoint>& watchpoints() const noexcept;
+    void add_condition(const register_condition& condition);
+    void remove_condition(size_t index);
+    [[nodiscard]] const std::vector<register_condition>& conditions() const noexcept;
+    void clear();
+
+    // Execution control, used by the debugger panel
+    void resume(uint16 pc) noexcept;
+    void run_to(uint16 address) noexcept;
+    void run_to_return(uint16 return_address, uint16 sp) noexcept;
+
+    // Called by the instrumented engine around every instruction
+    [[nodiscard]] bool check_before(uint16 pc, uint16 sp);
+    [[nodiscard]] bool check_after(const JChip8& chip8);
+    void on_read(uint16 address) noexcept;
+    void on_write(uint16 address) noexcept;
+
+private:
+    std::bitset<DEBUGGER_ADDRESS_SPACE> _breakpoints;
+    std::array<uint8, DEBUGGER_ADDRESS_SPACE> _watch_flags;
+    std::vector<watchpoint> _watchpoints;
+    std::vector<register_condition> _conditions;
+    std::vector<uint8> _conditions_held;    // each condition's result after the last instruction, since only becoming true breaks
+    std::string _break_reason;
+
+    bool _temporary_stop;
+    uint16 _temporary_address;
+    bool _temporary_match_sp;
+    uint16 _temporary_sp;
+
+    bool _skip_once;
+    uint16 _skip_pc;
+
+    bool _watch_hit;
+    uint16 _watch_address;
+    bool _watch_write;
+
+    void rebuild_watch_flags();
+};
+
+[[nodiscard]] std::string disassemble(uint16 opcode);
+
+#endif
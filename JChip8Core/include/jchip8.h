@@ -0,0 +1,374 @@
+#ifndef JUMI_JCHIP8_EMULATOR_H
+#define JUMI_JCHIP8_EMULATOR_H
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <random>
+#include <vector>
+#include <unordered_map>
+#include "typedefs.h"
+#include "chip8_quirks.h"
+
+//0x000-0x1FF - Chip 8 interpreter (contains font set in emu)
+//0x050-0x0A0 - Used for the built in 4x5 pixel font set (0-F)
+//0x200-0xFFF - Program ROM and work RAM
+
+//Memory: CHIP-8 has direct access to up to 4 kilobytes of RAM
+//Display: 64 x 32 pixels (or 128 x 64 for SUPER-CHIP) monochrome, ie. black or white
+//A program counter, often called just PC, which points at the current instruction in memory
+//One 16-bit index register called I which is used to point at locations in memory
+//A stack for 16-bit addresses, which is used to call subroutines/functions and return from them
+//An 8-bit delay timer which is decremented at a rate of 60 Hz (60 times per second) until it reaches 0
+//An 8-bit sound timer which functions like the delay timer, but which also gives off a beeping sound as long as its not 0
+//16 8-bit (one byte) general-purpose variable registers numbered 0 through F hexadecimal, ie. 0 through 15 in decimal, called V0 through VF
+//VF is also used as a flag register; many instructions will set it to either 1 or 0 based on some rule, for example using it as a carry flag
+
+#ifndef JCHIP8_NO_DEBUG_INSTRUCTIONS
+#define DEBUG_INSTRUCTIONS
+#endif
+
+#define DRAW_INSTRUCTION 0x0D
+
+// execute is a big switch, so compilers leave it out of line, and the call per instruction then costs more than
+// most instructions do
+#ifdef _MSC_VER
+#define JCHIP8_ALWAYS_INLINE __forceinline
+#else
+#define JCHIP8_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+static constexpr uint16 MEMORY_SIZE        = 4096;
+static constexpr uint16 ROM_START_LOCATION = 0x200;
+static constexpr uint16 GRAPHICS_WIDTH     = 64;
+static constexpr uint16 GRAPHICS_HEIGHT    = 32;
+
+// ROMs are untrusted, so every address, stack slot and key index a ROM controls is masked into range.
+// Addresses wrap around the 4K address space and the 16 entry stack wraps like a ring.
+static constexpr uint16 MEMORY_MASK = MEMORY_SIZE - 1;
+static constexpr uint16 STACK_MASK  = 0xF;
+static constexpr uint8  KEY_MASK    = 0xF;
+
+class debugger;
+struct chip8_hooks;
+struct recompiled_program;
+
+// Optional instrumentation compiled into an engine variant.  The plain variant has none of it, so
+// attaching a debugger changes which variant runs rather than adding checks to every variant.
+static constexpr uint8 PROBE_DEBUGGER     = 1 << 0;
+static constexpr uint8 PROBE_HISTORY      = 1 << 1;
+static constexpr uint8 PROBE_HOOKS        = 1 << 2;
+static constexpr uint8 PROBE_COMBINATIONS = 1 << 3;
+
+template <uint8 Mask>
+struct probe_policy
+{
+    static constexpr bool debugger = (Mask & PROBE_DEBUGGER) != 0;
+    static constexpr bool history  = (Mask & PROBE_HISTORY) != 0;
+    static constexpr bool hooks    = (Mask & PROBE_HOOKS) != 0;
+};
+
+struct instruction
+{
+    uint16 opcode;
+    uint16 NNN;     // 12-bit value
+    uint8 NN;       // 8-bit constant
+    uint8 N;        // 4-bit constant
+    uint8 X;        // 4-bit register identifier
+    uint8 Y;        // 4-bit register identifier
+};
+
+enum class pixel_state
+{
+    off,
+    on,
+};
+
+enum class emulator_state : uint8
+{
+    running,
+    paused,
+    quit,
+};
+
+// What drives the 60 Hz vblank, which ticks the delay and sound timers and releases a DXYN waiting on the
+// display.  By default it comes from the cycle counter, once every ips/60 cycles with the remainder carried,
+// so timing is the same at any host speed.  The host clock leaves it to update_timers, for callers that
+// already tick once per frame of their own.
+enum class timer_clock : uint8
+{
+    cycles,
+    host,
+};
+
+class instruction_history
+{
+static constexpr uint32 MAX_INSTRUCTION_HISTORY = 1024;
+public:
+    instruction_history();
+    void add_instruction(uint16 memory_address, instruction& instr);
+    void log_last_instruction() const noexcept;
+    [[nodiscard]] const std::pair<uint16, instruction>& get_instruction(uint32 index) const;
+    [[nodiscard]] uint32 get_size() const noexcept;
+    void clear();
+
+private:
+    std::array<std::pair<uint16, instruction>, MAX_INSTRUCTION_HISTORY> _instructions;
+    uint32 _ip;
+    std::unordered_map<uint16, std::string> _instruction_descriptions;
+
+    const std::string& get_instruction_description(uint16 opcode) const noexcept;
+};
+
+// Small xorshift generator satisfying UniformRandomBitGenerator.  Its whole state is one word, so it can
+// be saved with the machine, which keeps CXNN deterministic across save states and netplay rollbacks.
+class chip8_rng
+{
+public:
+    using result_type = uint32;
+
+    explicit chip8_rng(uint32 seed_value = 0x2545F491) noexcept : _state{ 0 } { seed(seed_value); }
+
+    static constexpr result_type min() noexcept { return 1; }
+    static constexpr result_type max() noexcept { return 0xFFFFFFFF; }
+
+    void seed(uint32 seed_value) noexcept { _state = seed_value ? seed_value : 0x2545F491; }
+    [[nodiscard]] uint32 state() const noexcept { return _state; }
+
+    result_type operator()() noexcept
+    {
+        _state ^= _state << 13;
+        _state ^= _state >> 17;
+        _state ^= _state << 5;
+        return _state;
+    }
+
+private:
+    uint32 _state;
+};
+
+// A keypad change that takes effect just before the instruction at the given cycle runs
+struct input_event
+{
+    uint64 cycle;
+    uint8 key;
+    bool pressed;
+};
+
+static constexpr uint32 INPUT_QUEUE_SIZE = 64;
+
+// Everything needed to put a machine back exactly where it was, laid out without padding between the
+// large arrays so it can be copied, diffed and compressed as plain bytes.
+struct machine_state
+{
+    uint64 cycles;
+    uint32 rng_state;
+    uint8 memory[MEMORY_SIZE];
+    bool graphics[GRAPHICS_WIDTH * GRAPHICS_HEIGHT];
+    uint16 stack[16];
+    uint8 V[16];
+    uint16 pc;
+    uint16 sp;
+    uint16 I;
+    uint16 keys;                    // bit k set while key k is held
+    uint8 delay_timer;
+    uint8 sound_timer;
+    bool draw_flag;
+    bool key_wait_pressed;
+    uint8 key_wait_key;
+    uint8 audio_pattern[16];
+    uint8 audio_pitch;
+    bool audio_pattern_loaded;
+    bool vblank_wait;
+    bool sound_playing;             // the beeper's state at the last vblank, so the next one sees the right edge
+    uint8 timer_carry;
+    uint64 next_timer_cycle;        // UINT64_MAX when the timers run on the host clock
+};
+
+// Clones split memory and the framebuffer into pages shared between every clone that hasn't written them, so
+// copying one is a few hundred bytes of page references and registers.  Memory comes first, then the
+// framebuffer, four rows of one byte per pixel to a page.
+static constexpr uint16 CLONE_PAGE_SIZE         = 256;
+static constexpr uint32 CLONE_MEMORY_PAGES      = MEMORY_SIZE / CLONE_PAGE_SIZE;
+static constexpr uint32 CLONE_FRAMEBUFFER_PAGES = GRAPHICS_WIDTH * GRAPHICS_HEIGHT / CLONE_PAGE_SIZE;
+static constexpr uint32 CLONE_PAGES             = CLONE_MEMORY_PAGES + CLONE_FRAMEBUFFER_PAGES;
+static constexpr uint32 CLONE_ALL_PAGES         = (1u << CLONE_PAGES) - 1;
+static constexpr uint32 CLONE_FRAMEBUFFER_MASK  = CLONE_ALL_PAGES & ~((1u << CLONE_MEMORY_PAGES) - 1);
+
+using clone_page = std::array<uint8, CLONE_PAGE_SIZE>;
+
+// A machine state for tree search and other callers that fork many of them.  Pages are immutable once
+// captured, so clones can be copied freely, kept in any number of trees and shared between threads.
+struct machine_clone
+{
+    std::shared_ptr<const clone_page> pages[CLONE_PAGES];
+    uint64 cycles = 0;
+    uint32 rng_state = 0;
+    uint16 stack[16] = {};
+    uint8 V[16] = {};
+    uint16 pc = 0;
+    uint16 sp = 0;
+    uint16 I = 0;
+    uint16 keys = 0;    // bit k set while key k is held
+    uint8 delay_timer = 0;
+    uint8 sound_timer = 0;
+    bool draw_flag = false;
+    bool key_wait_pressed = false;
+    uint8 key_wait_key = 0xFF;
+    uint8 audio_pitch = 64;
+    bool audio_pattern_loaded = false;
+    uint8 audio_pattern[16] = {};
+    bool vblank_wait = false;
+    bool sound_playing = false;
+    uint8 timer_carry = 0;
+    uint64 next_timer_cycle = UINT64_MAX;
+
+    // Reads for evaluating a clone without restoring it, such as a score the game keeps in memory
+    [[nodiscard]] uint8 read(uint16 address) const noexcept;
+    [[nodiscard]] bool pixel(uint32 x, uint32 y) const noexcept;
+};
+
+// Laid out for running hundreds of machines at once: the registers, stack and timers every instruction
+// touches fill the object's first cache line, the scheduler and dispatch state the next, and memory, the
+// framebuffer and everything the debugger, clones and input queue use come after.
+class alignas(64) JChip8
+{
+public:
+    uint8 V[16];
+    uint16 stack[16];
+    uint16 pc;
+    uint16 I;
+    uint16 sp;
+    uint16 keypad;                  // bit k set while key k is held
+    uint8 delay_timer;
+    uint8 sound_timer;
+    emulator_state state;
+    uint16 ips;
+
+private:
+    using execute_fn = void (JChip8::*)(instruction&);
+    using run_fn = uint16 (JChip8::*)(uint16);
+    using clone_page_table = std::array<std::shared_ptr<const clone_page>, CLONE_PAGES>;
+
+    // Members are laid out in declaration order, so what the run loop reads besides the registers is
+    // declared here, ahead of memory, where it fills the object's second cache line
+    uint64 _cycles;
+    uint64 _next_event_cycle;       // the sooner of the two below, which bounds each straight run of instructions
+    uint64 _next_input_cycle;       // cycle of the oldest queued event, or UINT64_MAX when the queue is empty or held
+    uint64 _next_timer_cycle;       // cycle of the next vblank, or UINT64_MAX on the host clock
+    chip8_rng _rng;
+    uint32 _dirty_pages;            // clone pages written since this machine last matched a clone
+    bool _draw_flag;
+    bool _vblank_wait;              // a DXYN under the display wait quirk is holding the machine until the next vblank
+    bool _key_wait_pressed;
+    uint8 _key_wait_key;
+    run_fn _run;
+
+public:
+    JChip8(uint16 ips_ = 700);
+    ~JChip8();
+    // A copy would be 7 KB plus the history; capture_clone is the cheap way to fork a machine
+    JChip8(const JChip8&) = delete;
+    JChip8& operator=(const JChip8&) = delete;
+
+    [[nodiscard]] bool draw_flag() const noexcept;
+    [[nodiscard]] instruction fetch_instruction() const noexcept;
+    [[nodiscard]] bool rom_loaded() const noexcept;
+    [[nodiscard]] uint64 cycles() const noexcept;
+    [[nodiscard]] const chip8_quirks& quirks() const noexcept;
+    [[nodiscard]] const uint8* audio_pattern() const noexcept;
+    [[nodiscard]] uint8 audio_pitch() const noexcept;
+    [[nodiscard]] bool audio_pattern_loaded() const noexcept;
+    void emulate_cycle();
+    uint16 run(uint16 max_cycles);
+    uint64 run_until(uint64 cycle);
+    uint16 run_frame();
+    void idle_until(uint64 cycle);
+    void execute_instruction(instruction& instr);
+    void update_timers();
+    void tick_timers() noexcept;
+    void set_timer_clock(timer_clock clock) noexcept;
+    [[nodiscard]] timer_clock active_timer_clock() const noexcept;
+    [[nodiscard]] uint64 next_timer_cycle() const noexcept;
+    [[nodiscard]] bool waiting_for_vblank() const noexcept;
+    void unload_ROM();
+    void load_ROM(const char* rom_path, const chip8_quirks& quirks = chip8_quirks{});
+    void load_ROM(const uint8* data, size_t size, const chip8_quirks& quirks = chip8_quirks{});
+    void patch_memory(uint16 address, const uint8* data, size_t size);
+    [[nodiscard]] bool sound_active() const noexcept;
+    void attach_debugger(debugger* dbg) noexcept;
+    // load_ROM attaches a compiled-in translation of the ROM by itself.  Code changed by writing memory
+    // directly rather than through patch_memory or restore_* isn't noticed until the next of those.
+    void attach_recompiled(const recompiled_program* program) noexcept;
+    [[nodiscard]] bool recompiled_active() const noexcept;
+    [[nodiscard]] bool debugger_attached() const noexcept;
+    // The hooks are read when attached, so attach them again after setting or clearing a callback
+    void attach_hooks(const chip8_hooks* hooks) noexcept;
+    [[nodiscard]] const chip8_hooks* hooks() const noexcept;
+    [[nodiscard]] bool hooks_attached() const noexcept;
+    void reset_draw_flag();
+    void capture_state(machine_state& out) const noexcept;
+    void restore_state(const machine_state& in) noexcept;
+    void capture_clone(machine_clone& out);
+    void restore_clone(const machine_clone& in);
+    void enable_history(bool enabled);
+    [[nodiscard]] bool history_enabled() const noexcept;
+    void seed_rng(uint32 seed) noexcept;
+    void queue_input(const input_event& event) noexcept;
+    void clear_input_queue() noexcept;
+    void hold_inputs(bool held) noexcept;
+    [[nodiscard]] uint32 pending_inputs() const noexcept;
+    [[nodiscard]] instruction current_instruction() const noexcept;
+    [[nodiscard]] bool key_down(uint8 key) const noexcept;
+    void set_key(uint8 key, bool pressed) noexcept;
+
+    uint8 memory[MEMORY_SIZE];
+    bool graphics[GRAPHICS_WIDTH * GRAPHICS_HEIGHT];
+
+private:
+    execute_fn _execute;
+    run_fn _interpret;              // the interpreter for these quirks, which a recompiled program falls back to
+    debugger* _debugger;
+    const chip8_hooks* _hooks;
+    bool _instruction_hooks;        // the engine was selected with the per-instruction hooks compiled in
+    const recompiled_program* _recompiled;
+    bool _recompiled_verified;      // memory still holds the code the recompiled program was translated from
+    bool _rom_loaded;
+    bool _sound_playing;
+    uint8 _timer_carry;             // sixtieths of a cycle owed to the next tick when ips isn't a multiple of 60
+    timer_clock _timer_clock;
+    uint8 _audio_pattern[16];
+    uint8 _audio_pitch;
+    bool _audio_pattern_loaded;     // set by the first F002, until then ROMs get the classic square wave beep
+    bool _inputs_held;
+    chip8_quirks _quirks;
+    uint32 _input_head;
+    uint32 _input_count;
+    input_event _input_queue[INPUT_QUEUE_SIZE];
+    std::unique_ptr<instruction_history> _instruction_history;     // only while enabled, recording is a probe variant
+    // The clone pages this machine's memory and framebuffer last matched, allocated by the first clone
+    std::unique_ptr<clone_page_table> _clone_pages;
+
+    template <typename Quirks, typename Probes> JCHIP8_ALWAYS_INLINE void execute(instruction& instr);
+    template <typename Quirks, typename Probes> uint16 run_cycles(uint16 max_cycles);
+    uint16 run_recompiled(uint16 max_cycles);
+    template <typename Probes> uint8 read_memory(uint16 address);
+    template <typename Probes> void write_memory(uint16 address, uint8 value);
+    template <uint16... Engines> void select_engine(std::integer_sequence<uint16, Engines...>);
+
+    void init_state();
+    void load_fontset();
+    void clear_graphics_buffer();
+    uint8 generate_random_number();
+    void apply_inputs(uint64 cycle) noexcept;
+    void service_events(uint64 cycle);
+    void vblank();
+    [[nodiscard]] bool wait_for_vblank(uint64 limit);
+    void schedule_timer() noexcept;
+    void resume_timer(uint64 next_cycle, uint8 carry) noexcept;
+    void rebase_inputs(uint64 cycles) noexcept;
+    [[nodiscard]] uint8* clone_source(uint32 page) noexcept;
+ };
+
+#endif
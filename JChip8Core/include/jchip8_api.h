@@ -0,0 +1,75 @@
+#ifndef JUMI_CHIP8_API_H
+#define JUMI_CHIP8_API_H
+#include <stddef.h>
+#include <stdint.h>
+
+// Plain C interface to the interpreter, for frontends, test harnesses and language bindings that
+// shouldn't depend on the C++ classes.  Nothing here throws; failures come back as a negative
+// jchip8_result, and every pointer argument is checked.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct jchip8_core jchip8_core;
+
+typedef enum jchip8_result
+{
+    JCHIP8_OK               =  0,
+    JCHIP8_ERROR_ARGUMENT   = -1,
+    JCHIP8_ERROR_ROM_SIZE   = -2,
+    JCHIP8_ERROR_STATE      = -3,
+    JCHIP8_ERROR_INTERNAL   = -4,
+} jchip8_result;
+
+// Bits for jchip8_load_rom's quirks argument, matching chip8_quirks
+#define JCHIP8_QUIRK_SHIFT_USES_VY           0x1u
+#define JCHIP8_QUIRK_LOAD_STORE_INCREMENTS_I 0x2u
+#define JCHIP8_QUIRK_LOGIC_RESETS_VF         0x4u
+#define JCHIP8_QUIRK_CLIP_SPRITES            0x8u
+#define JCHIP8_QUIRK_DISPLAY_WAIT            0x10u
+#define JCHIP8_QUIRKS_DEFAULT                0xFu
+
+#define JCHIP8_SCREEN_WIDTH  64u
+#define JCHIP8_SCREEN_HEIGHT 32u
+
+jchip8_core* jchip8_create(uint16_t instructions_per_second);
+void jchip8_destroy(jchip8_core* core);
+
+jchip8_result jchip8_load_rom(jchip8_core* core, const uint8_t* data, size_t size, uint32_t quirks);
+// Writes bytes into a running machine without resetting it, for hot reloading code as it is edited
+jchip8_result jchip8_patch_memory(jchip8_core* core, uint16_t address, const uint8_t* data, size_t size);
+jchip8_result jchip8_seed(jchip8_core* core, uint32_t seed);
+
+// Runs exactly `cycles` instructions, unless a ROM isn't loaded; returns how many ran
+uint32_t jchip8_run(jchip8_core* core, uint32_t cycles);
+// Runs, and idles where the display wait quirk says to, until the cycle counter reaches `cycle`; returns how
+// many instructions ran
+uint64_t jchip8_run_until(jchip8_core* core, uint64_t cycle);
+// Runs one 60 Hz frame: up to the next timer tick, or until a draw after which the rest of the frame idles.
+// Returns how many instructions ran.
+uint32_t jchip8_run_frame(jchip8_core* core);
+// The timers count down from the cycle counter as instructions run; this only samples whether the beeper
+// should be on for jchip8_sound_active
+jchip8_result jchip8_update_timers(jchip8_core* core);
+int jchip8_sound_active(const jchip8_core* core);
+uint64_t jchip8_cycles(const jchip8_core* core);
+
+jchip8_result jchip8_set_key(jchip8_core* core, uint8_t key, int pressed);
+// Bit n of keys is CHIP-8 key n
+jchip8_result jchip8_set_keys(jchip8_core* core, uint16_t keys);
+
+// JCHIP8_SCREEN_WIDTH * JCHIP8_SCREEN_HEIGHT bytes, row major, 1 for a lit pixel.  Valid until the core is destroyed.
+const uint8_t* jchip8_framebuffer(const jchip8_core* core);
+
+// Save states are opaque blobs of jchip8_state_size() bytes, only loadable by the same build of the core.
+// Loading returns JCHIP8_ERROR_STATE for a blob from another build or one whose timer state is inconsistent.
+size_t jchip8_state_size(void);
+jchip8_result jchip8_save_state(const jchip8_core* core, void* buffer, size_t size);
+jchip8_result jchip8_load_state(jchip8_core* core, const void* buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef JUMI_CHIP8_RECOMPILED_H
+#define JUMI_CHIP8_RECOMPILED_H
+#include "typedefs.h"
+#include <cstddef>
+
+class JChip8;
+
+// Why a recompiled program handed control back to the machine
+enum class recompiled_exit : uint8
+{
+    budget,         // ran the instructions it was allowed
+    drew,           // a DXYN ended the batch, as it does in the interpreter
+    unknown_pc,     // pc isn't an address the recompiler found code at, so the interpreter takes the next instruction
+    code_written,   // a store landed on translated code, which no longer matches memory
+};
+
+// Runs from machine.pc for at most budget instructions and returns how many ran, leaving pc where it stopped
+using recompiled_fn = uint16 (*)(JChip8& machine, uint16 budget, recompiled_exit& exit);
+
+struct recompiled_range
+{
+    uint16 start;
+    uint16 end;         // exclusive
+};
+
+// A ROM translated to C++ by JChip8Recomp and compiled in.  The translation only stands for the bytes it was
+// made from, so a machine uses it while its quirks match and the code ranges in memory still match the ROM.
+struct recompiled_program
+{
+    const char* name;
+    uint8 quirks;                   // the quirk mask the translation was generated for
+    const uint8* rom;
+    uint16 rom_size;
+    const recompiled_range* code;   // the instruction bytes the translation relies on
+    uint32 code_ranges;
+    recompiled_fn run;
+
+    [[nodiscard]] bool matches(const uint8* memory) const noexcept;
+};
+
+// Generated translation units register their program at startup, and load_ROM picks one up by its bytes
+void register_recompiled(const recompiled_program& program);
+[[nodiscard]] const recompiled_program* find_recompiled(const uint8* rom, size_t size) noexcept;
+
+struct recompiled_registration
+{
+    explicit recompiled_registration(const recompiled_program& program) { register_recompiled(program); }
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef JUMI_CHIP8_REWIND_BUFFER_H
+#define JUMI_CHIP8_REWIND_BUFFER_H
+#include "jchip8.h"
+#include "typedefs.h"
+#include <deque>
+#include <memory>
+#include <vector>
+
+struct rewind_stats
+{
+    uint32 frames;
+    uint64 bytes;
+    double last_capture_us;
+    double avg_capture_us;
+    double avg_bytes_per_frame;
+};
+
+// Frame by frame history of machine states for rewinding.  Every KEYFRAME_INTERVAL frames a full state
+// is stored; the frames in between hold the XOR of their state against that keyframe, which is almost
+// all zeroes and compresses to a few dozen bytes with a zero-run encoding.  The oldest keyframe group
+// is dropped whenever the frame or byte limit would be exceeded, so memory use stays bounded.
+class rewind_buffer
+{
+public:
+    static constexpr uint32 KEYFRAME_INTERVAL = 60;
+
+    rewind_buffer(uint32 max_frames, uint64 max_bytes);
+
+    void capture(const JChip8& chip8);
+    [[nodiscard]] bool step_back(JChip8& chip8);
+    [[nodiscard]] bool empty() const noexcept;
+    [[nodiscard]] rewind_stats stats() const noexcept;
+    void clear();
+
+private:
+    struct frame
+    {
+        std::vector<uint8> data;
+        bool keyframe;
+    };
+
+    std::deque<frame> _frames;
+    std::vector<std::vector<uint8>> _spare_buffers;
+    std::unique_ptr<machine_state> _current;
+    std::unique_ptr<machine_state> _keyframe;
+    uint32 _max_frames;
+    uint64 _max_bytes;
+    uint64 _bytes;
+    uint32 _since_keyframe;
+    uint64 _captures;
+    double _total_capture_us;
+    double _last_capture_us;
+    uint64 _total_captured_bytes;
+
+    void evict_oldest_group();
+    std::vector<uint8> take_buffer();
+    void decode_keyframe_for_newest();
+};
+
+// Zero-run encoding shared by keyframes and deltas.  The stream is a sequence of
+// [zero run][literal count][literals], with both counts as LEB128 varints.
+void encode_xor(const uint8* data, const uint8* reference, size_t size, std::vector<uint8>& out);
+void decode_xor(const std::vector<uint8>& encoded, const uint8* reference, uint8* out, size_t size);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef JUMI_CHIP8_RUN_AHEAD_H
+#define JUMI_CHIP8_RUN_AHEAD_H
+#include "jchip8.h"
+#include "typedefs.h"
+#include <memory>
+
+struct run_ahead_stats
+{
+    uint32 frames;
+    double last_us;
+    double avg_us;
+};
+
+// Hides the frames of lag a ROM builds in between reading the keypad and drawing the result.  After the
+// real frame has run, the machine is saved, run on for a few more frames with the keys held right now,
+// and the screen from that future is what gets presented; the machine is then put back so the real
+// timeline never sees the extra frames.  Queued input is held meanwhile so it still lands on the real
+// frames at the cycle it was stamped with.
+class run_ahead
+{
+public:
+    static constexpr uint32 MAX_FRAMES = 8;
+
+    run_ahead();
+
+    void advance(JChip8& chip8, uint32 frames);
+    void restore(JChip8& chip8);
+    [[nodiscard]] bool active() const noexcept;
+    [[nodiscard]] run_ahead_stats stats() const noexcept;
+
+private:
+    std::unique_ptr<machine_state> _saved;
+    bool _active;
+    uint32 _frames;
+    double _elapsed_us;
+    uint64 _runs;
+    double _total_us;
+    double _last_us;
+};
+
+#endif
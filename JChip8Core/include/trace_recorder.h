@@ -0,0 +1,42 @@
+#ifndef JUMI_CHIP8_TRACE_RECORDER_H
+#define JUMI_CHIP8_TRACE_RECORDER_H
+#include "typedefs.h"
+#include <string>
+
+// Timeline recording in Chrome's trace event format, which Perfetto and chrome://tracing open directly.
+// Events go into a ring buffer allocated by start(), so recording never allocates and a long session
+// keeps the most recent events.  Everything is recorded from the main thread.
+namespace trace
+{
+    static constexpr uint32 DEFAULT_CAPACITY = 1 << 20;
+
+    extern bool s_enabled;
+
+    void start(uint32 capacity = DEFAULT_CAPACITY);
+    void stop();
+    [[nodiscard]] uint64 now_ns() noexcept;
+    void complete(const char* name, const char* category, uint64 start_ns, uint64 end_ns) noexcept;
+    void instant(const char* name, const char* category) noexcept;
+    void write_json(const std::string& filepath);
+
+    class scope
+    {
+    public:
+        scope(const char* name, const char* category) noexcept;
+        ~scope();
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+    private:
+        const char* _name;
+        const char* _category;
+        uint64 _start_ns;
+    };
+}
+
+#define JCHIP8_TRACE_CONCAT_IMPL(a, b) a##b
+#define JCHIP8_TRACE_CONCAT(a, b) JCHIP8_TRACE_CONCAT_IMPL(a, b)
+#define JCHIP8_TRACE_SCOPE(name, category) trace::scope JCHIP8_TRACE_CONCAT(trace_scope_, __LINE__)(name, category)
+#define JCHIP8_TRACE_INSTANT(name, category) do { if (trace::s_enabled) trace::instant(name, category); } while (0)
+
+#endif
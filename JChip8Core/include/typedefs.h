@@ -1,5 +1,6 @@
 #ifndef JUMI_CHIP8_TYPEDEFS_H
 #define JUMI_CHIP8_TYPEDEFS_H
+#include <cstdint>
 #include <vector>
 #include <utility>
 
@@ -0,0 +1,1320 @@
+#include "batch_interpreter.h"
+#include "chip8_quirks.h"
+#include "jchip8.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+// With JCHIP8_BATCH_AVX2 defined (or the whole build targeting AVX2) the lane kernels gain intrinsic forms.
+// Only those functions are compiled for AVX2 and they are picked at run time, so the binary still runs on
+// older CPUs and no AVX2 code ends up in inline functions shared with the rest of the program.  Otherwise the
+// kernels run as plain loops over the lanes, which compilers vectorize for whatever the target has.
+#if defined(__AVX2__) && !defined(JCHIP8_BATCH_AVX2)
+#define JCHIP8_BATCH_AVX2
+#endif
+
+#ifdef JCHIP8_BATCH_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define JCHIP8_AVX2
+#else
+#define JCHIP8_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    // A kernel costs a pass over every lane whatever the group size, so groups this much smaller than the
+    // batch run one machine at a time instead
+    constexpr uint32 SCALAR_GROUP_RATIO = 64;
+
+    // 0xFF lane masks widened to 0xFFFF, so the fallback loops blend 16 bit rows without branching
+    uint16 widen(uint8 mask) noexcept
+    {
+        return static_cast<uint16>(static_cast<int16>(static_cast<int8>(mask)));
+    }
+
+#ifdef JCHIP8_BATCH_AVX2
+    bool cpu_supports_avx2() noexcept
+    {
+#if defined(__AVX2__)
+        return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+        // AVX2 itself, plus an OS that saves the YMM registers
+        int info[4];
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    const bool AVX2_SUPPORTED = cpu_supports_avx2();
+
+    JCHIP8_AVX2 __m256i load(const void* p) noexcept { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+    JCHIP8_AVX2 void store(void* p, __m256i v) noexcept { _mm256_storeu_si256(static_cast<__m256i*>(p), v); }
+
+    // Byte lane masks widened to 16 bit lanes, for the PC, I and cycle rows
+    JCHIP8_AVX2 __m256i widen_mask(const uint8* mask) noexcept
+    {
+        return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask)));
+    }
+#endif
+
+    // Each byte op has a scalar form and, with AVX2, a 32 lane form.  Ops with a flag produce VF as 0 or 1.
+    struct op_copy
+    {
+        static constexpr bool sets_flag = false;
+        static uint8 apply(uint8, uint8 b, uint8&) noexcept { return b; }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i, __m256i b, __m256i&, __m256i) noexcept { return b; }
+#endif
+    };
+
+    struct op_add_no_carry
+    {
+        static constexpr bool sets_flag = false;
+        static uint8 apply(uint8 a, uint8 b, uint8&) noexcept { return static_cast<uint8>(a + b); }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i a, __m256i b, __m256i&, __m256i) noexcept { return _mm256_add_epi8(a, b); }
+#endif
+    };
+
+    template <bool ResetsVf>
+    struct op_or
+    {
+        static constexpr bool sets_flag = ResetsVf;
+        static uint8 apply(uint8 a, uint8 b, uint8& flag) noexcept { flag = 0; return a | b; }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i a, __m256i b, __m256i& flag, __m256i) noexcept
+        {
+            flag = _mm256_setzero_si256();
+            return _mm256_or_si256(a, b);
+        }
+#endif
+    };
+
+    template <bool ResetsVf>
+    struct op_and
+    {
+        static constexpr bool sets_flag = ResetsVf;
+        static uint8 apply(uint8 a, uint8 b, uint8& flag) noexcept { flag = 0; return a & b; }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i a, __m256i b, __m256i& flag, __m256i) noexcept
+        {
+            flag = _mm256_setzero_si256();
+            return _mm256_and_si256(a, b);
+        }
+#endif
+    };
+
+    template <bool ResetsVf>
+    struct op_xor
+    {
+        static constexpr bool sets_flag = ResetsVf;
+        static uint8 apply(uint8 a, uint8 b, uint8& flag) noexcept { flag = 0; return a ^ b; }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i a, __m256i b, __m256i& flag, __m256i) noexcept
+        {
+            flag = _mm256_setzero_si256();
+            return _mm256_xor_si256(a, b);
+        }
+#endif
+    };
+
+    struct op_add
+    {
+        static constexpr bool sets_flag = true;
+        static uint8 apply(uint8 a, uint8 b, uint8& flag) noexcept
+        {
+            flag = static_cast<uint16>(a + b) > 255;
+            return static_cast<uint8>(a + b);
+        }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i a, __m256i b, __m256i& flag, __m256i one) noexcept
+        {
+            // The sum wrapped exactly when it came out below a
+            __m256i sum = _mm256_add_epi8(a, b);
+            flag = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(sum, a), sum), one);
+            return sum;
+        }
+#endif
+    };
+
+    struct op_sub
+    {
+        static constexpr bool sets_flag = true;
+        static uint8 apply(uint8 a, uint8 b, uint8& flag) noexcept
+        {
+            flag = b <= a;
+            return static_cast<uint8>(a - b);
+        }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i a, __m256i b, __m256i& flag, __m256i one) noexcept
+        {
+            flag = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a), one);
+            return _mm256_sub_epi8(a, b);
+        }
+#endif
+    };
+
+    struct op_sub_reverse
+    {
+        static constexpr bool sets_flag = true;
+        static uint8 apply(uint8 a, uint8 b, uint8& flag) noexcept
+        {
+            flag = a <= b;
+            return static_cast<uint8>(b - a);
+        }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i a, __m256i b, __m256i& flag, __m256i one) noexcept
+        {
+            flag = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), b), one);
+            return _mm256_sub_epi8(b, a);
+        }
+#endif
+    };
+
+    // The shifts take their source as b, which is VY or VX depending on the shift quirk
+    struct op_shift_right
+    {
+        static constexpr bool sets_flag = true;
+        static uint8 apply(uint8, uint8 b, uint8& flag) noexcept
+        {
+            flag = b & 0x1;
+            return static_cast<uint8>(b >> 1);
+        }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i, __m256i b, __m256i& flag, __m256i one) noexcept
+        {
+            flag = _mm256_and_si256(b, one);
+            return _mm256_and_si256(_mm256_srli_epi16(b, 1), _mm256_set1_epi8(0x7F));
+        }
+#endif
+    };
+
+    struct op_shift_left
+    {
+        static constexpr bool sets_flag = true;
+        static uint8 apply(uint8, uint8 b, uint8& flag) noexcept
+        {
+            flag = (b & 0x80) >> 7;
+            return static_cast<uint8>(b << 1);
+        }
+#ifdef JCHIP8_BATCH_AVX2
+        JCHIP8_AVX2 static __m256i apply(__m256i, __m256i b, __m256i& flag, __m256i one) noexcept
+        {
+            flag = _mm256_and_si256(_mm256_srli_epi16(b, 7), one);
+            return _mm256_add_epi8(b, b);
+        }
+#endif
+    };
+
+#ifdef JCHIP8_BATCH_AVX2
+    // The AVX2 forms of the kernels below cover every lane, since the stride is a whole number of 32 lane blocks
+    template <typename Op>
+    JCHIP8_AVX2 void byte_op_avx2(uint8* dst, const uint8* a, const uint8* b, uint8* flag, const uint8* group, uint32 stride) noexcept
+    {
+        const __m256i one = _mm256_set1_epi8(1);
+        for (uint32 m = 0; m < stride; m += 32)
+        {
+            __m256i g = load(group + m);
+            if (_mm256_testz_si256(g, g))
+                continue;
+
+            __m256i f = _mm256_setzero_si256();
+            __m256i r = Op::apply(load(a + m), load(b + m), f, one);
+            store(dst + m, _mm256_blendv_epi8(load(dst + m), r, g));
+            if constexpr (Op::sets_flag)
+                store(flag + m, _mm256_blendv_epi8(load(flag + m), f, g));
+        }
+    }
+
+    template <bool Equal>
+    JCHIP8_AVX2 void skip_op_avx2(uint16* pc, const uint8* a, const uint8* b, const uint8* group, uint32 stride) noexcept
+    {
+        const __m256i two = _mm256_set1_epi16(2);
+        for (uint32 m = 0; m < stride; m += 32)
+        {
+            __m256i g = load(group + m);
+            if (_mm256_testz_si256(g, g))
+                continue;
+
+            __m256i equal = _mm256_cmpeq_epi8(load(a + m), load(b + m));
+            __m256i taken = Equal ? _mm256_and_si256(equal, g) : _mm256_andnot_si256(equal, g);
+            __m256i low = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(taken));
+            __m256i high = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(taken, 1));
+            store(pc + m, _mm256_add_epi16(load(pc + m), _mm256_and_si256(low, two)));
+            store(pc + m + 16, _mm256_add_epi16(load(pc + m + 16), _mm256_and_si256(high, two)));
+        }
+    }
+
+    JCHIP8_AVX2 void set_words_avx2(uint16* dst, uint16 value, const uint8* group, uint32 stride) noexcept
+    {
+        const __m256i v = _mm256_set1_epi16(static_cast<int16>(value));
+        for (uint32 m = 0; m < stride; m += 16)
+            store(dst + m, _mm256_blendv_epi8(load(dst + m), v, widen_mask(group + m)));
+    }
+
+    JCHIP8_AVX2 void add_words_avx2(uint16* dst, uint16 value, const uint8* group, uint32 stride) noexcept
+    {
+        const __m256i v = _mm256_set1_epi16(static_cast<int16>(value));
+        for (uint32 m = 0; m < stride; m += 16)
+            store(dst + m, _mm256_add_epi16(load(dst + m), _mm256_and_si256(widen_mask(group + m), v)));
+    }
+
+    JCHIP8_AVX2 void add_bytes_to_words_avx2(uint16* dst, const uint8* src, const uint8* group, uint32 stride) noexcept
+    {
+        for (uint32 m = 0; m < stride; m += 16)
+        {
+            __m256i add = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + m)));
+            store(dst + m, _mm256_add_epi16(load(dst + m), _mm256_and_si256(widen_mask(group + m), add)));
+        }
+    }
+
+    JCHIP8_AVX2 uint16 lowest_pc_avx2(const uint16* pc, const uint8* running, uint32 stride) noexcept
+    {
+        // Stopped lanes read as 0xFFFF; a running machine really at 0xFFFF still gathers correctly
+        const __m256i ones = _mm256_set1_epi16(-1);
+        __m256i acc = ones;
+        for (uint32 m = 0; m < stride; m += 16)
+            acc = _mm256_min_epu16(acc, _mm256_or_si256(load(pc + m), _mm256_xor_si256(widen_mask(running + m), ones)));
+
+        __m128i half = _mm_min_epu16(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        return static_cast<uint16>(_mm_cvtsi128_si32(_mm_minpos_epu16(half)));
+    }
+
+    JCHIP8_AVX2 uint32 gather_group_avx2(uint8* group, const uint16* pcs, const uint8* running, uint16 pc, uint32 stride,
+        uint32& leader) noexcept
+    {
+        const __m256i target = _mm256_set1_epi16(static_cast<int16>(pc));
+        uint32 count = 0;
+        for (uint32 m = 0; m < stride; m += 32)
+        {
+            __m256i low = _mm256_cmpeq_epi16(load(pcs + m), target);
+            __m256i high = _mm256_cmpeq_epi16(load(pcs + m + 16), target);
+            __m256i equal = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+            __m256i g = _mm256_and_si256(equal, load(running + m));
+            store(group + m, g);
+
+            uint32 bits = static_cast<uint32>(_mm256_movemask_epi8(g));
+            if (bits && count == 0)
+                leader = m + static_cast<uint32>(std::countr_zero(bits));
+            count += static_cast<uint32>(std::popcount(bits));
+        }
+        return count;
+    }
+
+    JCHIP8_AVX2 uint32 retire_avx2(uint16* executed, uint8* running, const uint8* group, uint16 max_cycles, bool drew,
+        uint32 stride) noexcept
+    {
+        const __m256i limit = _mm256_set1_epi16(static_cast<int16>(max_cycles));
+        uint32 retired = 0;
+        for (uint32 m = 0; m < stride; m += 16)
+        {
+            __m256i g = widen_mask(group + m);
+            __m256i count = _mm256_sub_epi16(load(executed + m), g);
+            store(executed + m, count);
+
+            __m256i done = drew ? g : _mm256_and_si256(_mm256_cmpeq_epi16(count, limit), g);
+            __m128i done_bytes = _mm_packs_epi16(_mm256_castsi256_si128(done), _mm256_extracti128_si256(done, 1));
+            __m128i still = _mm_andnot_si128(done_bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(running + m)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(running + m), still);
+            retired += static_cast<uint32>(std::popcount(static_cast<uint32>(_mm_movemask_epi8(done_bytes))));
+        }
+        return retired;
+    }
+
+    // One sprite drawn at the same place in every lane of the group; memory and graphics are the tables' first
+    // rows, and rows/cols the clipped screen coordinates
+    JCHIP8_AVX2 void draw_avx2(uint8* graphics, uint8* vf, uint8* draw_flag, const uint8* memory, const uint8* group,
+        uint16 I, const uint8* rows, uint8 row_count, const uint8* cols, uint8 col_count, uint32 stride) noexcept
+    {
+        const __m256i one = _mm256_set1_epi8(1);
+        for (uint32 m = 0; m < stride; m += 32)
+        {
+            __m256i g = load(group + m);
+            if (_mm256_testz_si256(g, g))
+                continue;
+
+            __m256i flip_lanes = _mm256_and_si256(g, one);
+            __m256i collided = _mm256_setzero_si256();
+            for (uint8 i = 0; i < row_count; ++i)
+            {
+                __m256i sprite = load(memory + static_cast<size_t>((I + i) & MEMORY_MASK) * stride + m);
+                uint8* pixels = graphics + static_cast<size_t>(rows[i]) * GRAPHICS_WIDTH * stride;
+                for (uint8 j = 0; j < col_count; ++j)
+                {
+                    __m256i bit = _mm256_set1_epi8(static_cast<char>(0x80 >> j));
+                    __m256i flip = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(sprite, bit), bit), flip_lanes);
+                    uint8* pixel = pixels + static_cast<size_t>(cols[j]) * stride + m;
+                    __m256i current = load(pixel);
+                    collided = _mm256_or_si256(collided, _mm256_and_si256(current, flip));
+                    store(pixel, _mm256_xor_si256(current, flip));
+                }
+            }
+
+            store(vf + m, _mm256_blendv_epi8(load(vf + m), collided, g));
+            if (row_count > 0)
+                store(draw_flag + m, _mm256_or_si256(load(draw_flag + m), flip_lanes));
+        }
+    }
+#endif
+
+    // dst = Op(a, b) and, for ops that set it, VF = flag, in every lane of the group.  VF is written after
+    // dst as the interpreter does, so an op whose X is F still ends with the flag.
+    template <typename Op>
+    void byte_op(uint8* dst, const uint8* a, const uint8* b, uint8* flag, const uint8* group, uint32 stride) noexcept
+    {
+#ifdef JCHIP8_BATCH_AVX2
+        if (AVX2_SUPPORTED)
+        {
+            byte_op_avx2<Op>(dst, a, b, flag, group, stride);
+            return;
+        }
+#endif
+        for (uint32 m = 0; m < stride; ++m)
+        {
+            uint8 f = 0;
+            uint8 r = Op::apply(a[m], b[m], f);
+            dst[m] = static_cast<uint8>((r & group[m]) | (dst[m] & ~group[m]));
+            if constexpr (Op::sets_flag)
+                flag[m] = static_cast<uint8>((f & group[m]) | (flag[m] & ~group[m]));
+        }
+    }
+
+    // pc += 2 in every lane of the group where a == b (or a != b)
+    template <bool Equal>
+    void skip_op(uint16* pc, const uint8* a, const uint8* b, const uint8* group, uint32 stride) noexcept
+    {
+#ifdef JCHIP8_BATCH_AVX2
+        if (AVX2_SUPPORTED)
+        {
+            skip_op_avx2<Equal>(pc, a, b, group, stride);
+            return;
+        }
+#endif
+        for (uint32 m = 0; m < stride; ++m)
+            pc[m] = static_cast<uint16>(pc[m] + ((group[m] & 2) * ((a[m] == b[m]) == Equal)));
+    }
+
+    void set_words(uint16* dst, uint16 value, const uint8* group, uint32 stride) noexcept
+    {
+#ifdef JCHIP8_BATCH_AVX2
+        if (AVX2_SUPPORTED)
+        {
+            set_words_avx2(dst, value, group, stride);
+            return;
+        }
+#endif
+        for (uint32 m = 0; m < stride; ++m)
+            dst[m] = static_cast<uint16>((value & widen(group[m])) | (dst[m] & ~widen(group[m])));
+    }
+
+    void add_words(uint16* dst, uint16 value, const uint8* group, uint32 stride) noexcept
+    {
+#ifdef JCHIP8_BATCH_AVX2
+        if (AVX2_SUPPORTED)
+        {
+            add_words_avx2(dst, value, group, stride);
+            return;
+        }
+#endif
+        for (uint32 m = 0; m < stride; ++m)
+            dst[m] = static_cast<uint16>(dst[m] + (value & widen(group[m])));
+    }
+
+    void add_bytes_to_words(uint16* dst, const uint8* src, const uint8* group, uint32 stride) noexcept
+    {
+#ifdef JCHIP8_BATCH_AVX2
+        if (AVX2_SUPPORTED)
+        {
+            add_bytes_to_words_avx2(dst, src, group, stride);
+            return;
+        }
+#endif
+        for (uint32 m = 0; m < stride; ++m)
+            dst[m] = static_cast<uint16>(dst[m] + (src[m] & widen(group[m])));
+    }
+}
+
+batch_interpreter::batch_interpreter(uint32 machines)
+    : _machines(machines)
+    , _stride((machines + LANE_BLOCK - 1) / LANE_BLOCK * LANE_BLOCK)
+    , _quirks()
+    , _memory(static_cast<size_t>(MEMORY_SIZE) * _stride)
+    , _graphics(static_cast<size_t>(GRAPHICS_WIDTH) * GRAPHICS_HEIGHT * _stride)
+    , _V(16 * _stride)
+    , _stack(16 * _stride)
+    , _pc(_stride)
+    , _sp(_stride)
+    , _I(_stride)
+    , _delay_timer(_stride)
+    , _sound_timer(_stride)
+    , _keys(_stride)
+    , _key_wait_pressed(_stride)
+    , _key_wait_key(_stride)
+    , _audio_pattern(16 * _stride)
+    , _audio_pitch(_stride)
+    , _audio_pattern_loaded(_stride)
+    , _draw_flag(_stride)
+    , _vblank_wait(_stride)
+    , _sound_playing(_stride)
+    , _rng(_stride)
+    , _cycles(_stride)
+    , _divergent_memory(MEMORY_SIZE)
+    , _running(_stride)
+    , _group(_stride)
+    , _executed(_stride)
+    , _immediate(_stride)
+    , _stats()
+{
+    // Start every machine exactly as a fresh JChip8 would, fontset and all
+    JChip8 blank;
+    machine_state state;
+    blank.capture_state(state);
+    for (uint32 m = 0; m < _machines; ++m)
+    {
+        state.rng_state = _rng[m].state();
+        write_state(m, state);
+    }
+}
+
+void batch_interpreter::load_ROM(const uint8* data, size_t size, const chip8_quirks& quirks)
+{
+    JChip8 loader;
+    loader.load_ROM(data, size, quirks);
+    machine_state state;
+    loader.capture_state(state);
+
+    // Loading leaves each machine's generator and draw flag alone, as JChip8::load_ROM does
+    for (uint32 m = 0; m < _machines; ++m)
+    {
+        state.rng_state = _rng[m].state();
+        state.draw_flag = _draw_flag[m] != 0;
+        write_state(m, state);
+    }
+
+    _quirks = quirks;
+    std::fill(_divergent_memory.begin(), _divergent_memory.end(), 0);
+}
+
+uint64 batch_interpreter::run(uint16 max_cycles)
+{
+    if (max_cycles == 0 || _machines == 0)
+        return 0;
+
+    // Machines held by the display wait quirk sit the whole batch out until tick_timers
+    uint32 runnable = 0;
+    for (uint32 m = 0; m < _machines; ++m)
+    {
+        _running[m] = _vblank_wait[m] ? 0 : 0xFF;
+        runnable += _vblank_wait[m] ? 0u : 1u;
+    }
+    std::fill(_executed.begin(), _executed.end(), 0);
+
+    uint64 executed = 0;
+    while (runnable > 0)
+    {
+        uint16 pc = lowest_pc();
+        uint32 leader = 0;
+        uint32 group_size = gather_group(pc, leader);
+
+        // Machines at the same PC share an opcode unless some write made their code differ
+        uint16 opcode = static_cast<uint16>(memory_at(pc, leader) << 8 | memory_at(static_cast<uint16>(pc + 1), leader));
+        if (_divergent_memory[pc & MEMORY_MASK] || _divergent_memory[(pc + 1) & MEMORY_MASK])
+            group_size = narrow_group(pc, opcode);
+
+        ++_stats.issues;
+        if (group_size < runnable)
+            ++_stats.divergent_issues;
+
+        execute(opcode, group_size, leader);
+
+        // A draw ends the batch early for every machine that drew, as in JChip8::run
+        bool drew = (opcode >> 12) == DRAW_INSTRUCTION;
+        if (drew && _quirks.display_wait)
+        {
+            for (uint32 m = 0; m < _machines; ++m)
+                _vblank_wait[m] = static_cast<uint8>(_vblank_wait[m] | (_group[m] & 1));
+        }
+        runnable -= retire(max_cycles, drew);
+        executed += group_size;
+    }
+
+    for (uint32 m = 0; m < _machines; ++m)
+        _cycles[m] += _executed[m];
+
+    _stats.machine_cycles += executed;
+    return executed;
+}
+
+void batch_interpreter::tick_timers() noexcept
+{
+    for (uint32 m = 0; m < _stride; ++m)
+    {
+        _delay_timer[m] = static_cast<uint8>(_delay_timer[m] - (_delay_timer[m] > 0));
+        _sound_playing[m] = _sound_timer[m] > 0;
+        _sound_timer[m] = static_cast<uint8>(_sound_timer[m] - (_sound_timer[m] > 0));
+        _vblank_wait[m] = 0;
+    }
+}
+
+void batch_interpreter::set_keys(uint32 machine, uint16 keys) noexcept
+{
+    _keys[machine] = keys;
+}
+
+void batch_interpreter::seed_rng(uint32 machine, uint32 seed) noexcept
+{
+    _rng[machine].seed(seed);
+}
+
+void batch_interpreter::capture_state(uint32 machine, machine_state& out) const noexcept
+{
+    // Zeroed first like JChip8::capture_state, so states from either compare equal byte for byte
+    std::memset(&out, 0, sizeof(out));
+    out.cycles = _cycles[machine];
+    out.rng_state = _rng[machine].state();
+    for (uint32 address = 0; address < MEMORY_SIZE; ++address)
+        out.memory[address] = _memory[address * _stride + machine];
+    for (uint32 pixel = 0; pixel < GRAPHICS_WIDTH * GRAPHICS_HEIGHT; ++pixel)
+        out.graphics[pixel] = _graphics[pixel * _stride + machine] != 0;
+    for (uint32 i = 0; i < 16; ++i)
+    {
+        out.stack[i] = _stack[i * _stride + machine];
+        out.V[i] = _V[i * _stride + machine];
+        out.audio_pattern[i] = _audio_pattern[i * _stride + machine];
+    }
+    out.pc = _pc[machine];
+    out.sp = _sp[machine];
+    out.I = _I[machine];
+    out.keys = _keys[machine];
+    out.delay_timer = _delay_timer[machine];
+    out.sound_timer = _sound_timer[machine];
+    out.draw_flag = _draw_flag[machine] != 0;
+    out.key_wait_pressed = _key_wait_pressed[machine] != 0;
+    out.key_wait_key = _key_wait_key[machine];
+    out.audio_pitch = _audio_pitch[machine];
+    out.audio_pattern_loaded = _audio_pattern_loaded[machine] != 0;
+    out.vblank_wait = _vblank_wait[machine] != 0;
+    out.sound_playing = _sound_playing[machine] != 0;
+    out.next_timer_cycle = UINT64_MAX;
+}
+
+void batch_interpreter::restore_state(uint32 machine, const machine_state& in) noexcept
+{
+    for (uint32 address = 0; address < MEMORY_SIZE; ++address)
+    {
+        if (in.memory[address] != _memory[address * _stride + machine])
+            _divergent_memory[address] = 1;
+    }
+
+    write_state(machine, in);
+    _draw_flag[machine] = 1;
+}
+
+uint32 batch_interpreter::machines() const noexcept
+{
+    return _machines;
+}
+
+uint64 batch_interpreter::cycles(uint32 machine) const noexcept
+{
+    return _cycles[machine];
+}
+
+bool batch_interpreter::draw_flag(uint32 machine) const noexcept
+{
+    return _draw_flag[machine] != 0;
+}
+
+const batch_stats& batch_interpreter::stats() const noexcept
+{
+    return _stats;
+}
+
+void batch_interpreter::reset_stats() noexcept
+{
+    _stats = batch_stats{};
+}
+
+uint16 batch_interpreter::lowest_pc() const noexcept
+{
+    const uint16* pc = _pc.data();
+    const uint8* running = _running.data();
+#ifdef JCHIP8_BATCH_AVX2
+    if (AVX2_SUPPORTED)
+        return lowest_pc_avx2(pc, running, _stride);
+#endif
+    // Stopped lanes read as 0xFFFF; a running machine really at 0xFFFF still gathers correctly
+    uint16 lowest = 0xFFFF;
+    for (uint32 m = 0; m < _stride; ++m)
+        lowest = std::min(lowest, static_cast<uint16>(pc[m] | ~widen(running[m])));
+    return lowest;
+}
+
+uint32 batch_interpreter::gather_group(uint16 pc, uint32& leader) noexcept
+{
+    const uint16* pcs = _pc.data();
+    const uint8* running = _running.data();
+    uint8* group = _group.data();
+#ifdef JCHIP8_BATCH_AVX2
+    if (AVX2_SUPPORTED)
+        return gather_group_avx2(group, pcs, running, pc, _stride, leader);
+#endif
+    uint32 count = 0;
+    for (uint32 m = 0; m < _stride; ++m)
+    {
+        group[m] = static_cast<uint8>(running[m] & -static_cast<int>(pcs[m] == pc));
+        count += group[m] & 1u;
+    }
+
+    uint32 first = 0;
+    while (count > 0 && !group[first])
+        ++first;
+    leader = first;
+    return count;
+}
+
+uint32 batch_interpreter::narrow_group(uint16 pc, uint16 opcode) noexcept
+{
+    const uint8* high = _memory.data() + (pc & MEMORY_MASK) * _stride;
+    const uint8* low = _memory.data() + ((pc + 1) & MEMORY_MASK) * _stride;
+    uint32 count = 0;
+    for (uint32 m = 0; m < _stride; ++m)
+    {
+        if (_group[m] && (high[m] != (opcode >> 8) || low[m] != (opcode & 0xFF)))
+            _group[m] = 0x00;
+        count += _group[m] & 1u;
+    }
+    return count;
+}
+
+uint32 batch_interpreter::retire(uint16 max_cycles, bool drew) noexcept
+{
+    const uint8* group = _group.data();
+    uint8* running = _running.data();
+    uint16* executed = _executed.data();
+#ifdef JCHIP8_BATCH_AVX2
+    if (AVX2_SUPPORTED)
+        return retire_avx2(executed, running, group, max_cycles, drew, _stride);
+#endif
+    uint32 retired = 0;
+    for (uint32 m = 0; m < _stride; ++m)
+    {
+        executed[m] = static_cast<uint16>(executed[m] - widen(group[m]));
+        uint8 done = static_cast<uint8>(group[m] & (drew ? 0xFF : -static_cast<int>(executed[m] == max_cycles)));
+        running[m] &= static_cast<uint8>(~done);
+        retired += done & 1u;
+    }
+    return retired;
+}
+
+void batch_interpreter::execute(uint16 opcode, uint32 group_size, uint32 leader)
+{
+    if (group_size * SCALAR_GROUP_RATIO <= _stride)
+    {
+        for (uint32 m = leader, found = 0; found < group_size; ++m)
+        {
+            if (!_group[m])
+                continue;
+
+            _pc[m] += 2;
+            execute_machine(m, opcode);
+            ++found;
+        }
+        _stats.scalar_cycles += group_size;
+        return;
+    }
+
+    const uint8* group = _group.data();
+    add_words(_pc.data(), 2, group, _stride);
+
+    uint8 X = static_cast<uint8>((opcode & 0x0F00) >> 8);
+    uint8 Y = static_cast<uint8>((opcode & 0x00F0) >> 4);
+    uint8 N = static_cast<uint8>(opcode & 0x000F);
+    uint8 NN = static_cast<uint8>(opcode & 0x00FF);
+    uint16 NNN = static_cast<uint16>(opcode & 0x0FFF);
+    uint8* vx = row(_V, X);
+    uint8* vy = row(_V, Y);
+    uint8* vf = row(_V, 0xF);
+    uint8* immediate = _immediate.data();
+
+    switch (opcode >> 12)
+    {
+        case 0x00:
+            if (NN == 0xE0)
+            {
+                for (uint32 pixel = 0; pixel < GRAPHICS_WIDTH * GRAPHICS_HEIGHT; ++pixel)
+                {
+                    uint8* pixels = row(_graphics, pixel);
+                    for (uint32 m = 0; m < _stride; ++m)
+                        pixels[m] &= static_cast<uint8>(~group[m]);
+                }
+                for (uint32 m = 0; m < _stride; ++m)
+                    _draw_flag[m] |= group[m] & 1;
+            }
+            else if (NN == 0xEE)
+            {
+                execute_each(opcode, group_size, leader);
+            }
+            break;
+
+        case 0x01:
+            set_words(_pc.data(), NNN, group, _stride);
+            break;
+
+        case 0x03:
+            std::memset(immediate, NN, _stride);
+            skip_op<true>(_pc.data(), vx, immediate, group, _stride);
+            break;
+
+        case 0x04:
+            std::memset(immediate, NN, _stride);
+            skip_op<false>(_pc.data(), vx, immediate, group, _stride);
+            break;
+
+        case 0x05:
+            skip_op<true>(_pc.data(), vx, vy, group, _stride);
+            break;
+
+        case 0x06:
+            std::memset(immediate, NN, _stride);
+            byte_op<op_copy>(vx, vx, immediate, nullptr, group, _stride);
+            break;
+
+        case 0x07:
+            std::memset(immediate, NN, _stride);
+            byte_op<op_add_no_carry>(vx, vx, immediate, nullptr, group, _stride);
+            break;
+
+        case 0x08:
+            switch (N)
+            {
+                case 0x00:
+                    byte_op<op_copy>(vx, vx, vy, nullptr, group, _stride);
+                    break;
+
+                case 0x01:
+                    _quirks.logic_resets_vf ? byte_op<op_or<true>>(vx, vx, vy, vf, group, _stride)
+                                            : byte_op<op_or<false>>(vx, vx, vy, vf, group, _stride);
+                    break;
+
+                case 0x02:
+                    _quirks.logic_resets_vf ? byte_op<op_and<true>>(vx, vx, vy, vf, group, _stride)
+                                            : byte_op<op_and<false>>(vx, vx, vy, vf, group, _stride);
+                    break;
+
+                case 0x03:
+                    _quirks.logic_resets_vf ? byte_op<op_xor<true>>(vx, vx, vy, vf, group, _stride)
+                                            : byte_op<op_xor<false>>(vx, vx, vy, vf, group, _stride);
+                    break;
+
+                case 0x04:
+                    byte_op<op_add>(vx, vx, vy, vf, group, _stride);
+                    break;
+
+                case 0x05:
+                    byte_op<op_sub>(vx, vx, vy, vf, group, _stride);
+                    break;
+
+                case 0x06:
+                    byte_op<op_shift_right>(vx, vx, _quirks.shift_uses_vy ? vy : vx, vf, group, _stride);
+                    break;
+
+                case 0x07:
+                    byte_op<op_sub_reverse>(vx, vx, vy, vf, group, _stride);
+                    break;
+
+                case 0x0E:
+                    byte_op<op_shift_left>(vx, vx, _quirks.shift_uses_vy ? vy : vx, vf, group, _stride);
+                    break;
+            }
+            break;
+
+        case 0x09:
+            skip_op<false>(_pc.data(), vx, vy, group, _stride);
+            break;
+
+        case 0x0A:
+            set_words(_I.data(), NNN, group, _stride);
+            break;
+
+        case 0x0D:
+        {
+            // VF is cleared before the coordinates are read, so a sprite drawn at VF is drawn at 0
+            uint16 I = 0;
+            uint8 start_x = 0;
+            uint8 start_y = 0;
+            if (uniform(_I.data(), I) && (X == 0xF || uniform(vx, start_x)) && (Y == 0xF || uniform(vy, start_y)))
+                draw_uniform(I, start_x, start_y, N);
+            else
+                execute_each(opcode, group_size, leader);
+            break;
+        }
+
+        case 0x0F:
+            switch (NN)
+            {
+                case 0x07:
+                    byte_op<op_copy>(vx, vx, _delay_timer.data(), nullptr, group, _stride);
+                    break;
+
+                case 0x15:
+                    byte_op<op_copy>(_delay_timer.data(), _delay_timer.data(), vx, nullptr, group, _stride);
+                    break;
+
+                case 0x18:
+                    byte_op<op_copy>(_sound_timer.data(), _sound_timer.data(), vx, nullptr, group, _stride);
+                    break;
+
+                case 0x1E:
+                    add_bytes_to_words(_I.data(), vx, group, _stride);
+                    break;
+
+                case 0x55:
+                case 0x65:
+                {
+                    // With one I across the group, each register is a row to row copy
+                    uint16 I = 0;
+                    if (!uniform(_I.data(), I))
+                    {
+                        execute_each(opcode, group_size, leader);
+                        break;
+                    }
+
+                    for (uint8 i = 0; i <= X; ++i)
+                    {
+                        uint16 address = static_cast<uint16>((I + i) & MEMORY_MASK);
+                        uint8* memory = row(_memory, address);
+                        uint8* v = row(_V, i);
+                        if (NN == 0x55)
+                        {
+                            byte_op<op_copy>(memory, memory, v, nullptr, group, _stride);
+                            _divergent_memory[address] = 1;
+                        }
+                        else
+                        {
+                            byte_op<op_copy>(v, v, memory, nullptr, group, _stride);
+                        }
+                    }
+
+                    if (_quirks.load_store_increments_i)
+                        add_words(_I.data(), static_cast<uint16>(X + 1), group, _stride);
+                    break;
+                }
+
+                default:
+                    execute_each(opcode, group_size, leader);
+                    break;
+            }
+            break;
+
+        default:
+            execute_each(opcode, group_size, leader);
+            break;
+    }
+}
+
+void batch_interpreter::execute_each(uint16 opcode, uint32 group_size, uint32 leader)
+{
+    for (uint32 m = leader, found = 0; found < group_size; ++m)
+    {
+        if (!_group[m])
+            continue;
+
+        execute_machine(m, opcode);
+        ++found;
+    }
+    _stats.scalar_cycles += group_size;
+}
+
+void batch_interpreter::execute_machine(uint32 machine, uint16 opcode)
+{
+    // JChip8::execute over one column of the tables, for the opcodes that index per machine state.  The PC
+    // has already been advanced past the opcode.
+    const uint32 m = machine;
+    uint8 X = static_cast<uint8>((opcode & 0x0F00) >> 8);
+    uint8 Y = static_cast<uint8>((opcode & 0x00F0) >> 4);
+    uint8 N = static_cast<uint8>(opcode & 0x000F);
+    uint8 NN = static_cast<uint8>(opcode & 0x00FF);
+    uint16 NNN = static_cast<uint16>(opcode & 0x0FFF);
+    auto V = [&](uint8 r) -> uint8& { return _V[r * _stride + m]; };
+    uint16& pc = _pc[m];
+    uint16& sp = _sp[m];
+    uint16& I = _I[m];
+
+    switch (opcode >> 12)
+    {
+        case 0x00:
+            if (NN == 0xE0)
+            {
+                for (uint32 pixel = 0; pixel < GRAPHICS_WIDTH * GRAPHICS_HEIGHT; ++pixel)
+                    _graphics[pixel * _stride + m] = 0;
+                _draw_flag[m] = 1;
+            }
+            else if (NN == 0xEE)
+            {
+                sp = static_cast<uint16>((sp - 1) & STACK_MASK);
+                pc = _stack[sp * _stride + m];
+            }
+            break;
+
+        case 0x01:
+            pc = NNN;
+            break;
+
+        case 0x02:
+            _stack[(sp & STACK_MASK) * _stride + m] = pc;
+            sp = static_cast<uint16>((sp + 1) & STACK_MASK);
+            pc = NNN;
+            break;
+
+        case 0x03:
+            if (V(X) == NN) pc += 2;
+            break;
+
+        case 0x04:
+            if (V(X) != NN) pc += 2;
+            break;
+
+        case 0x05:
+            if (V(X) == V(Y)) pc += 2;
+            break;
+
+        case 0x06:
+            V(X) = NN;
+            break;
+
+        case 0x07:
+            V(X) += NN;
+            break;
+
+        case 0x08:
+        {
+            uint8 flag = 0;
+            switch (N)
+            {
+                case 0x00: V(X) = V(Y); break;
+                case 0x01: V(X) |= V(Y); if (_quirks.logic_resets_vf) V(0xF) = 0; break;
+                case 0x02: V(X) &= V(Y); if (_quirks.logic_resets_vf) V(0xF) = 0; break;
+                case 0x03: V(X) ^= V(Y); if (_quirks.logic_resets_vf) V(0xF) = 0; break;
+                case 0x04: V(X) = op_add::apply(V(X), V(Y), flag); V(0xF) = flag; break;
+                case 0x05: V(X) = op_sub::apply(V(X), V(Y), flag); V(0xF) = flag; break;
+                case 0x06: V(X) = op_shift_right::apply(V(X), _quirks.shift_uses_vy ? V(Y) : V(X), flag); V(0xF) = flag; break;
+                case 0x07: V(X) = op_sub_reverse::apply(V(X), V(Y), flag); V(0xF) = flag; break;
+                case 0x0E: V(X) = op_shift_left::apply(V(X), _quirks.shift_uses_vy ? V(Y) : V(X), flag); V(0xF) = flag; break;
+            }
+            break;
+        }
+
+        case 0x09:
+            if (V(X) != V(Y)) pc += 2;
+            break;
+
+        case 0x0A:
+            I = NNN;
+            break;
+
+        case 0x0B:
+            pc = static_cast<uint16>(NNN + V(0));
+            break;
+
+        case 0x0C:
+            V(X) = static_cast<uint8>((_rng[m]() >> 24) & NN);
+            break;
+
+        case 0x0D:
+        {
+            V(0xF) = 0;
+            uint8 height = N;
+            uint8 start_x = V(X);
+            uint8 start_y = V(Y);
+
+            for (uint8 i = 0; i < height; ++i)
+            {
+                uint8 sprite = memory_at(static_cast<uint16>(I + i), m);
+                uint8 row_y = start_y + i;
+
+                if (row_y >= GRAPHICS_HEIGHT)
+                {
+                    if (!_quirks.clip_sprites || start_y >= GRAPHICS_HEIGHT) row_y %= GRAPHICS_HEIGHT;
+                    else break;
+                }
+
+                for (int8 j = 0; j < 8; ++j)
+                {
+                    uint8 bit = (sprite & 0x80) >> 7;
+                    uint8 col = static_cast<uint8>(start_x + j);
+
+                    if (col >= GRAPHICS_WIDTH)
+                    {
+                        if (!_quirks.clip_sprites || start_x >= GRAPHICS_WIDTH) col %= GRAPHICS_WIDTH;
+                        else break;
+                    }
+
+                    uint8& pixel = _graphics[static_cast<size_t>(row_y * GRAPHICS_WIDTH + col) * _stride + m];
+                    if (bit == 1)
+                    {
+                        if (pixel)
+                            V(0xF) = 1;
+                        pixel ^= 1;
+                    }
+
+                    sprite = static_cast<uint8>(sprite << 1);
+                }
+                _draw_flag[m] = 1;
+            }
+            break;
+        }
+
+        case 0x0E:
+        {
+            bool held = (_keys[m] >> (V(X) & KEY_MASK)) & 1;
+            if ((NN == 0x9E && held) || (NN == 0xA1 && !held))
+                pc += 2;
+            break;
+        }
+
+        case 0x0F:
+            switch (NN)
+            {
+                case 0x02:
+                    for (uint8 i = 0; i < 16; ++i)
+                        _audio_pattern[i * _stride + m] = memory_at(static_cast<uint16>(I + i), m);
+                    _audio_pattern_loaded[m] = 1;
+                    break;
+
+                case 0x3A:
+                    _audio_pitch[m] = V(X);
+                    break;
+
+                case 0x0A:
+                {
+                    uint8& key_pressed = _key_wait_pressed[m];
+                    uint8& key = _key_wait_key[m];
+
+                    for (uint8 i = 0; key == 0x0FF && i < 16; ++i)
+                    {
+                        if ((_keys[m] >> i) & 1)
+                        {
+                            key = i;
+                            key_pressed = 1;
+                            break;
+                        }
+                    }
+
+                    if (!key_pressed)
+                    {
+                        pc -= 2;
+                    }
+                    else
+                    {
+                        if ((_keys[m] >> (key & KEY_MASK)) & 1)
+                            pc -= 2;
+                        else
+                        {
+                            V(X) = key;
+                            key = 0xFF;
+                            key_pressed = 0;
+                        }
+                    }
+                    break;
+                }
+
+                case 0x07:
+                    V(X) = _delay_timer[m];
+                    break;
+
+                case 0x15:
+                    _delay_timer[m] = V(X);
+                    break;
+
+                case 0x18:
+                    _sound_timer[m] = V(X);
+                    break;
+
+                case 0x1E:
+                    I += V(X);
+                    break;
+
+                case 0x29:
+                    I = static_cast<uint16>(V(X) * 5);
+                    break;
+
+                case 0x33:
+                {
+                    uint8 decimal_value = V(X);
+                    memory_at(static_cast<uint16>(I + 2), m) = static_cast<uint8>(decimal_value % 10);
+                    decimal_value /= 10;
+                    memory_at(static_cast<uint16>(I + 1), m) = static_cast<uint8>(decimal_value % 10);
+                    decimal_value /= 10;
+                    memory_at(I, m) = decimal_value;
+                    for (uint16 i = 0; i < 3; ++i)
+                        _divergent_memory[(I + i) & MEMORY_MASK] = 1;
+                    break;
+                }
+
+                case 0x55:
+                    for (uint8 i = 0; i <= X; ++i)
+                    {
+                        memory_at(static_cast<uint16>(I + i), m) = V(i);
+                        _divergent_memory[(I + i) & MEMORY_MASK] = 1;
+                    }
+                    if (_quirks.load_store_increments_i)
+                        I = static_cast<uint16>(I + X + 1);
+                    break;
+
+                case 0x65:
+                    for (uint8 i = 0; i <= X; ++i)
+                        V(i) = memory_at(static_cast<uint16>(I + i), m);
+                    if (_quirks.load_store_increments_i)
+                        I = static_cast<uint16>(I + X + 1);
+                    break;
+            }
+            break;
+    }
+}
+
+void batch_interpreter::draw_uniform(uint16 I, uint8 start_x, uint8 start_y, uint8 height)
+{
+    // Every machine in the group draws the same rows and columns, so clipping is worked out once
+    uint8 rows[16];
+    uint8 row_count = 0;
+    for (uint8 i = 0; i < height; ++i)
+    {
+        uint8 row_y = start_y + i;
+        if (row_y >= GRAPHICS_HEIGHT)
+        {
+            if (!_quirks.clip_sprites || start_y >= GRAPHICS_HEIGHT) row_y %= GRAPHICS_HEIGHT;
+            else break;
+        }
+        rows[row_count++] = row_y;
+    }
+
+    uint8 cols[8];
+    uint8 col_count = 0;
+    for (uint8 j = 0; j < 8; ++j)
+    {
+        uint8 col = static_cast<uint8>(start_x + j);
+        if (col >= GRAPHICS_WIDTH)
+        {
+            if (!_quirks.clip_sprites || start_x >= GRAPHICS_WIDTH) col %= GRAPHICS_WIDTH;
+            else break;
+        }
+        cols[col_count++] = col;
+    }
+
+    const uint8* group = _group.data();
+    uint8* vf = row(_V, 0xF);
+#ifdef JCHIP8_BATCH_AVX2
+    if (AVX2_SUPPORTED)
+    {
+        draw_avx2(_graphics.data(), vf, _draw_flag.data(), _memory.data(), group, I, rows, row_count, cols, col_count,
+            _stride);
+        return;
+    }
+#endif
+    for (uint32 m = 0; m < _stride; ++m)
+    {
+        if (!group[m])
+            continue;
+
+        uint8 collided = 0;
+        for (uint8 i = 0; i < row_count; ++i)
+        {
+            uint8 sprite = _memory[((I + i) & MEMORY_MASK) * _stride + m];
+            for (uint8 j = 0; j < col_count; ++j)
+            {
+                uint8 bit = (sprite >> (7 - j)) & 1;
+                uint8& pixel = _graphics[static_cast<size_t>(rows[i] * GRAPHICS_WIDTH + cols[j]) * _stride + m];
+                collided |= pixel & bit;
+                pixel ^= bit;
+            }
+        }
+
+        vf[m] = collided;
+        if (row_count > 0)
+            _draw_flag[m] = 1;
+    }
+}
+
+void batch_interpreter::write_state(uint32 machine, const machine_state& in) noexcept
+{
+    const uint32 m = machine;
+    _cycles[m] = in.cycles;
+    _rng[m].seed(in.rng_state);
+    for (uint32 address = 0; address < MEMORY_SIZE; ++address)
+        _memory[address * _stride + m] = in.memory[address];
+    for (uint32 pixel = 0; pixel < GRAPHICS_WIDTH * GRAPHICS_HEIGHT; ++pixel)
+        _graphics[pixel * _stride + m] = in.graphics[pixel] ? 1 : 0;
+
+    for (uint32 i = 0; i < 16; ++i)
+    {
+        _stack[i * _stride + m] = in.stack[i];
+        _V[i * _stride + m] = in.V[i];
+        _audio_pattern[i * _stride + m] = in.audio_pattern[i];
+    }
+    _keys[m] = in.keys;
+    _pc[m] = in.pc;
+    _sp[m] = in.sp;
+    _I[m] = in.I;
+    _delay_timer[m] = in.delay_timer;
+    _sound_timer[m] = in.sound_timer;
+    _draw_flag[m] = in.draw_flag ? 1 : 0;
+    _key_wait_pressed[m] = in.key_wait_pressed ? 1 : 0;
+    _key_wait_key[m] = in.key_wait_key;
+    _audio_pitch[m] = in.audio_pitch;
+    _audio_pattern_loaded[m] = in.audio_pattern_loaded ? 1 : 0;
+    _vblank_wait[m] = in.vblank_wait ? 1 : 0;
+    _sound_playing[m] = in.sound_playing ? 1 : 0;
+}
+
+bool batch_interpreter::uniform(const uint8* values, uint8& value) const noexcept
+{
+    bool first = true;
+    for (uint32 m = 0; m < _machines; ++m)
+    {
+        if (!_group[m])
+            continue;
+        if (first)
+            value = values[m];
+        else if (values[m] != value)
+            return false;
+        first = false;
+    }
+    return true;
+}
+
+bool batch_interpreter::uniform(const uint16* values, uint16& value) const noexcept
+{
+    bool first = true;
+    for (uint32 m = 0; m < _machines; ++m)
+    {
+        if (!_group[m])
+            continue;
+        if (first)
+            value = values[m];
+        else if (values[m] != value)
+            return false;
+        first = false;
+    }
+    return true;
+}
+
+uint8* batch_interpreter::row(std::vector<uint8>& table, uint32 index) noexcept
+{
+    return table.data() + static_cast<size_t>(index) * _stride;
+}
+
+uint8& batch_interpreter::memory_at(uint16 address, uint32 machine) noexcept
+{
+    return _memory[(address & MEMORY_MASK) * _stride + machine];
+}
@@ -0,0 +1,305 @@
+#include "debugger.h"
+#include "jchip8.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::string hex(uint32 value, int digits)
+    {
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "0x%0*X", digits, value);
+        return buffer;
+    }
+
+    const char* compare_symbol(compare_op op)
+    {
+        switch (op)
+        {
+            case compare_op::equal:     return "==";
+            case compare_op::not_equal: return "!=";
+            case compare_op::less:      return "<";
+            case compare_op::greater:   return ">";
+        }
+        return "?";
+    }
+}
+
+debugger::debugger()
+    : _breakpoints{}
+    , _watch_flags{}
+    , _watchpoints{}
+    , _conditions{}
+    , _conditions_held{}
+    , _break_reason{}
+    , _temporary_stop{ false }
+    , _temporary_address{ 0 }
+    , _temporary_match_sp{ false }
+    , _temporary_sp{ 0 }
+    , _skip_once{ false }
+    , _skip_pc{ 0 }
+    , _watch_hit{ false }
+    , _watch_address{ 0 }
+    , _watch_write{ false }
+{
+
+}
+
+bool debugger::active() const noexcept
+{
+    return _breakpoints.any() || !_watchpoints.empty() || !_conditions.empty() || _temporary_stop;
+}
+
+const std::string& debugger::break_reason() const noexcept { return _break_reason; }
+
+void debugger::toggle_breakpoint(uint16 address)
+{
+    address %= DEBUGGER_ADDRESS_SPACE;
+    _breakpoints.flip(address);
+}
+
+bool debugger::has_breakpoint(uint16 address) const noexcept
+{
+    return _breakpoints.test(address % DEBUGGER_ADDRESS_SPACE);
+}
+
+std::vector<uint16> debugger::breakpoints() const
+{
+    std::vector<uint16> addresses;
+    for (uint16 address = 0; address < DEBUGGER_ADDRESS_SPACE; ++address)
+    {
+        if (_breakpoints.test(address))
+            addresses.push_back(address);
+    }
+    return addresses;
+}
+
+void debugger::add_watchpoint(const watchpoint& watch)
+{
+    _watchpoints.push_back(watch);
+    rebuild_watch_flags();
+}
+
+void debugger::remove_watchpoint(size_t index)
+{
+    if (index >= _watchpoints.size())
+        throw std::out_of_range("Watchpoint index out of range");
+
+    _watchpoints.erase(_watchpoints.begin() + static_cast<std::ptrdiff_t>(index));
+    rebuild_watch_flags();
+}
+
+const std::vector<watchpoint>& debugger::watchpoints() const noexcept { return _watchpoints; }
+
+void debugger::add_condition(const register_condition& condition)
+{
+    _conditions.push_back(condition);
+    _conditions_held.push_back(false);
+}
+
+void debugger::remove_condition(size_t index)
+{
+    if (index >= _conditions.size())
+        throw std::out_of_range("Condition index out of range");
+
+    _conditions.erase(_conditions.begin() + static_cast<std::ptrdiff_t>(index));
+    _conditions_held.erase(_conditions_held.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+const std::vector<register_condition>& debugger::conditions() const noexcept { return _conditions; }
+
+void debugger::clear()
+{
+    _breakpoints.reset();
+    _watchpoints.clear();
+    _conditions.clear();
+    _conditions_held.clear();
+    _temporary_stop = false;
+    rebuild_watch_flags();
+}
+
+void debugger::resume(uint16 pc) noexcept
+{
+    // Leaving a breakpoint must not immediately hit the same breakpoint again
+    _skip_once = true;
+    _skip_pc = pc;
+    _break_reason.clear();
+}
+
+void debugger::run_to(uint16 address) noexcept
+{
+    _temporary_stop = true;
+    _temporary_address = address;
+    _temporary_match_sp = false;
+}
+
+void debugger::run_to_return(uint16 return_address, uint16 sp) noexcept
+{
+    // Matching the stack depth stops recursive calls from breaking on an inner return
+    _temporary_stop = true;
+    _temporary_address = return_address;
+    _temporary_match_sp = true;
+    _temporary_sp = sp;
+}
+
+bool debugger::check_before(uint16 pc, uint16 sp)
+{
+    if (_skip_once)
+    {
+        _skip_once = false;
+        if (pc == _skip_pc)
+            return false;
+    }
+
+    if (_temporary_stop && pc == _temporary_address && (!_temporary_match_sp || sp == _temporary_sp))
+    {
+        _temporary_stop = false;
+        _break_reason = "Stopped at " + hex(pc, 3);
+        return true;
+    }
+
+    if (_breakpoints.test(pc % DEBUGGER_ADDRESS_SPACE))
+    {
+        _break_reason = "Breakpoint at " + hex(pc, 3);
+        return true;
+    }
+
+    return false;
+}
+
+bool debugger::check_after(const JChip8& chip8)
+{
+    if (_watch_hit)
+    {
+        _watch_hit = false;
+        _break_reason = std::string(_watch_write ? "Write to " : "Read from ") + hex(_watch_address, 3);
+        return true;
+    }
+
+    // Conditions break when they become true rather than while they hold, so Continue can run past one.  Every
+    // condition is evaluated each time, so the ones not reported still see their edges.
+    bool stop = false;
+    for (size_t i = 0; i < _conditions.size(); ++i)
+    {
+        const register_condition& condition = _conditions[i];
+        uint16 value = condition.reg == CONDITION_REGISTER_I ? chip8.I : chip8.V[condition.reg & 0xF];
+        bool hit = false;
+        switch (condition.op)
+        {
+            case compare_op::equal:     hit = value == condition.value; break;
+            case compare_op::not_equal: hit = value != condition.value; break;
+            case compare_op::less:      hit = value < condition.value;  break;
+            case compare_op::greater:   hit = value > condition.value;  break;
+        }
+
+        bool became_true = hit && !_conditions_held[i];
+        _conditions_held[i] = hit;
+        if (became_true && !stop)
+        {
+            std::string reg = condition.reg == CONDITION_REGISTER_I ? "I" : "V" + hex(condition.reg, 1).substr(2);
+            _break_reason = reg + " " + compare_symbol(condition.op) + " " + hex(condition.value, 2);
+            stop = true;
+        }
+    }
+
+    return stop;
+}
+
+void debugger::on_read(uint16 address) noexcept
+{
+    if (_watch_flags[address % DEBUGGER_ADDRESS_SPACE] & WATCH_READ)
+    {
+        _watch_hit = true;
+        _watch_address = address;
+        _watch_write = false;
+    }
+}
+
+void debugger::on_write(uint16 address) noexcept
+{
+    if (_watch_flags[address % DEBUGGER_ADDRESS_SPACE] & WATCH_WRITE)
+    {
+        _watch_hit = true;
+        _watch_address = address;
+        _watch_write = true;
+    }
+}
+
+void debugger::rebuild_watch_flags()
+{
+    // Flatten the ranges into a per-address table so a memory access costs one lookup
+    _watch_flags.fill(0);
+    for (const watchpoint& watch : _watchpoints)
+    {
+        for (uint32 address = watch.start; address <= watch.end && address < DEBUGGER_ADDRESS_SPACE; ++address)
+            _watch_flags[address] |= watch.access;
+    }
+}
+
+std::string disassemble(uint16 opcode)
+{
+    std::string x = "V" + hex((opcode >> 8) & 0xF, 1).substr(2);
+    std::string y = "V" + hex((opcode >> 4) & 0xF, 1).substr(2);
+    std::string nnn = hex(opcode & 0xFFF, 3);
+    std::string nn = hex(opcode & 0xFF, 2);
+
+    switch (opcode >> 12)
+    {
+        case 0x0:
+            if (opcode == 0x00E0) return "CLS";
+            if (opcode == 0x00EE) return "RET";
+            return "SYS " + nnn;
+        case 0x1: return "JP " + nnn;
+        case 0x2: return "CALL " + nnn;
+        case 0x3: return "SE " + x + ", " + nn;
+        case 0x4: return "SNE " + x + ", " + nn;
+        case 0x5: return "SE " + x + ", " + y;
+        case 0x6: return "LD " + x + ", " + nn;
+        case 0x7: return "ADD " + x + ", " + nn;
+        case 0x8:
+            switch (opcode & 0xF)
+            {
+                case 0x0: return "LD " + x + ", " + y;
+                case 0x1: return "OR " + x + ", " + y;
+                case 0x2: return "AND " + x + ", " + y;
+                case 0x3: return "XOR " + x + ", " + y;
+                case 0x4: return "ADD " + x + ", " + y;
+                case 0x5: return "SUB " + x + ", " + y;
+                case 0x6: return "SHR " + x + ", " + y;
+                case 0x7: return "SUBN " + x + ", " + y;
+                case 0xE: return "SHL " + x + ", " + y;
+            }
+            break;
+        case 0x9: return "SNE " + x + ", " + y;
+        case 0xA: return "LD I, " + nnn;
+        case 0xB: return "JP V0, " + nnn;
+        case 0xC: return "RND " + x + ", " + nn;
+        case 0xD: return "DRW " + x + ", " + y + ", " + std::to_string(opcode & 0xF);
+        case 0xE:
+            if ((opcode & 0xFF) == 0x9E) return "SKP " + x;
+            if ((opcode & 0xFF) == 0xA1) return "SKNP " + x;
+            break;
+        case 0xF:
+            switch (opcode & 0xFF)
+            {
+                case 0x02: return "AUDIO";
+                case 0x07: return "LD " + x + ", DT";
+                case 0x0A: return "LD " + x + ", K";
+                case 0x15: return "LD DT, " + x;
+                case 0x18: return "LD ST, " + x;
+                case 0x1E: return "ADD I, " + x;
+                case 0x29: return "LD F, " + x;
+                case 0x33: return "LD B, " + x;
+                case 0x3A: return "PITCH " + x;
+                case 0x55: return "LD [I], " + x;
+                case 0x65: return "LD " + x + ", [I]";
+            }
+            break;
+    }
+
+    return "DW " + hex(opcode, 4);
+}
@@ -0,0 +1,1368 @@
+﻿#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable:6385)
+#endif
+
+#include "jchip8.h"
+#include "chip8_hooks.h"
+#include "debugger.h"
+#include "recompiled.h"
+#include "trace_recorder.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <utility>
+#include <string>
+#include <vector>
+
+instruction_history::instruction_history() 
+    : _instructions{ }
+    , _ip{ MAX_INSTRUCTION_HISTORY - 1 }
+    , _instruction_descriptions{
+        {0x00E0, "Clear the display"},
+        {0x00EE, "Return from a subroutine"},
+        {0x1000, "Jump to address NNN"},
+        {0x2000, "Call subroutine at NNN"},
+        {0x3000, "Skip next instruction if Vx equals NN"},
+        {0x4000, "Skip next instruction if Vx not equal to NN"},
+        {0x5000, "Skip next instruction if Vx equals Vy"},
+        {0x6000, "Set Vx to NN"},
+        {0x7000, "Add NN to Vx"},
+        {0x8000, "Set Vx to the value of Vy"},
+        {0x8001, "Set Vx to Vx OR Vy"},
+        {0x8002, "Set Vx to Vx AND Vy"},
+        {0x8003, "Set Vx to Vx XOR Vy"},
+        {0x8004, "Add Vy to Vx, set VF to 1 if there's a carry, 0 if not"},
+        {0x8005, "Subtract Vy from Vx, set VF to 0 if there's a borrow, 1 if not"},
+        {0x8006, "Store the least significant bit of Vx in VF, then shift Vx to the right by 1"},
+        {0x8007, "Set Vx to Vy minus Vx, set VF to 0 if there's a borrow, 1 if not"},
+        {0x800E, "Store the most significant bit of Vx in VF, then shift Vx to the left by 1"},
+        {0x9000, "Skip next instruction if Vx not equal to Vy"},
+        {0xA000, "Set I to the address NNN"},
+        {0xB000, "Jump to the address NNN plus V0"},
+        {0xC000, "Set Vx to the result of a bitwise AND operation on a random number and NN"},
+        {0xD000, "Draw a sprite at coordinate (Vx, Vy) with a width of 8 pixels and a height of N pixels"},
+        {0xE09E, "Skip the next instruction if the key stored in Vx is pressed"},
+        {0xE0A1, "Skip the next instruction if the key stored in Vx is not pressed"},
+        {0xF007, "Set Vx to the value of the delay timer"},
+        {0xF00A, "Wait for a key press, store the value of the key in Vx"},
+        {0xF015, "Set the delay timer to Vx"},
+        {0xF018, "Set the sound timer to Vx"},
+        {0xF01E, "Add Vx to I"},
+        {0xF029, "Set I to the location of the sprite for the character in Vx"},
+        {0xF033, "Store the binary-coded decimal representation of Vx at the addresses I, I+1, and I+2"},
+        {0xF055, "Store registers V0 through Vx in memory starting at location I"},
+        {0xF065, "Read registers V0 through Vx from memory starting at location I"}
+    }
+{
+
+}
+
+void instruction_history::add_instruction(uint16 memory_address, instruction& instr)
+{
+    _ip = (_ip + 1) % MAX_INSTRUCTION_HISTORY;
+    _instructions[_ip] = std::make_pair(memory_address, instr);
+}
+
+void instruction_history::log_last_instruction() const noexcept
+{
+    const std::pair<uint16, instruction>& last_instruction = _instructions[_ip];
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::cout << "Address: [0x" << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << last_instruction.first
+              << "]   Instruction: [0x" << std::setw(4) << std::setfill('0') << last_instruction.second.opcode
+              << "]   Description: [" << get_instruction_description(last_instruction.second.opcode) << "]\n";
+    std::cout.flags(flags);
+}
+
+const std::pair<uint16, instruction>& instruction_history::get_instruction(uint32 index) const
+{
+    if (index >= MAX_INSTRUCTION_HISTORY)
+        throw std::out_of_range("Index out of range");
+
+    return _instructions[index];
+}
+
+uint32 instruction_history::get_size() const noexcept { return MAX_INSTRUCTION_HISTORY; }
+
+void instruction_history::clear()
+{
+    std::fill(_instructions.begin(), _instructions.end(), std::make_pair<uint16, instruction>(0x00, instruction()));
+}
+
+const std::string& instruction_history::get_instruction_description(uint16 opcode) const noexcept
+{
+    uint16_t masked_opcode = opcode & 0xF000;
+    if (_instruction_descriptions.find(masked_opcode) != _instruction_descriptions.end())
+        return _instruction_descriptions.at(masked_opcode);
+
+    masked_opcode = opcode & 0xF00F;
+    if (_instruction_descriptions.find(masked_opcode) != _instruction_descriptions.end())
+        return _instruction_descriptions.at(masked_opcode);
+
+    masked_opcode = opcode & 0xF0FF;
+    if (_instruction_descriptions.find(masked_opcode) != _instruction_descriptions.end()) 
+        return _instruction_descriptions.at(masked_opcode);
+
+    // A reference to a temporary string would dangle once this returned
+    static const std::string unknown = "Unknown opcode";
+    return unknown;
+}
+
+JChip8::JChip8(uint16 ips_)
+    : V{ 0 }
+    , stack{ 0 }
+    , pc{ ROM_START_LOCATION }
+    , I{ 0 }
+    , sp{ 0 }
+    , keypad{ 0 }
+    , delay_timer{ 0 }
+    , sound_timer{ 0 }
+    , state{ emulator_state::running }
+    , ips{ ips_ }
+    , _cycles{ 0 }
+    , _next_event_cycle{ UINT64_MAX }
+    , _next_input_cycle{ UINT64_MAX }
+    , _next_timer_cycle{ UINT64_MAX }
+    , _rng(std::random_device()())
+    , _dirty_pages{ CLONE_ALL_PAGES }
+    , _draw_flag{ false }
+    , _vblank_wait{ false }
+    , _key_wait_pressed{ false }
+    , _key_wait_key{ 0xFF }
+    , _run{ nullptr }
+    , memory{ 0 }
+    , graphics{ 0 }
+    , _execute{ nullptr }
+    , _interpret{ nullptr }
+    , _debugger{ nullptr }
+    , _hooks{ nullptr }
+    , _instruction_hooks{ false }
+    , _recompiled{ nullptr }
+    , _recompiled_verified{ false }
+    , _rom_loaded{ false }
+    , _sound_playing{ false }
+    , _timer_carry{ 0 }
+    , _timer_clock{ timer_clock::cycles }
+    , _audio_pattern{ 0 }
+    , _audio_pitch{ 64 }
+    , _audio_pattern_loaded{ false }
+    , _inputs_held{ false }
+    , _quirks{}
+    , _input_head{ 0 }
+    , _input_count{ 0 }
+    , _input_queue{}
+#ifdef DEBUG_INSTRUCTIONS
+    , _instruction_history{ std::make_unique<instruction_history>() }
+#endif
+    , _clone_pages{}
+{
+    init_state();
+    select_engine(std::make_integer_sequence<uint16, QUIRK_COMBINATIONS * PROBE_COMBINATIONS>{});
+}
+
+JChip8::~JChip8() = default;
+
+bool JChip8::draw_flag() const noexcept { return _draw_flag; }
+
+instruction JChip8::fetch_instruction() const noexcept
+{
+    instruction instr
+    {
+        .opcode = static_cast<uint16>(memory[pc & MEMORY_MASK] << 8 | memory[(pc + 1) & MEMORY_MASK]),
+        .NNN    = static_cast<uint16>(instr.opcode & 0x0FFF),
+        .NN     = static_cast<uint8>(instr.opcode & 0x00FF),
+        .N      = static_cast<uint8>(instr.opcode & 0x000F),
+        .X      = static_cast<uint8>((instr.opcode & 0x0F00) >> 8),
+        .Y      = static_cast<uint8>((instr.opcode & 0x00F0) >> 4)
+    };
+
+    return instr;
+}
+
+bool JChip8::rom_loaded() const noexcept
+{
+    return _rom_loaded;
+}
+
+uint64 JChip8::cycles() const noexcept
+{
+    return _cycles;
+}
+
+const chip8_quirks& JChip8::quirks() const noexcept
+{
+    return _quirks;
+}
+
+const uint8* JChip8::audio_pattern() const noexcept
+{
+    return _audio_pattern;
+}
+
+uint8 JChip8::audio_pitch() const noexcept
+{
+    return _audio_pitch;
+}
+
+bool JChip8::audio_pattern_loaded() const noexcept
+{
+    return _audio_pattern_loaded;
+}
+
+void JChip8::emulate_cycle()
+{
+    run(1);
+}
+
+uint16 JChip8::run(uint16 max_cycles)
+{
+    // A machine held by the display wait quirk idles up to the vblank first, or runs nothing on the host clock
+    if (_vblank_wait && !wait_for_vblank(UINT64_MAX))
+        return 0;
+    return (this->*_run)(max_cycles);
+}
+
+uint64 JChip8::run_until(uint64 cycle)
+{
+    // Carries on through draws until the cycle counter reaches cycle, or a debugger stops the machine
+    uint64 executed = 0;
+    while (_cycles < cycle)
+    {
+        if (_vblank_wait && (!wait_for_vblank(cycle) || _cycles >= cycle))
+            break;
+
+        uint16 ran = (this->*_run)(static_cast<uint16>(std::min<uint64>(cycle - _cycles, UINT16_MAX)));
+        if (ran == 0)
+            break;
+        executed += ran;
+    }
+    return executed;
+}
+
+uint16 JChip8::run_frame()
+{
+    if (_timer_clock == timer_clock::host)
+    {
+        uint16 executed = run(static_cast<uint16>(ips / 60));
+        update_timers();
+        return executed;
+    }
+
+    // A frame lasts until the next vblank.  A draw still ends the batch early, and the rest of the frame then
+    // passes idle, so every frame is the same length in cycles however much of it ran.
+    idle_until(_cycles);
+    uint64 frame_end = _next_timer_cycle;
+    uint16 executed = 0;
+    if (!_vblank_wait)
+        executed = (this->*_run)(static_cast<uint16>(std::min<uint64>(frame_end - _cycles, UINT16_MAX)));
+    if (state == emulator_state::running)
+        idle_until(frame_end);
+    return executed;
+}
+
+void JChip8::idle_until(uint64 cycle)
+{
+    // Time passes without executing anything, but vblanks and queued input still land on their cycles
+    if (cycle > _cycles)
+        _cycles = cycle;
+    if (_cycles >= _next_event_cycle)
+        service_events(_cycles);
+}
+
+bool JChip8::wait_for_vblank(uint64 limit)
+{
+    // Only update_timers brings a vblank on the host clock, so there is nothing to idle toward
+    if (_timer_clock == timer_clock::host)
+        return false;
+
+    idle_until(std::min(_next_timer_cycle, limit));
+    return !_vblank_wait;
+}
+
+void JChip8::execute_instruction(instruction& instr)
+{
+    (this->*_execute)(instr);
+}
+
+template <typename Probes>
+uint8 JChip8::read_memory(uint16 address)
+{
+    if constexpr (Probes::debugger)
+        _debugger->on_read(address & MEMORY_MASK);
+
+    return memory[address & MEMORY_MASK];
+}
+
+template <typename Probes>
+void JChip8::write_memory(uint16 address, uint8 value)
+{
+    if constexpr (Probes::debugger)
+        _debugger->on_write(address & MEMORY_MASK);
+
+    memory[address & MEMORY_MASK] = value;
+    _dirty_pages |= 1u << ((address & MEMORY_MASK) / CLONE_PAGE_SIZE);
+
+    if constexpr (Probes::hooks)
+    {
+        if (_hooks->on_memory_write)
+            _hooks->on_memory_write(*this, address & MEMORY_MASK, value);
+    }
+}
+
+template <typename Quirks, typename Probes>
+uint16 JChip8::run_cycles(uint16 max_cycles)
+{
+    uint16 executed = 0;
+    bool stopped = false;
+    while (!stopped && executed < max_cycles)
+    {
+        // Events are serviced between spans, so the instructions within one run without checking for them
+        uint64 now = _cycles + executed;
+        if (now >= _next_event_cycle)
+            service_events(now);
+        uint16 span_end = static_cast<uint16>(executed + std::min<uint64>(max_cycles - executed, _next_event_cycle - now));
+
+        while (executed < span_end)
+        {
+            if constexpr (Probes::debugger)
+            {
+                if (_debugger->check_before(pc, sp))
+                {
+                    state = emulator_state::paused;
+                    stopped = true;
+                    break;
+                }
+            }
+
+            instruction instr = fetch_instruction();
+            [[maybe_unused]] uint16 address = pc;
+            if constexpr (Probes::history)
+            {
+                _instruction_history->add_instruction(pc, instr);
+#ifdef DEBUG_INSTRUCTIONS
+                _instruction_history->log_last_instruction();
+#endif
+            }
+            pc += 2;
+
+            execute<Quirks, Probes>(instr);
+            ++executed;
+
+            if constexpr (Probes::hooks)
+            {
+                if (_hooks->on_instruction)
+                    _hooks->on_instruction(*this, address, instr);
+            }
+
+            if constexpr (Probes::debugger)
+            {
+                if (_debugger->check_after(*this))
+                {
+                    state = emulator_state::paused;
+                    stopped = true;
+                    break;
+                }
+            }
+
+            // A draw ends the batch early, so sprites appear at the rate the original hardware showed them.  The
+            // VIP went further and held the machine until the display interrupt, which run() waits out next time.
+            if ((instr.opcode >> 12) == DRAW_INSTRUCTION)
+            {
+                JCHIP8_TRACE_INSTANT("DXYN", "core");
+                if constexpr (Quirks::display_wait)
+                    _vblank_wait = true;
+                stopped = true;
+                break;
+            }
+        }
+    }
+
+    _cycles += executed;
+    return executed;
+}
+
+template <typename Quirks, typename Probes>
+void JChip8::execute(instruction& instr)
+{
+    bool carry;
+    switch (instr.opcode >> 12)
+    {
+        case 0x00:
+            if (instr.NN == 0xE0)
+            {
+                clear_graphics_buffer();
+            }
+            else if (instr.NN == 0xEE)
+            {
+                sp = static_cast<uint16>((sp - 1) & STACK_MASK);
+                pc = stack[sp];
+            }
+            break;
+
+        case 0x01:
+            pc = instr.NNN;
+            break;
+
+        case 0x02:
+            stack[sp & STACK_MASK] = pc;
+            sp = static_cast<uint16>((sp + 1) & STACK_MASK);
+            pc = instr.NNN;
+            break;
+
+        case 0x03:
+            if (V[instr.X] == instr.NN) pc += 2;
+            break;
+
+        case 0x04:
+            if (V[instr.X] != instr.NN) pc += 2;
+            break;
+
+        case 0x05:
+            if (V[instr.X] == V[instr.Y])
+                pc += 2;
+            break;
+
+        case 0x06:
+            V[instr.X] = instr.NN;
+            break;
+
+        case 0x07:
+            V[instr.X] += instr.NN;
+            break;
+
+        case 0x08:
+            switch (instr.N)            
+            {
+                case 0x00:
+                    V[instr.X] = V[instr.Y];
+                    break;
+
+                case 0x01:
+                    V[instr.X] |= V[instr.Y];
+                    if constexpr (Quirks::logic_resets_vf)
+                    {
+                        carry = false;
+                        V[0xF] = carry;
+                    }
+                    break;
+
+                case 0x02:
+                    V[instr.X] &= V[instr.Y];
+                    if constexpr (Quirks::logic_resets_vf)
+                    {
+                        carry = false;
+                        V[0xF] = carry;
+                    }
+                    break;
+
+                case 0x03:
+                    V[instr.X] ^= V[instr.Y];
+                    if constexpr (Quirks::logic_resets_vf)
+                    {
+                        carry = false;
+                        V[0xF] = carry;
+                    }
+                    break;
+
+                case 0x04:
+                    carry = ((uint16)(V[instr.X] + V[instr.Y]) > 255);
+                    V[instr.X] += V[instr.Y];
+                    V[0xF] = carry; 
+                    break;
+
+                case 0x05: 
+                    carry = (V[instr.Y] <= V[instr.X]);
+
+                    V[instr.X] -= V[instr.Y];
+                    V[0xF] = carry;
+                    break;
+
+                case 0x06:
+                {
+                    uint8 source = Quirks::shift_uses_vy ? V[instr.Y] : V[instr.X];
+                    carry = source & 0x1;
+                    V[instr.X] = source >> 1;
+                    V[0xF] = carry;
+                    break;
+                }
+
+                case 0x07:
+                    carry = (V[instr.X] <= V[instr.Y]);
+                    V[instr.X] = V[instr.Y] - V[instr.X];
+                    V[0xF] = carry;
+                    break;
+
+                case 0xE:
+                {
+                    uint8 source = Quirks::shift_uses_vy ? V[instr.Y] : V[instr.X];
+                    carry = (source & 0x80) >> 7;
+                    V[instr.X] = static_cast<uint8>(source << 1);
+                    V[0xF] = carry;
+                    break;
+                }
+            }
+            break;
+
+        case 0x09:
+            if (V[instr.X] != V[instr.Y]) pc += 2;
+            break;
+
+        case 0x0A:
+            I = instr.NNN;
+            break;
+
+        case 0x0B:
+            pc = instr.NNN + V[0];
+            break;
+
+        case 0x0C:
+        {
+            uint8 rnd_num = generate_random_number();
+            V[instr.X] = rnd_num & instr.NN;
+            break;
+        }
+
+        // --------------------------------------------------
+        //                  Draw Instruction
+        // --------------------------------------------------
+        case 0x0D:
+        {
+            // DXYN
+            // Draws a sprite at coordinate (VX, VY) that has a width of 8 pixels and a height of N pixels.
+            // Each row of 8 pixels is read as bit-coded starting from memory location I; I value does not
+            // change after the execution of this instruction. As described above, VF is set to 1 if any screen
+            // pixels are flipped from set to unset when the sprite is drawn, and to 0 if that does not happen.
+            V[0xF] = 0;
+            uint8 height = instr.N;
+            uint8 start_x = V[instr.X];
+            uint8 start_y = V[instr.Y];
+
+            for (uint8 i = 0; i < height; ++i)
+            {
+                uint8 sprite = read_memory<Probes>(static_cast<uint16>(I + i));
+                uint8 row = start_y + i;
+
+                if (row >= GRAPHICS_HEIGHT)
+                {   
+                    // Handle the case where the sprite begins drawing offscreen on the y-axis, by wrapping
+                    if (!Quirks::clip_sprites || start_y >= GRAPHICS_HEIGHT) row %= GRAPHICS_HEIGHT;
+                    // Handle the case where the sprite begins drawing onscreen on the y-axis but moves offscreen, by clipping
+                    else break;
+                }
+
+                for (int8 j = 0; j < 8; ++j)
+                {
+                    uint8 bit = (sprite & 0x80) >> 7;
+                    uint8 col = static_cast<uint8>(start_x + j);
+
+                    if (col >= GRAPHICS_WIDTH)
+                    {
+                        // Handle the case where the sprite begins drawing offscreen on the y-axis, by wrapping
+                        if (!Quirks::clip_sprites || start_x >= GRAPHICS_WIDTH) col %= GRAPHICS_WIDTH;
+                        // Handle the case where the sprite begins drawing onscreen on the y-axis but moves offscreen, by clipping
+                        else break;
+                    }
+
+                    uint16 offset = static_cast<uint16>(row * GRAPHICS_WIDTH + col);
+
+                    if (bit == 1)
+                    {
+                        if (graphics[offset] == static_cast<uint8>(pixel_state::on))
+                        {
+                            graphics[offset] = 0;
+                            V[0xF] = 1;
+                        }
+                        else
+                        {
+                            graphics[offset] = 1;
+                        }
+                    }
+
+                    sprite = static_cast<uint8>(sprite << 1);
+                }
+                _draw_flag = true;
+                _dirty_pages |= 1u << (CLONE_MEMORY_PAGES + static_cast<uint32>(row) * GRAPHICS_WIDTH / CLONE_PAGE_SIZE);
+            }
+            break;
+        }
+
+        case 0x0E:
+            if (instr.NN == 0x9E)
+            {
+                uint8 key = static_cast<uint8>(V[instr.X] & KEY_MASK);
+                if (keypad & (1u << key))
+                    pc += 2;
+            }
+            else if (instr.NN == 0xA1)
+            {
+                uint8 key = static_cast<uint8>(V[instr.X] & KEY_MASK);
+                if (!(keypad & (1u << key)))
+                    pc += 2;
+            }
+            break;
+
+        case 0x0F:
+            switch (instr.NN)
+            {
+                case 0x02:
+                {
+                    // XO-CHIP F002: load the 16 byte, 1 bit per sample audio pattern from memory at I
+                    for (uint8 i = 0; i < sizeof(_audio_pattern); ++i)
+                        _audio_pattern[i] = read_memory<Probes>(static_cast<uint16>(I + i));
+                    _audio_pattern_loaded = true;
+                    break;
+                }
+
+                case 0x3A:
+                    // XO-CHIP FX3A: the pattern plays at 4000 * 2^((VX - 64) / 48) bits per second
+                    _audio_pitch = V[instr.X];
+                    break;
+
+                case 0x0A:
+                {
+                    // The wait spans several executions of this instruction, so its progress lives in the machine
+                    bool& key_pressed = _key_wait_pressed;
+                    uint8& key = _key_wait_key;
+
+                    // The lowest key held down breaks the loop
+                    if (key == 0x0FF && keypad != 0)
+                    {
+                        key = static_cast<uint8>(std::countr_zero(keypad));
+                        key_pressed = true;
+                    }
+
+                    // If no key was pressed, we run the same instruction again since it's a blocking instruction
+                    if (!key_pressed)
+                    {
+                        pc -= 2;
+                    }
+                    else
+                    {
+                        // Key input should happen on KeyUp, so check if it's still held down,
+                        // and if it is, run the same instruction again
+                        if (keypad & (1u << (key & KEY_MASK)))
+                            pc -= 2;
+                        else
+                        {
+                            // Set register Vx = key, reset the key and key_pressed flag
+                            V[instr.X] = key;
+                            key = 0xFF;
+                            key_pressed = false;
+                        }
+                    }
+
+                    break;
+                }
+
+                case 0x07:
+                    V[instr.X] = delay_timer;
+                    break;
+
+                case 0x15:
+                    delay_timer = V[instr.X];
+                    break;
+
+                case 0x18:
+                    sound_timer = V[instr.X];
+                    break;
+
+                case 0x1E:
+                    I += V[instr.X];
+                    break;
+
+                case 0x29:
+                    I = V[instr.X] * 5;
+                    break;
+
+                case 0x33:
+                {
+                    uint8 decimal_value = V[instr.X];
+                    write_memory<Probes>(static_cast<uint16>(I + 2), static_cast<uint8>(decimal_value % 10));
+                    decimal_value /= 10;
+                    write_memory<Probes>(static_cast<uint16>(I + 1), static_cast<uint8>(decimal_value % 10));
+                    decimal_value /= 10;
+                    write_memory<Probes>(I, decimal_value);
+                    break;
+                }
+
+                case 0x55:
+                {
+                    for (uint8 i = 0; i <= instr.X; ++i)
+                    {
+                        write_memory<Probes>(static_cast<uint16>(I + i), V[i]);
+                    }
+
+                    if constexpr (Quirks::load_store_increments_i)
+                        I = static_cast<uint16>(I + instr.X + 1);
+                    break;
+                }
+
+                case 0x65:
+                {
+                    for (uint8 i = 0; i <= instr.X; ++i) 
+                    {
+                        V[i] = read_memory<Probes>(static_cast<uint16>(I + i));
+                    }
+
+                    if constexpr (Quirks::load_store_increments_i)
+                        I = static_cast<uint16>(I + instr.X + 1);
+                    break;
+                }
+            }
+            break;
+
+        // --------------------------------------------------
+        //                  Draw Instruction
+        // --------------------------------------------------
+
+        default:
+            std::cout << "Unimplemented instruction";
+            break;
+    }
+}
+
+template <uint16... Engines>
+void JChip8::select_engine(std::integer_sequence<uint16, Engines...>)
+{
+    static constexpr execute_fn execute_table[] =
+    {
+        &JChip8::execute<quirk_policy<Engines / PROBE_COMBINATIONS>, probe_policy<Engines % PROBE_COMBINATIONS>>...
+    };
+    static constexpr run_fn run_table[] =
+    {
+        &JChip8::run_cycles<quirk_policy<Engines / PROBE_COMBINATIONS>, probe_policy<Engines % PROBE_COMBINATIONS>>...
+    };
+
+    _instruction_hooks = _hooks && _hooks->per_instruction();
+    uint8 probes = static_cast<uint8>((_debugger ? PROBE_DEBUGGER : 0) | (_instruction_history ? PROBE_HISTORY : 0)
+        | (_instruction_hooks ? PROBE_HOOKS : 0));
+    uint16 engine = static_cast<uint16>(quirk_mask(_quirks) * PROBE_COMBINATIONS + probes);
+    _execute = execute_table[engine];
+    _run = run_table[engine];
+    _interpret = _run;
+
+    // Translated code has no probes, so a debugger, history or per-instruction hooks put the machine back on the interpreter
+    _recompiled_verified = false;
+    if (_recompiled && probes == 0 && _recompiled->quirks == quirk_mask(_quirks))
+        _run = &JChip8::run_recompiled;
+}
+
+// Runs translated code between the same events the interpreter stops at.  Anything the translation can't
+// take, such as a jump the recompiler couldn't follow or code the ROM wrote itself, goes through the
+// interpreter one instruction at a time, and a store onto translated code drops the machine back to the
+// interpreter until memory matches the ROM again.
+uint16 JChip8::run_recompiled(uint16 max_cycles)
+{
+    uint16 executed = 0;
+    while (executed < max_cycles)
+    {
+        if (!_recompiled_verified && !(_recompiled_verified = _recompiled->matches(memory)))
+            return static_cast<uint16>(executed + (this->*_interpret)(static_cast<uint16>(max_cycles - executed)));
+
+        if (_cycles >= _next_event_cycle)
+            service_events(_cycles);
+        uint16 budget = static_cast<uint16>(std::min<uint64>(max_cycles - executed, _next_event_cycle - _cycles));
+
+        recompiled_exit exit = recompiled_exit::budget;
+        uint16 ran = _recompiled->run(*this, budget, exit);
+        _cycles += ran;
+        executed = static_cast<uint16>(executed + ran);
+        if (exit == recompiled_exit::drew)
+        {
+            JCHIP8_TRACE_INSTANT("DXYN", "core");
+            if (_quirks.display_wait)
+                _vblank_wait = true;
+            break;
+        }
+        if (exit == recompiled_exit::code_written)
+        {
+            _recompiled_verified = false;
+        }
+        else if (exit == recompiled_exit::unknown_pc && executed < max_cycles)
+        {
+            // The interpreter ends its own batch on a draw, and a store it makes may land on translated code
+            uint16 opcode = static_cast<uint16>(memory[pc & MEMORY_MASK] << 8 | memory[(pc + 1) & MEMORY_MASK]);
+            executed = static_cast<uint16>(executed + (this->*_interpret)(1));
+            if ((opcode & 0xF0FF) == 0xF033 || (opcode & 0xF0FF) == 0xF055)
+                _recompiled_verified = false;
+            if ((opcode >> 12) == DRAW_INSTRUCTION)
+                break;
+        }
+    }
+    return executed;
+}
+
+void JChip8::attach_debugger(debugger* dbg) noexcept
+{
+    // Only a debugger with something to check is worth leaving the plain engine for
+    _debugger = (dbg && dbg->active()) ? dbg : nullptr;
+    select_engine(std::make_integer_sequence<uint16, QUIRK_COMBINATIONS * PROBE_COMBINATIONS>{});
+}
+
+bool JChip8::debugger_attached() const noexcept
+{
+    return _debugger != nullptr;
+}
+
+void JChip8::attach_hooks(const chip8_hooks* hooks) noexcept
+{
+    // Only the per-instruction hooks need another engine, so swapping frame hooks in and out every frame is free
+    _hooks = hooks;
+    if ((_hooks && _hooks->per_instruction()) != _instruction_hooks)
+        select_engine(std::make_integer_sequence<uint16, QUIRK_COMBINATIONS * PROBE_COMBINATIONS>{});
+}
+
+const chip8_hooks* JChip8::hooks() const noexcept
+{
+    return _hooks;
+}
+
+bool JChip8::hooks_attached() const noexcept
+{
+    return _hooks != nullptr;
+}
+
+void JChip8::attach_recompiled(const recompiled_program* program) noexcept
+{
+    _recompiled = program;
+    select_engine(std::make_integer_sequence<uint16, QUIRK_COMBINATIONS * PROBE_COMBINATIONS>{});
+}
+
+bool JChip8::recompiled_active() const noexcept
+{
+    return _run == &JChip8::run_recompiled && _recompiled_verified;
+}
+
+void JChip8::enable_history(bool enabled)
+{
+    if (enabled == history_enabled())
+        return;
+
+    _instruction_history = enabled ? std::make_unique<instruction_history>() : nullptr;
+    select_engine(std::make_integer_sequence<uint16, QUIRK_COMBINATIONS * PROBE_COMBINATIONS>{});
+}
+
+bool JChip8::history_enabled() const noexcept
+{
+    return _instruction_history != nullptr;
+}
+
+void JChip8::load_ROM(const char* rom_path, const chip8_quirks& quirks)
+{
+    std::ifstream file(rom_path, std::ios::binary);
+    if (!file) throw std::runtime_error("Could not open file");
+
+    file.seekg(0, std::ios::end);
+    std::streamsize rom_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    if (rom_size > (MEMORY_SIZE - 0x200))
+    {
+        throw std::runtime_error("File is too big to be loaded into memory");
+    }
+
+    std::vector<uint8> rom(static_cast<size_t>(rom_size));
+    file.read(reinterpret_cast<char*>(rom.data()), rom_size);
+    load_ROM(rom.data(), rom.size(), quirks);
+}
+
+void JChip8::load_ROM(const uint8* data, size_t size, const chip8_quirks& quirks)
+{
+    JCHIP8_TRACE_SCOPE("load_ROM", "core");
+    if (size > (MEMORY_SIZE - ROM_START_LOCATION))
+    {
+        throw std::runtime_error("ROM is too big to be loaded into memory");
+    }
+
+    init_state();
+
+    // Pick the interpreter variant once per ROM, rather than testing quirks inside every handler, and a
+    // translation of the ROM when one was compiled in
+    _quirks = quirks;
+    _recompiled = find_recompiled(data, size);
+    select_engine(std::make_integer_sequence<uint16, QUIRK_COMBINATIONS * PROBE_COMBINATIONS>{});
+
+    if (size > 0)
+        memcpy(memory + ROM_START_LOCATION, data, size);
+    _rom_loaded = true;
+
+    if (_hooks && _hooks->on_rom_loaded)
+        _hooks->on_rom_loaded(*this, data, size);
+}
+
+// Writes new code or data into a running machine, for hot reloading a program as it is edited.  Registers,
+// timers and the framebuffer are left alone; only the clone pages the bytes land on are marked as changed.
+void JChip8::patch_memory(uint16 address, const uint8* data, size_t size)
+{
+    if (address >= MEMORY_SIZE || size > static_cast<size_t>(MEMORY_SIZE - address))
+        throw std::out_of_range("Patch runs past the end of memory");
+    if (size == 0)
+        return;
+
+    memcpy(memory + address, data, size);
+    _recompiled_verified = false;
+    uint32 first_page = address / CLONE_PAGE_SIZE;
+    uint32 last_page = static_cast<uint32>((address + size - 1) / CLONE_PAGE_SIZE);
+    _dirty_pages |= ((2u << last_page) - 1) & ~((1u << first_page) - 1);
+}
+
+void JChip8::reset_draw_flag() { _draw_flag = false; }
+
+void JChip8::capture_state(machine_state& out) const noexcept
+{
+    // Zero the whole struct first so padding is deterministic, which keeps XOR deltas of it small
+    memset(&out, 0, sizeof(out));
+    out.cycles = _cycles;
+    out.rng_state = _rng.state();
+    memcpy(out.memory, memory, sizeof(memory));
+    memcpy(out.graphics, graphics, sizeof(graphics));
+    memcpy(out.stack, stack, sizeof(stack));
+    memcpy(out.V, V, sizeof(V));
+    out.pc = pc;
+    out.sp = sp;
+    out.I = I;
+    out.keys = keypad;
+    out.delay_timer = delay_timer;
+    out.sound_timer = sound_timer;
+    out.draw_flag = _draw_flag;
+    out.key_wait_pressed = _key_wait_pressed;
+    out.key_wait_key = _key_wait_key;
+    memcpy(out.audio_pattern, _audio_pattern, sizeof(_audio_pattern));
+    out.audio_pitch = _audio_pitch;
+    out.audio_pattern_loaded = _audio_pattern_loaded;
+    out.vblank_wait = _vblank_wait;
+    out.sound_playing = _sound_playing;
+    out.timer_carry = _timer_carry;
+    out.next_timer_cycle = _next_timer_cycle;
+}
+
+void JChip8::seed_rng(uint32 seed) noexcept
+{
+    _rng.seed(seed);
+}
+
+void JChip8::queue_input(const input_event& event) noexcept
+{
+    // A full queue can only happen while paused, so the oldest change simply takes effect now
+    if (_input_count == INPUT_QUEUE_SIZE)
+    {
+        const input_event& oldest = _input_queue[_input_head];
+        set_key(oldest.key, oldest.pressed);
+        _input_head = (_input_head + 1) % INPUT_QUEUE_SIZE;
+        --_input_count;
+    }
+
+    // Events stay in order even if a caller stamps one earlier than the last
+    input_event queued = event;
+    if (_input_count > 0)
+        queued.cycle = std::max(queued.cycle, _input_queue[(_input_head + _input_count - 1) % INPUT_QUEUE_SIZE].cycle);
+
+    _input_queue[(_input_head + _input_count) % INPUT_QUEUE_SIZE] = queued;
+    ++_input_count;
+    if (!_inputs_held)
+        _next_input_cycle = _input_queue[_input_head].cycle;
+    _next_event_cycle = std::min(_next_input_cycle, _next_timer_cycle);
+}
+
+void JChip8::clear_input_queue() noexcept
+{
+    _input_head = 0;
+    _input_count = 0;
+    _next_input_cycle = UINT64_MAX;
+    _next_event_cycle = _next_timer_cycle;
+}
+
+void JChip8::hold_inputs(bool held) noexcept
+{
+    // Held events stay queued with their cycles untouched, for frames that will be thrown away
+    _inputs_held = held;
+    _next_input_cycle = (!held && _input_count > 0) ? _input_queue[_input_head].cycle : UINT64_MAX;
+    _next_event_cycle = std::min(_next_input_cycle, _next_timer_cycle);
+}
+
+uint32 JChip8::pending_inputs() const noexcept
+{
+    return _input_count;
+}
+
+void JChip8::apply_inputs(uint64 cycle) noexcept
+{
+    while (_input_count > 0 && _input_queue[_input_head].cycle <= cycle)
+    {
+        const input_event& event = _input_queue[_input_head];
+        set_key(event.key, event.pressed);
+        _input_head = (_input_head + 1) % INPUT_QUEUE_SIZE;
+        --_input_count;
+    }
+
+    _next_input_cycle = _input_count > 0 ? _input_queue[_input_head].cycle : UINT64_MAX;
+}
+
+void JChip8::service_events(uint64 cycle)
+{
+    if (cycle >= _next_input_cycle)
+        apply_inputs(cycle);
+    while (cycle >= _next_timer_cycle)
+    {
+        vblank();
+        schedule_timer();
+    }
+    _next_event_cycle = std::min(_next_input_cycle, _next_timer_cycle);
+}
+
+void JChip8::schedule_timer() noexcept
+{
+    // ips/60 cycles to a tick, with the remainder carried: at 700 ips the ticks come 11, 12 and 12 cycles apart
+    uint32 rate = std::max<uint32>(ips, 1);
+    _next_timer_cycle += rate / 60;
+    _timer_carry += static_cast<uint8>(rate % 60);
+    if (_timer_carry >= 60)
+    {
+        _timer_carry -= 60;
+        ++_next_timer_cycle;
+    }
+}
+
+void JChip8::resume_timer(uint64 next_cycle, uint8 carry) noexcept
+{
+    // A state saved on the host clock has no tick pending, so the cycle clock starts afresh from now
+    if (_timer_clock == timer_clock::host)
+    {
+        _next_timer_cycle = UINT64_MAX;
+        _timer_carry = 0;
+    }
+    else if (next_cycle == UINT64_MAX)
+    {
+        _next_timer_cycle = _cycles;
+        _timer_carry = 0;
+        schedule_timer();
+    }
+    else
+    {
+        _next_timer_cycle = next_cycle;
+        _timer_carry = carry;
+    }
+    _next_event_cycle = std::min(_next_input_cycle, _next_timer_cycle);
+}
+
+void JChip8::set_timer_clock(timer_clock clock) noexcept
+{
+    if (clock == _timer_clock)
+        return;
+
+    _timer_clock = clock;
+    resume_timer(UINT64_MAX, 0);
+}
+
+timer_clock JChip8::active_timer_clock() const noexcept
+{
+    return _timer_clock;
+}
+
+uint64 JChip8::next_timer_cycle() const noexcept
+{
+    return _next_timer_cycle;
+}
+
+bool JChip8::waiting_for_vblank() const noexcept
+{
+    return _vblank_wait;
+}
+
+void JChip8::rebase_inputs(uint64 cycles) noexcept
+{
+    // Queued input is stamped relative to now, so it moves with the cycle counter.  Held input was
+    // stamped against the state being restored and is left alone.
+    for (uint32 i = 0; i < _input_count && !_inputs_held; ++i)
+    {
+        input_event& event = _input_queue[(_input_head + i) % INPUT_QUEUE_SIZE];
+        event.cycle = cycles + (event.cycle > _cycles ? event.cycle - _cycles : 0);
+    }
+    if (_input_count > 0 && !_inputs_held)
+        _next_input_cycle = _input_queue[_input_head].cycle;
+    _next_event_cycle = std::min(_next_input_cycle, _next_timer_cycle);
+}
+
+void JChip8::restore_state(const machine_state& in) noexcept
+{
+    rebase_inputs(in.cycles);
+    _dirty_pages = CLONE_ALL_PAGES;
+    _recompiled_verified = false;
+
+    _cycles = in.cycles;
+    _rng.seed(in.rng_state);
+    memcpy(memory, in.memory, sizeof(memory));
+    memcpy(graphics, in.graphics, sizeof(graphics));
+    memcpy(stack, in.stack, sizeof(stack));
+    memcpy(V, in.V, sizeof(V));
+    pc = in.pc;
+    sp = in.sp;
+    I = in.I;
+    keypad = in.keys;
+    delay_timer = in.delay_timer;
+    sound_timer = in.sound_timer;
+    _draw_flag = true;
+    _key_wait_pressed = in.key_wait_pressed;
+    _key_wait_key = in.key_wait_key;
+    memcpy(_audio_pattern, in.audio_pattern, sizeof(_audio_pattern));
+    _audio_pitch = in.audio_pitch;
+    _audio_pattern_loaded = in.audio_pattern_loaded;
+    _vblank_wait = in.vblank_wait;
+    _sound_playing = in.sound_playing;
+    resume_timer(in.next_timer_cycle, in.timer_carry);
+}
+
+uint8* JChip8::clone_source(uint32 page) noexcept
+{
+    if (page < CLONE_MEMORY_PAGES)
+        return memory + page * CLONE_PAGE_SIZE;
+    return reinterpret_cast<uint8*>(graphics) + (page - CLONE_MEMORY_PAGES) * CLONE_PAGE_SIZE;
+}
+
+void JChip8::capture_clone(machine_clone& out)
+{
+    if (!_clone_pages)
+        _clone_pages = std::make_unique<clone_page_table>();
+    clone_page_table& matched = *_clone_pages;
+
+    // Only pages written since this machine last matched a clone need copying, the rest are shared
+    for (uint32 page = 0; page < CLONE_PAGES; ++page)
+    {
+        if (matched[page] && !(_dirty_pages & (1u << page)))
+            continue;
+
+        auto copy = std::make_shared<clone_page>();
+        memcpy(copy->data(), clone_source(page), CLONE_PAGE_SIZE);
+        matched[page] = std::move(copy);
+    }
+    _dirty_pages = 0;
+
+    for (uint32 page = 0; page < CLONE_PAGES; ++page)
+        out.pages[page] = matched[page];
+    out.cycles = _cycles;
+    out.rng_state = _rng.state();
+    memcpy(out.stack, stack, sizeof(stack));
+    memcpy(out.V, V, sizeof(V));
+    out.pc = pc;
+    out.sp = sp;
+    out.I = I;
+    out.keys = keypad;
+    out.delay_timer = delay_timer;
+    out.sound_timer = sound_timer;
+    out.draw_flag = _draw_flag;
+    out.key_wait_pressed = _key_wait_pressed;
+    out.key_wait_key = _key_wait_key;
+    memcpy(out.audio_pattern, _audio_pattern, sizeof(_audio_pattern));
+    out.audio_pitch = _audio_pitch;
+    out.audio_pattern_loaded = _audio_pattern_loaded;
+    out.vblank_wait = _vblank_wait;
+    out.sound_playing = _sound_playing;
+    out.timer_carry = _timer_carry;
+    out.next_timer_cycle = _next_timer_cycle;
+}
+
+void JChip8::restore_clone(const machine_clone& in)
+{
+    if (!_clone_pages)
+        _clone_pages = std::make_unique<clone_page_table>();
+    clone_page_table& matched = *_clone_pages;
+    rebase_inputs(in.cycles);
+
+    // A page this machine hasn't written since it matched the same clone page is already correct
+    for (uint32 page = 0; page < CLONE_PAGES; ++page)
+    {
+        if (!in.pages[page] || (matched[page] == in.pages[page] && !(_dirty_pages & (1u << page))))
+            continue;
+
+        memcpy(clone_source(page), in.pages[page]->data(), CLONE_PAGE_SIZE);
+        matched[page] = in.pages[page];
+        _dirty_pages &= ~(1u << page);
+        if (page < CLONE_MEMORY_PAGES)
+            _recompiled_verified = false;
+    }
+
+    _cycles = in.cycles;
+    _rng.seed(in.rng_state);
+    memcpy(stack, in.stack, sizeof(stack));
+    memcpy(V, in.V, sizeof(V));
+    pc = in.pc;
+    sp = in.sp;
+    I = in.I;
+    keypad = in.keys;
+    delay_timer = in.delay_timer;
+    sound_timer = in.sound_timer;
+    _draw_flag = true;
+    _key_wait_pressed = in.key_wait_pressed;
+    _key_wait_key = in.key_wait_key;
+    memcpy(_audio_pattern, in.audio_pattern, sizeof(_audio_pattern));
+    _audio_pitch = in.audio_pitch;
+    _audio_pattern_loaded = in.audio_pattern_loaded;
+    _vblank_wait = in.vblank_wait;
+    _sound_playing = in.sound_playing;
+    resume_timer(in.next_timer_cycle, in.timer_carry);
+}
+
+uint8 machine_clone::read(uint16 address) const noexcept
+{
+    uint16 masked = address & MEMORY_MASK;
+    const std::shared_ptr<const clone_page>& page = pages[masked / CLONE_PAGE_SIZE];
+    return page ? (*page)[masked % CLONE_PAGE_SIZE] : 0;
+}
+
+bool machine_clone::pixel(uint32 x, uint32 y) const noexcept
+{
+    uint32 index = (y % GRAPHICS_HEIGHT) * GRAPHICS_WIDTH + (x % GRAPHICS_WIDTH);
+    const std::shared_ptr<const clone_page>& page = pages[CLONE_MEMORY_PAGES + index / CLONE_PAGE_SIZE];
+    return page && (*page)[index % CLONE_PAGE_SIZE];
+}
+
+instruction JChip8::current_instruction() const noexcept
+{
+    // Decoded on request rather than stored by every fetch, which kept a debugging aid in the hot loop
+    return fetch_instruction();
+}
+
+bool JChip8::key_down(uint8 key) const noexcept
+{
+    return (keypad >> (key & KEY_MASK)) & 1;
+}
+
+void JChip8::set_key(uint8 key, bool pressed) noexcept
+{
+    uint16 bit = static_cast<uint16>(1u << (key & KEY_MASK));
+    keypad = static_cast<uint16>(pressed ? keypad | bit : keypad & ~bit);
+}
+
+void JChip8::init_state()
+{
+    memset(memory, 0, sizeof(memory));
+    memset(V, 0, sizeof(V));
+    pc = ROM_START_LOCATION;
+    memset(graphics, 0, sizeof(graphics));
+    memset(stack, 0, sizeof(stack));
+    sp = 0;
+    delay_timer = 0;
+    sound_timer = 0;
+    I = 0;
+    keypad = 0;
+    state = emulator_state::running;
+    _cycles = 0;
+    _sound_playing = false;
+    _key_wait_pressed = false;
+    _key_wait_key = 0xFF;
+    memset(_audio_pattern, 0, sizeof(_audio_pattern));
+    _audio_pitch = 64;
+    _audio_pattern_loaded = false;
+    _vblank_wait = false;
+    clear_input_queue();
+    resume_timer(UINT64_MAX, 0);
+    _dirty_pages = CLONE_ALL_PAGES;
+    _recompiled_verified = false;
+
+    load_fontset();
+    if (_instruction_history)
+        _instruction_history->clear();
+}
+
+void JChip8::load_fontset()
+{
+    static uint8 fontset[] =
+    {
+        0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+        0x20, 0x60, 0x20, 0x20, 0x70, // 1
+        0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+        0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+        0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+        0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+        0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+        0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+        0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+        0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+        0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+        0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+        0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+        0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+        0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+        0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+    };
+
+    // Load the font into the beginning of memory
+    memcpy(&memory[0], fontset, 80);
+}
+
+void JChip8::update_timers()
+{
+    // Once per host frame.  On the cycle clock the frame's vblank has already happened as it ran; on the host
+    // clock this is the vblank itself.
+    if (_timer_clock == timer_clock::host)
+        vblank();
+}
+
+void JChip8::vblank()
+{
+    // The 60hz interrupt.  The beeper follows the sound timer from one to the next, so its edges land here.
+    JCHIP8_TRACE_INSTANT("timer tick", "core");
+    if (sound_timer > 0)
+    {
+        bool started = !_sound_playing;
+        if (started) JCHIP8_TRACE_INSTANT("sound start", "core");
+        _sound_playing = true;
+        if (started && _hooks && _hooks->on_sound_start)
+            _hooks->on_sound_start(*this);
+    }
+    else
+    {
+        if (_sound_playing) JCHIP8_TRACE_INSTANT("sound stop", "core");
+        _sound_playing = false;
+    }
+
+    tick_timers();
+    _vblank_wait = false;
+
+    if (_hooks && _hooks->on_frame)
+        _hooks->on_frame(*this);
+}
+
+bool JChip8::sound_active() const noexcept
+{
+    // Set at every vblank, so a frontend can start and stop its beeper once per frame
+    return _sound_playing;
+}
+
+void JChip8::tick_timers() noexcept
+{
+    if (delay_timer > 0)
+        --delay_timer;
+    if (sound_timer > 0)
+        --sound_timer;
+}
+
+void JChip8::unload_ROM()
+{
+    _rom_loaded = false;
+    init_state();
+}
+
+void JChip8::clear_graphics_buffer()
+{
+    memset(graphics, false, sizeof(graphics));
+    _draw_flag = true;
+    _dirty_pages |= CLONE_FRAMEBUFFER_MASK;
+}
+
+uint8 JChip8::generate_random_number()
+{
+    // The top bits of a xorshift generator are its best mixed
+    return static_cast<uint8>(_rng() >> 24);
+}
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
@@ -0,0 +1,248 @@
+#include "jchip8_api.h"
+#include "chip8_quirks.h"
+#include "jchip8.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+static_assert(sizeof(bool) == 1, "The framebuffer is handed out as bytes");
+static_assert(std::is_standard_layout_v<machine_state>, "State blobs are checked field by field with offsetof");
+static_assert(JCHIP8_QUIRK_SHIFT_USES_VY == QUIRK_SHIFT_USES_VY && JCHIP8_QUIRK_LOAD_STORE_INCREMENTS_I == QUIRK_LOAD_STORE_INCREMENTS_I
+    && JCHIP8_QUIRK_LOGIC_RESETS_VF == QUIRK_LOGIC_RESETS_VF && JCHIP8_QUIRK_CLIP_SPRITES == QUIRK_CLIP_SPRITES
+    && JCHIP8_QUIRK_DISPLAY_WAIT == QUIRK_DISPLAY_WAIT, "Quirk bits out of sync");
+
+struct jchip8_core
+{
+    JChip8 chip8;
+
+    explicit jchip8_core(uint16 ips) : chip8(ips) {}
+};
+
+namespace
+{
+    constexpr uint32 STATE_MAGIC = 0x5453384A;    // "J8ST"
+
+    // Guards against loading a blob from another build, where machine_state may be laid out differently
+    struct state_header
+    {
+        uint32 magic;
+        uint32 size;
+    };
+
+    // Reading a bool whose byte is neither 0 nor 1 is undefined, so a blob's bool fields are squashed to 0 or 1
+    // before it becomes a machine_state
+    void normalise_bools(uint8* bytes, size_t offset, size_t count) noexcept
+    {
+        for (size_t i = offset; i < offset + count; ++i)
+            bytes[i] = bytes[i] != 0;
+    }
+}
+
+jchip8_core* jchip8_create(uint16_t instructions_per_second)
+{
+    jchip8_core* core = new (std::nothrow) jchip8_core(instructions_per_second);
+    if (core)
+        core->chip8.state = emulator_state::running;
+    return core;
+}
+
+void jchip8_destroy(jchip8_core* core)
+{
+    delete core;
+}
+
+jchip8_result jchip8_load_rom(jchip8_core* core, const uint8_t* data, size_t size, uint32_t quirks)
+{
+    if (!core || (!data && size > 0))
+        return JCHIP8_ERROR_ARGUMENT;
+    if (size > MEMORY_SIZE - ROM_START_LOCATION)
+        return JCHIP8_ERROR_ROM_SIZE;
+
+    chip8_quirks selected;
+    selected.shift_uses_vy = (quirks & JCHIP8_QUIRK_SHIFT_USES_VY) != 0;
+    selected.load_store_increments_i = (quirks & JCHIP8_QUIRK_LOAD_STORE_INCREMENTS_I) != 0;
+    selected.logic_resets_vf = (quirks & JCHIP8_QUIRK_LOGIC_RESETS_VF) != 0;
+    selected.clip_sprites = (quirks & JCHIP8_QUIRK_CLIP_SPRITES) != 0;
+    selected.display_wait = (quirks & JCHIP8_QUIRK_DISPLAY_WAIT) != 0;
+
+    try
+    {
+        core->chip8.load_ROM(data, size, selected);
+        core->chip8.state = emulator_state::running;
+        return JCHIP8_OK;
+    }
+    catch (const std::exception&)
+    {
+        return JCHIP8_ERROR_INTERNAL;
+    }
+}
+
+jchip8_result jchip8_patch_memory(jchip8_core* core, uint16_t address, const uint8_t* data, size_t size)
+{
+    if (!core || (!data && size > 0) || address >= MEMORY_SIZE || size > static_cast<size_t>(MEMORY_SIZE - address))
+        return JCHIP8_ERROR_ARGUMENT;
+    if (!core->chip8.rom_loaded())
+        return JCHIP8_ERROR_STATE;
+
+    core->chip8.patch_memory(address, data, size);
+    return JCHIP8_OK;
+}
+
+jchip8_result jchip8_seed(jchip8_core* core, uint32_t seed)
+{
+    if (!core)
+        return JCHIP8_ERROR_ARGUMENT;
+
+    core->chip8.seed_rng(seed);
+    return JCHIP8_OK;
+}
+
+uint32_t jchip8_run(jchip8_core* core, uint32_t cycles)
+{
+    if (!core || !core->chip8.rom_loaded())
+        return 0;
+
+    // The interpreter stops its batches at every draw, so keep going until the count is met
+    uint32 executed = 0;
+    while (executed < cycles)
+    {
+        uint16 batch = static_cast<uint16>(std::min<uint32>(cycles - executed, std::numeric_limits<uint16>::max()));
+        uint16 ran = core->chip8.run(batch);
+        if (ran == 0)
+            break;
+        executed += ran;
+    }
+    return executed;
+}
+
+uint64_t jchip8_run_until(jchip8_core* core, uint64_t cycle)
+{
+    if (!core || !core->chip8.rom_loaded())
+        return 0;
+
+    return core->chip8.run_until(cycle);
+}
+
+uint32_t jchip8_run_frame(jchip8_core* core)
+{
+    if (!core || !core->chip8.rom_loaded())
+        return 0;
+
+    return core->chip8.run_frame();
+}
+
+jchip8_result jchip8_update_timers(jchip8_core* core)
+{
+    if (!core)
+        return JCHIP8_ERROR_ARGUMENT;
+
+    try
+    {
+        core->chip8.update_timers();
+        return JCHIP8_OK;
+    }
+    catch (const std::exception&)
+    {
+        return JCHIP8_ERROR_INTERNAL;
+    }
+}
+
+int jchip8_sound_active(const jchip8_core* core)
+{
+    return core && core->chip8.sound_active() ? 1 : 0;
+}
+
+uint64_t jchip8_cycles(const jchip8_core* core)
+{
+    return core ? core->chip8.cycles() : 0;
+}
+
+jchip8_result jchip8_set_key(jchip8_core* core, uint8_t key, int pressed)
+{
+    if (!core || key > 0xF)
+        return JCHIP8_ERROR_ARGUMENT;
+
+    core->chip8.set_key(key, pressed != 0);
+    return JCHIP8_OK;
+}
+
+jchip8_result jchip8_set_keys(jchip8_core* core, uint16_t keys)
+{
+    if (!core)
+        return JCHIP8_ERROR_ARGUMENT;
+
+    core->chip8.keypad = keys;
+    return JCHIP8_OK;
+}
+
+const uint8_t* jchip8_framebuffer(const jchip8_core* core)
+{
+    return core ? reinterpret_cast<const uint8_t*>(core->chip8.graphics) : nullptr;
+}
+
+size_t jchip8_state_size(void)
+{
+    return sizeof(state_header) + sizeof(machine_state);
+}
+
+jchip8_result jchip8_save_state(const jchip8_core* core, void* buffer, size_t size)
+{
+    if (!core || !buffer || size < jchip8_state_size())
+        return JCHIP8_ERROR_ARGUMENT;
+
+    state_header header{ STATE_MAGIC, static_cast<uint32>(sizeof(machine_state)) };
+    machine_state state;
+    core->chip8.capture_state(state);
+
+    uint8* out = static_cast<uint8*>(buffer);
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), &state, sizeof(state));
+    return JCHIP8_OK;
+}
+
+jchip8_result jchip8_load_state(jchip8_core* core, const void* buffer, size_t size)
+{
+    if (!core || !buffer || size < jchip8_state_size())
+        return JCHIP8_ERROR_ARGUMENT;
+
+    const uint8* in = static_cast<const uint8*>(buffer);
+    state_header header;
+    std::memcpy(&header, in, sizeof(header));
+    if (header.magic != STATE_MAGIC || header.size != sizeof(machine_state))
+        return JCHIP8_ERROR_STATE;
+
+    // The interpreter masks every index it reads from the state, so past the checks below even a corrupt blob
+    // is safe to run
+    uint8 bytes[sizeof(machine_state)];
+    std::memcpy(bytes, in + sizeof(header), sizeof(bytes));
+    normalise_bools(bytes, offsetof(machine_state, graphics), sizeof(machine_state::graphics));
+    normalise_bools(bytes, offsetof(machine_state, draw_flag), sizeof(bool));
+    normalise_bools(bytes, offsetof(machine_state, key_wait_pressed), sizeof(bool));
+    normalise_bools(bytes, offsetof(machine_state, audio_pattern_loaded), sizeof(bool));
+    normalise_bools(bytes, offsetof(machine_state, vblank_wait), sizeof(bool));
+    normalise_bools(bytes, offsetof(machine_state, sound_playing), sizeof(bool));
+
+    machine_state state;
+    std::memcpy(&state, bytes, sizeof(state));
+
+    // A pending vblank far from the cycle counter would have the next run catch up on it one tick at a time,
+    // effectively for ever, so a saved tick has to lie within one tick of where the machine stopped
+    uint64 tick = std::max<uint32>(core->chip8.ips, 1) / 60 + 1;
+    if (state.timer_carry >= 60)
+        return JCHIP8_ERROR_STATE;
+    if (state.next_timer_cycle != UINT64_MAX)
+    {
+        uint64 distance = state.next_timer_cycle >= state.cycles ? state.next_timer_cycle - state.cycles
+                                                                 : state.cycles - state.next_timer_cycle;
+        if (distance > tick)
+            return JCHIP8_ERROR_STATE;
+    }
+
+    core->chip8.restore_state(state);
+    return JCHIP8_OK;
+}
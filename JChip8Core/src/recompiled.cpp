@@ -0,0 +1,40 @@
+#include "recompiled.h"
+#include "jchip8.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // A function local, so generated units can register from their static initialisers in any order
+    std::vector<const recompiled_program*>& registry()
+    {
+        static std::vector<const recompiled_program*> programs;
+        return programs;
+    }
+}
+
+bool recompiled_program::matches(const uint8* memory) const noexcept
+{
+    for (uint32 i = 0; i < code_ranges; ++i)
+    {
+        size_t length = static_cast<size_t>(code[i].end - code[i].start);
+        if (std::memcmp(memory + code[i].start, rom + (code[i].start - ROM_START_LOCATION), length) != 0)
+            return false;
+    }
+    return true;
+}
+
+void register_recompiled(const recompiled_program& program)
+{
+    registry().push_back(&program);
+}
+
+const recompiled_program* find_recompiled(const uint8* rom, size_t size) noexcept
+{
+    for (const recompiled_program* program : registry())
+    {
+        if (program->rom_size == size && (size == 0 || std::memcmp(program->rom, rom, size) == 0))
+            return program;
+    }
+    return nullptr;
+}
@@ -0,0 +1,243 @@
+#include "rewind_buffer.h"
+#include "jchip8.h"
+#include "typedefs.h"
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    void put_varint(std::vector<uint8>& out, size_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8>(value));
+    }
+
+    size_t get_varint(const std::vector<uint8>& in, size_t& pos)
+    {
+        size_t value = 0;
+        int shift = 0;
+        while (pos < in.size())
+        {
+            uint8 byte = in[pos++];
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+            shift += 7;
+        }
+        throw std::runtime_error("Truncated rewind frame");
+    }
+}
+
+void encode_xor(const uint8* data, const uint8* reference, size_t size, std::vector<uint8>& out)
+{
+    out.clear();
+    size_t i = 0;
+    while (i < size)
+    {
+        // Skip eight unchanged bytes at a time; most of a delta is long zero runs
+        size_t zero_start = i;
+        while (i + 8 <= size)
+        {
+            uint64 a;
+            uint64 b;
+            memcpy(&a, data + i, 8);
+            memcpy(&b, reference ? reference + i : data + i, 8);
+            if (reference ? (a != b) : (a != 0))
+                break;
+            i += 8;
+        }
+        while (i < size && (data[i] ^ (reference ? reference[i] : 0)) == 0)
+            ++i;
+        put_varint(out, i - zero_start);
+
+        // A literal run ends at the first pair of unchanged bytes, so isolated zeroes stay inline
+        size_t literal_start = i;
+        while (i < size)
+        {
+            uint8 value = data[i] ^ (reference ? reference[i] : 0);
+            uint8 next = (i + 1 < size) ? static_cast<uint8>(data[i + 1] ^ (reference ? reference[i + 1] : 0)) : 0;
+            if (value == 0 && next == 0)
+                break;
+            ++i;
+        }
+        put_varint(out, i - literal_start);
+        for (size_t j = literal_start; j < i; ++j)
+            out.push_back(data[j] ^ (reference ? reference[j] : 0));
+    }
+}
+
+void decode_xor(const std::vector<uint8>& encoded, const uint8* reference, uint8* out, size_t size)
+{
+    if (reference)
+        memcpy(out, reference, size);
+    else
+        memset(out, 0, size);
+
+    size_t pos = 0;
+    size_t i = 0;
+    while (pos < encoded.size())
+    {
+        i += get_varint(encoded, pos);
+        size_t literals = get_varint(encoded, pos);
+        if (i + literals > size || pos + literals > encoded.size())
+            throw std::runtime_error("Corrupt rewind frame");
+
+        for (size_t j = 0; j < literals; ++j)
+            out[i++] ^= encoded[pos++];
+    }
+}
+
+rewind_buffer::rewind_buffer(uint32 max_frames, uint64 max_bytes)
+    : _frames{}
+    , _spare_buffers{}
+    , _current{ std::make_unique<machine_state>() }
+    , _keyframe{ std::make_unique<machine_state>() }
+    , _max_frames{ max_frames }
+    , _max_bytes{ max_bytes }
+    , _bytes{ 0 }
+    , _since_keyframe{ KEYFRAME_INTERVAL }
+    , _captures{ 0 }
+    , _total_capture_us{ 0.0 }
+    , _last_capture_us{ 0.0 }
+    , _total_captured_bytes{ 0 }
+{
+
+}
+
+void rewind_buffer::capture(const JChip8& chip8)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    chip8.capture_state(*_current);
+    const uint8* current = reinterpret_cast<const uint8*>(_current.get());
+
+    frame entry{ take_buffer(), _since_keyframe >= KEYFRAME_INTERVAL };
+    if (entry.keyframe)
+    {
+        encode_xor(current, nullptr, sizeof(machine_state), entry.data);
+        memcpy(_keyframe.get(), _current.get(), sizeof(machine_state));
+        _since_keyframe = 0;
+    }
+    else
+    {
+        encode_xor(current, reinterpret_cast<const uint8*>(_keyframe.get()), sizeof(machine_state), entry.data);
+    }
+    ++_since_keyframe;
+
+    _bytes += entry.data.size();
+    _total_captured_bytes += entry.data.size();
+    _frames.push_back(std::move(entry));
+
+    while (_frames.size() > 1 && (_frames.size() > _max_frames || _bytes > _max_bytes))
+        evict_oldest_group();
+
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    _last_capture_us = elapsed.count();
+    _total_capture_us += _last_capture_us;
+    ++_captures;
+}
+
+bool rewind_buffer::step_back(JChip8& chip8)
+{
+    // The newest frame is the one currently on screen, so rewinding restores the frame before it
+    if (_frames.size() < 2)
+        return false;
+
+    frame& newest = _frames.back();
+    bool was_keyframe = newest.keyframe;
+    _bytes -= newest.data.size();
+    _spare_buffers.push_back(std::move(newest.data));
+    _frames.pop_back();
+
+    if (was_keyframe)
+        decode_keyframe_for_newest();
+
+    const frame& target = _frames.back();
+    if (target.keyframe)
+        memcpy(_current.get(), _keyframe.get(), sizeof(machine_state));
+    else
+        decode_xor(target.data, reinterpret_cast<const uint8*>(_keyframe.get()), reinterpret_cast<uint8*>(_current.get()), sizeof(machine_state));
+
+    chip8.restore_state(*_current);
+
+    // Count how far the restored frame is from its keyframe, so capturing resumes the same group
+    _since_keyframe = 0;
+    for (auto it = _frames.rbegin(); it != _frames.rend(); ++it)
+    {
+        ++_since_keyframe;
+        if (it->keyframe)
+            break;
+    }
+    return true;
+}
+
+bool rewind_buffer::empty() const noexcept
+{
+    return _frames.empty();
+}
+
+rewind_stats rewind_buffer::stats() const noexcept
+{
+    return rewind_stats
+    {
+        static_cast<uint32>(_frames.size()),
+        _bytes,
+        _last_capture_us,
+        _captures ? _total_capture_us / static_cast<double>(_captures) : 0.0,
+        _captures ? static_cast<double>(_total_captured_bytes) / static_cast<double>(_captures) : 0.0,
+    };
+}
+
+void rewind_buffer::clear()
+{
+    while (!_frames.empty())
+    {
+        _spare_buffers.push_back(std::move(_frames.back().data));
+        _frames.pop_back();
+    }
+    _bytes = 0;
+    _since_keyframe = KEYFRAME_INTERVAL;
+}
+
+void rewind_buffer::evict_oldest_group()
+{
+    // A keyframe can only go together with every delta that depends on it
+    do
+    {
+        _bytes -= _frames.front().data.size();
+        _spare_buffers.push_back(std::move(_frames.front().data));
+        _frames.pop_front();
+    } while (!_frames.empty() && !_frames.front().keyframe);
+
+    if (_frames.empty())
+        _since_keyframe = KEYFRAME_INTERVAL;
+}
+
+std::vector<uint8> rewind_buffer::take_buffer()
+{
+    // Reusing evicted buffers keeps steady state capturing free of allocations
+    if (_spare_buffers.empty())
+        return std::vector<uint8>{};
+
+    std::vector<uint8> buffer = std::move(_spare_buffers.back());
+    _spare_buffers.pop_back();
+    return buffer;
+}
+
+void rewind_buffer::decode_keyframe_for_newest()
+{
+    for (auto it = _frames.rbegin(); it != _frames.rend(); ++it)
+    {
+        if (it->keyframe)
+        {
+            decode_xor(it->data, nullptr, reinterpret_cast<uint8*>(_keyframe.get()), sizeof(machine_state));
+            return;
+        }
+    }
+}
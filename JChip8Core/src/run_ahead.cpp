@@ -0,0 +1,73 @@
+#include "run_ahead.h"
+#include "jchip8.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    double elapsed_us(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+run_ahead::run_ahead()
+    : _saved(std::make_unique<machine_state>())
+    , _active(false)
+    , _frames(0)
+    , _elapsed_us(0.0)
+    , _runs(0)
+    , _total_us(0.0)
+    , _last_us(0.0)
+{
+}
+
+void run_ahead::advance(JChip8& chip8, uint32 frames)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    chip8.capture_state(*_saved);
+    chip8.hold_inputs(true);
+    _active = true;
+    _frames = std::min(frames, MAX_FRAMES);
+
+    // The same frame the main loop runs.  The beeper state it moves is part of the saved state, so restore puts
+    // sound back on the real timeline too, and hooks are detached so plugins never see a frame that gets undone.
+    const chip8_hooks* hooks = chip8.hooks();
+    chip8.attach_hooks(nullptr);
+    for (uint32 frame = 0; frame < _frames && chip8.state == emulator_state::running; ++frame)
+        chip8.run_frame();
+    chip8.attach_hooks(hooks);
+
+    _elapsed_us = elapsed_us(start);
+}
+
+void run_ahead::restore(JChip8& chip8)
+{
+    if (!_active)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    chip8.restore_state(*_saved);
+    chip8.hold_inputs(false);
+    _active = false;
+
+    _last_us = _elapsed_us + elapsed_us(start);
+    _total_us += _last_us;
+    ++_runs;
+}
+
+bool run_ahead::active() const noexcept
+{
+    return _active;
+}
+
+run_ahead_stats run_ahead::stats() const noexcept
+{
+    run_ahead_stats out{};
+    out.frames = _frames;
+    out.last_us = _last_us;
+    out.avg_us = _runs ? _total_us / static_cast<double>(_runs) : 0.0;
+    return out;
+}
@@ -0,0 +1,117 @@
+#include "trace_recorder.h"
+#include "typedefs.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct trace_event
+    {
+        const char* name;
+        const char* category;
+        uint64 start_ns;
+        uint64 duration_ns;
+        char phase;
+    };
+
+    std::vector<trace_event> s_events;
+    uint64 s_recorded = 0;
+    std::chrono::steady_clock::time_point s_epoch;
+
+    void push(const trace_event& event) noexcept
+    {
+        s_events[s_recorded % s_events.size()] = event;
+        ++s_recorded;
+    }
+
+    void write_escaped(std::ofstream& file, const char* text)
+    {
+        for (; *text; ++text)
+        {
+            if (*text == '"' || *text == '\\') file << '\\';
+            file << *text;
+        }
+    }
+}
+
+bool trace::s_enabled = false;
+
+void trace::start(uint32 capacity)
+{
+    s_events.assign(capacity, trace_event{});
+    s_recorded = 0;
+    s_epoch = std::chrono::steady_clock::now();
+    s_enabled = true;
+}
+
+void trace::stop()
+{
+    s_enabled = false;
+}
+
+uint64 trace::now_ns() noexcept
+{
+    return static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count());
+}
+
+void trace::complete(const char* name, const char* category, uint64 start_ns, uint64 end_ns) noexcept
+{
+    push(trace_event{ name, category, start_ns, end_ns - start_ns, 'X' });
+}
+
+void trace::instant(const char* name, const char* category) noexcept
+{
+    push(trace_event{ name, category, now_ns(), 0, 'i' });
+}
+
+void trace::write_json(const std::string& filepath)
+{
+    std::ofstream file(filepath);
+    if (!file)
+    {
+        throw std::runtime_error("Could not open trace file for writing");
+    }
+
+    // Once the ring has wrapped, the oldest surviving event sits at the write position
+    uint64 count = s_recorded < s_events.size() ? s_recorded : s_events.size();
+    uint64 first = s_recorded - count;
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << std::fixed << std::setprecision(3);
+    for (uint64 i = 0; i < count; ++i)
+    {
+        const trace_event& event = s_events[(first + i) % s_events.size()];
+
+        file << (i == 0 ? "" : ",\n") << "{\"name\":\"";
+        write_escaped(file, event.name);
+        file << "\",\"cat\":\"";
+        write_escaped(file, event.category);
+        file << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":1,\"ts\":" << static_cast<double>(event.start_ns) / 1000.0;
+
+        if (event.phase == 'X')
+            file << ",\"dur\":" << static_cast<double>(event.duration_ns) / 1000.0;
+        else
+            file << ",\"s\":\"t\"";
+
+        file << '}';
+    }
+    file << "\n]}\n";
+}
+
+trace::scope::scope(const char* name, const char* category) noexcept
+    : _name(name)
+    , _category(category)
+    , _start_ns(s_enabled ? now_ns() : 0)
+{
+
+}
+
+trace::scope::~scope()
+{
+    if (s_enabled)
+        complete(_name, _category, _start_ns, now_ns());
+}
@@ -0,0 +1,114 @@
+#include "chip8_quirks.h"
+#include "jchip8.h"
+#include "jchip8_api.h"
+#include "typedefs.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Fuzz input layout, chosen so the mutator can change the ROM and the keypad script independently:
+//   [0]        quirk mask (low five bits)
+//   [1]        frame count - 1 (low four bits)
+//   [2]        instructions per frame - 1 (low four bits)
+//   [3..]      two bytes of held keys per frame, bit n being key n
+//   [rest]     the ROM, loaded at 0x200
+// Missing bytes read as zero, so every input is valid.  The budget is kept to a few hundred instructions
+// per input; loops in a ROM are found just as well by the mutator and it keeps executions per second high.
+//
+// An input starting with a save state's "J8ST" magic is instead handed to jchip8_load_state, padded with
+// zeros to a full blob, and run if it is accepted.  Whatever bytes a caller loads must either be rejected
+// or run without crashing or hanging.
+
+namespace
+{
+    constexpr size_t HEADER_SIZE = 3;
+    constexpr uint32 MAX_FRAMES = 16;
+    constexpr uint32 MAX_INSTRUCTIONS_PER_FRAME = 16;
+
+    struct fuzz_input
+    {
+        const uint8* data;
+        size_t size;
+
+        uint8 byte(size_t index) const noexcept { return index < size ? data[index] : 0; }
+    };
+
+    chip8_quirks quirks_from_mask(uint8 mask) noexcept
+    {
+        chip8_quirks quirks;
+        quirks.shift_uses_vy = (mask & QUIRK_SHIFT_USES_VY) != 0;
+        quirks.load_store_increments_i = (mask & QUIRK_LOAD_STORE_INCREMENTS_I) != 0;
+        quirks.logic_resets_vf = (mask & QUIRK_LOGIC_RESETS_VF) != 0;
+        quirks.clip_sprites = (mask & QUIRK_CLIP_SPRITES) != 0;
+        quirks.display_wait = (mask & QUIRK_DISPLAY_WAIT) != 0;
+        return quirks;
+    }
+
+    void run_frame(JChip8& chip8, const fuzz_input& input, uint32 frame, uint16 instructions_per_frame)
+    {
+        uint16 keys = static_cast<uint16>(input.byte(HEADER_SIZE + frame * 2) | (input.byte(HEADER_SIZE + frame * 2 + 1) << 8));
+        chip8.keypad = keys;
+
+        // The timers tick from the cycle counter as the frame runs
+        chip8.run(instructions_per_frame);
+    }
+
+    int fuzz_state_blob(const uint8* data, size_t size)
+    {
+        static jchip8_core* core = jchip8_create(700);
+        static std::vector<uint8> blob(jchip8_state_size());
+
+        std::fill(blob.begin(), blob.end(), 0);
+        std::memcpy(blob.data(), data, std::min(size, blob.size()));
+        if (jchip8_load_state(core, blob.data(), blob.size()) == JCHIP8_OK)
+            jchip8_run(core, 1000);
+        return 0;
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    // One machine for the whole run; constructing one per input would dominate the cost
+    static JChip8 chip8;
+    static machine_state midpoint;
+    static machine_state first_run;
+    static machine_state second_run;
+
+    if (size >= 4 && std::memcmp(data, "J8ST", 4) == 0)
+        return fuzz_state_blob(data, size);
+
+    fuzz_input input{ data, size };
+    uint32 frames = (input.byte(1) & (MAX_FRAMES - 1)) + 1;
+    uint16 instructions_per_frame = static_cast<uint16>((input.byte(2) & (MAX_INSTRUCTIONS_PER_FRAME - 1)) + 1);
+
+    size_t rom_offset = std::min(size, HEADER_SIZE + frames * 2);
+    size_t rom_size = std::min(size - rom_offset, static_cast<size_t>(MEMORY_SIZE - ROM_START_LOCATION));
+    chip8.load_ROM(data + rom_offset, rom_size, quirks_from_mask(input.byte(0)));
+    chip8.seed_rng(0x4A433850);
+
+    // Run the script, then replay its second half from a snapshot.  Rewind, run-ahead and netplay all
+    // depend on the replay landing in exactly the same state.
+    uint32 half = frames / 2;
+    for (uint32 frame = 0; frame < half; ++frame)
+        run_frame(chip8, input, frame, instructions_per_frame);
+    chip8.capture_state(midpoint);
+
+    for (uint32 frame = half; frame < frames; ++frame)
+        run_frame(chip8, input, frame, instructions_per_frame);
+    chip8.capture_state(first_run);
+
+    chip8.restore_state(midpoint);
+    for (uint32 frame = half; frame < frames; ++frame)
+        run_frame(chip8, input, frame, instructions_per_frame);
+    chip8.capture_state(second_run);
+
+    // Restoring always requests a redraw, which is the one intended difference
+    second_run.draw_flag = first_run.draw_flag;
+    if (std::memcmp(&first_run, &second_run, sizeof(machine_state)) != 0)
+        std::abort();
+
+    return 0;
+}
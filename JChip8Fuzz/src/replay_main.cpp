@@ -0,0 +1,50 @@
+#include "typedefs.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace
+{
+    void replay_file(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8> input{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+}
+
+// Stands in for libFuzzer's driver on compilers without it, so crashes and corpora found on a Clang
+// build can be replayed anywhere.  Takes any mix of files and corpus directories.
+int main(int argc, char* argv[])
+{
+    uint64 replayed = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::filesystem::path path = argv[i];
+        if (std::filesystem::is_directory(path))
+        {
+            for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(path))
+            {
+                if (entry.is_regular_file())
+                {
+                    replay_file(entry.path());
+                    ++replayed;
+                }
+            }
+        }
+        else
+        {
+            replay_file(path);
+            ++replayed;
+        }
+    }
+
+    std::cout << "Replayed " << replayed << " inputs without a crash\n";
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef JUMI_JCHIP8RECOMP_ROM_RECOMPILER_H
+#define JUMI_JCHIP8RECOMP_ROM_RECOMPILER_H
+#include "typedefs.h"
+#include <string>
+#include <vector>
+
+// Translates a ROM into a C++ translation unit that runs it natively on a JChip8.  Control flow is recovered
+// from 0x200 by following jumps, calls, both sides of every skip and the jump tables BNNN indexes into.  Every
+// instruction found becomes a case of one switch on pc, so returns and computed jumps dispatch through it and
+// direct jumps are plain gotos.  Whatever the search couldn't reach is left to the interpreter at run time.
+class rom_recompiler
+{
+public:
+    rom_recompiler(std::vector<uint8> rom, uint8 quirks);
+
+    // Registered for load_ROM to find, or with a symbol, exported under that name for attach_recompiled instead
+    [[nodiscard]] std::string generate(const std::string& name, const std::string& symbol = std::string()) const;
+    [[nodiscard]] uint32 instructions() const noexcept;
+
+private:
+    std::vector<uint8> _rom;
+    uint8 _quirks;
+    std::vector<bool> _code;        // per address, an instruction the search reached starts there
+
+    [[nodiscard]] bool in_rom(uint32 address) const noexcept;
+    [[nodiscard]] uint16 opcode_at(uint32 address) const noexcept;
+    [[nodiscard]] bool is_code(uint32 address) const noexcept;
+    void discover();
+    void emit_instruction(std::string& out, uint16 address, const std::vector<bool>& labelled, std::vector<bool>& targets) const;
+    [[nodiscard]] std::string jump(uint32 target, std::vector<bool>& targets) const;
+    [[nodiscard]] std::string dispatch(std::vector<bool>& targets) const;
+};
+
+#endif
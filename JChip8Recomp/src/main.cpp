@@ -0,0 +1,61 @@
+#include "chip8_quirks.h"
+#include "jchip8.h"
+#include "rom_recompiler.h"
+#include "typedefs.h"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Usage: JChip8Recomp <rom.ch8> <output.cpp> [--quirks mask] [--symbol name]
+// The mask uses the JCHIP8_QUIRK_* bits and has to match the quirks the ROM runs under for the translation to be
+// used; the default, 15, is the emulator's default quirks.  Compiled in, the translation is picked up by load_ROM
+// whenever those bytes are loaded, unless --symbol exports it under a name to be attached by hand.
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> paths;
+    uint8 quirks = quirk_mask(chip8_quirks{});
+    std::string symbol;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--quirks") == 0 && i + 1 < argc)
+            quirks = static_cast<uint8>(std::strtoul(argv[++i], nullptr, 0) & (QUIRK_COMBINATIONS - 1));
+        else if (std::strcmp(argv[i], "--symbol") == 0 && i + 1 < argc)
+            symbol = argv[++i];
+        else
+            paths.emplace_back(argv[i]);
+    }
+    if (paths.size() != 2)
+    {
+        std::cerr << "Usage: JChip8Recomp <rom.ch8> <output.cpp> [--quirks mask] [--symbol name]\n";
+        return 1;
+    }
+
+    std::ifstream file(paths[0], std::ios::binary);
+    std::vector<uint8> rom{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    if (!file || rom.size() < 2 || rom.size() > MEMORY_SIZE - ROM_START_LOCATION)
+    {
+        std::cerr << "Could not read a ROM from " << paths[0] << '\n';
+        return 1;
+    }
+
+    std::string name = std::filesystem::path(paths[0]).filename().string();
+    rom_recompiler recompiler{ rom, quirks };
+    std::filesystem::path output_path(paths[1]);
+    if (output_path.has_parent_path())
+        std::filesystem::create_directories(output_path.parent_path());
+    std::ofstream output(output_path);
+    output << recompiler.generate(name, symbol);
+    if (!output)
+    {
+        std::cerr << "Could not write " << paths[1] << '\n';
+        return 1;
+    }
+
+    std::cout << "Translated " << recompiler.instructions() << " instructions of " << name << '\n';
+    return 0;
+}
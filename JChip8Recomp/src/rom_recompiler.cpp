@@ -0,0 +1,347 @@
+#include "rom_recompiler.h"
+#include "chip8_quirks.h"
+#include "jchip8.h"
+#include <cstdio>
+#include <utility>
+
+namespace
+{
+    std::string hex(uint32 value, int digits)
+    {
+        char text[16];
+        std::snprintf(text, sizeof(text), "0x%0*X", digits, value);
+        return text;
+    }
+
+    std::string label(uint32 address)
+    {
+        char text[16];
+        std::snprintf(text, sizeof(text), "L_%03X", address);
+        return text;
+    }
+
+    std::string reg(uint32 index)
+    {
+        char text[16];
+        std::snprintf(text, sizeof(text), "m.V[0x%X]", index & 0xF);
+        return text;
+    }
+
+    // Everything a translation needs besides its switch: the step check before each instruction, and the
+    // interpreter's own handler for instructions that touch machine state the translation can't see
+    constexpr const char* PREAMBLE =
+        "#define STEP(address) if (n == budget) { m.pc = address; exit = recompiled_exit::budget; return n; } ++n;\n"
+        "#define INTERPRET(next, op) { instruction instr{ op, op & 0x0FFF, op & 0xFF, op & 0xF, (op >> 8) & 0xF, (op >> 4) & 0xF }; \\\n"
+        "    m.pc = next; m.execute_instruction(instr); }\n";
+}
+
+rom_recompiler::rom_recompiler(std::vector<uint8> rom, uint8 quirks)
+    : _rom(std::move(rom))
+    , _quirks(quirks)
+    , _code(MEMORY_SIZE, false)
+{
+    discover();
+}
+
+uint32 rom_recompiler::instructions() const noexcept
+{
+    uint32 count = 0;
+    for (bool code : _code)
+        count += code ? 1 : 0;
+    return count;
+}
+
+bool rom_recompiler::in_rom(uint32 address) const noexcept
+{
+    return address >= ROM_START_LOCATION && address + 1 < ROM_START_LOCATION + _rom.size();
+}
+
+uint16 rom_recompiler::opcode_at(uint32 address) const noexcept
+{
+    return static_cast<uint16>(_rom[address - ROM_START_LOCATION] << 8 | _rom[address + 1 - ROM_START_LOCATION]);
+}
+
+bool rom_recompiler::is_code(uint32 address) const noexcept
+{
+    return address < MEMORY_SIZE && _code[address];
+}
+
+void rom_recompiler::discover()
+{
+    std::vector<uint32> pending{ ROM_START_LOCATION };
+    while (!pending.empty())
+    {
+        uint32 address = pending.back();
+        pending.pop_back();
+        if (!in_rom(address) || _code[address])
+            continue;
+        _code[address] = true;
+
+        uint16 opcode = opcode_at(address);
+        uint32 nnn = opcode & 0x0FFFu;
+        switch (opcode >> 12)
+        {
+            case 0x0:
+                // Decoded by the low byte alone, as the interpreter does, so 0x0NEE returns whatever N is
+                if ((opcode & 0xFF) != 0xEE)
+                    pending.push_back(address + 2);
+                break;
+            case 0x1:
+                pending.push_back(nnn);
+                break;
+            case 0x2:
+                pending.push_back(nnn);
+                pending.push_back(address + 2);
+                break;
+            case 0x3: case 0x4: case 0x5: case 0x9: case 0xE:
+                pending.push_back(address + 2);
+                pending.push_back(address + 4);
+                break;
+            case 0xB:
+                // A jump table is usually a run of JPs at NNN, indexed by V0 in steps of two
+                for (uint32 entry = nnn; in_rom(entry) && (opcode_at(entry) >> 12) == 0x1 && entry < nnn + 256; entry += 2)
+                    pending.push_back(entry);
+                break;
+            default:
+                pending.push_back(address + 2);
+                break;
+        }
+    }
+}
+
+std::string rom_recompiler::jump(uint32 target, std::vector<bool>& targets) const
+{
+    if (is_code(target))
+    {
+        targets[target] = true;
+        return "goto " + label(target) + ";";
+    }
+    return "{ m.pc = " + hex(target, 3) + "; " + dispatch(targets) + " }";
+}
+
+std::string rom_recompiler::dispatch(std::vector<bool>& targets) const
+{
+    targets[MEMORY_SIZE] = true;
+    return "goto dispatch;";
+}
+
+void rom_recompiler::emit_instruction(std::string& out, uint16 address, const std::vector<bool>& labelled, std::vector<bool>& targets) const
+{
+    uint16 opcode = opcode_at(address);
+    uint32 x = (opcode >> 8) & 0xFu;
+    uint32 y = (opcode >> 4) & 0xFu;
+    uint32 n = opcode & 0xFu;
+    std::string nn = hex(opcode & 0xFFu, 2);
+    std::string nnn = hex(opcode & 0xFFFu, 3);
+    std::string next = hex(address + 2u, 3);
+    std::string op = hex(opcode, 4);
+    std::string vx = reg(x);
+    std::string vy = reg(y);
+    std::string interpret = "INTERPRET(" + next + ", " + op + ")";
+    bool logic_resets_vf = (_quirks & QUIRK_LOGIC_RESETS_VF) != 0;
+    bool load_store_increments_i = (_quirks & QUIRK_LOAD_STORE_INCREMENTS_I) != 0;
+    std::string shift_source = (_quirks & QUIRK_SHIFT_USES_VY) ? vy : vx;
+
+    out += "    case " + hex(address, 3) + ":" + (labelled[address] ? " " + label(address) + ":" : "") + "\n";
+    out += "        STEP(" + hex(address, 3) + ")\n        ";
+    bool falls_through = true;
+    switch (opcode >> 12)
+    {
+        case 0x0:
+            if ((opcode & 0xFF) == 0xE0)
+                out += interpret;
+            else if ((opcode & 0xFF) == 0xEE)
+            {
+                out += "m.sp = static_cast<uint16>((m.sp - 1) & STACK_MASK); m.pc = m.stack[m.sp]; " + dispatch(targets);
+                falls_through = false;
+            }
+            else
+                out += "// " + op + " is ignored";
+            break;
+        case 0x1:
+            out += jump(opcode & 0xFFFu, targets);
+            falls_through = false;
+            break;
+        case 0x2:
+            out += "m.stack[m.sp & STACK_MASK] = " + next + "; m.sp = static_cast<uint16>((m.sp + 1) & STACK_MASK); " + jump(opcode & 0xFFFu, targets);
+            falls_through = false;
+            break;
+        case 0x3: out += "if (" + vx + " == " + nn + ") " + jump(address + 4u, targets); break;
+        case 0x4: out += "if (" + vx + " != " + nn + ") " + jump(address + 4u, targets); break;
+        case 0x5: out += "if (" + vx + " == " + vy + ") " + jump(address + 4u, targets); break;
+        case 0x6: out += vx + " = " + nn + ";"; break;
+        case 0x7: out += vx + " = static_cast<uint8>(" + vx + " + " + nn + ");"; break;
+        case 0x8:
+            switch (n)
+            {
+                case 0x0: out += vx + " = " + vy + ";"; break;
+                case 0x1: out += vx + " |= " + vy + ";" + (logic_resets_vf ? " m.V[0xF] = 0;" : ""); break;
+                case 0x2: out += vx + " &= " + vy + ";" + (logic_resets_vf ? " m.V[0xF] = 0;" : ""); break;
+                case 0x3: out += vx + " ^= " + vy + ";" + (logic_resets_vf ? " m.V[0xF] = 0;" : ""); break;
+                case 0x4: out += "{ uint32 sum = " + vx + " + " + vy + "; " + vx + " = static_cast<uint8>(sum); m.V[0xF] = sum > 0xFF; }"; break;
+                case 0x5: out += "{ uint8 flag = " + vy + " <= " + vx + "; " + vx + " = static_cast<uint8>(" + vx + " - " + vy + "); m.V[0xF] = flag; }"; break;
+                case 0x6: out += "{ uint8 source = " + shift_source + "; " + vx + " = static_cast<uint8>(source >> 1); m.V[0xF] = static_cast<uint8>(source & 0x1); }"; break;
+                case 0x7: out += "{ uint8 flag = " + vx + " <= " + vy + "; " + vx + " = static_cast<uint8>(" + vy + " - " + vx + "); m.V[0xF] = flag; }"; break;
+                case 0xE: out += "{ uint8 source = " + shift_source + "; " + vx + " = static_cast<uint8>(source << 1); m.V[0xF] = static_cast<uint8>(source >> 7); }"; break;
+                default: out += "// " + op + " is ignored"; break;
+            }
+            break;
+        case 0x9: out += "if (" + vx + " != " + vy + ") " + jump(address + 4u, targets); break;
+        case 0xA: out += "m.I = " + nnn + ";"; break;
+        case 0xB:
+            out += "m.pc = static_cast<uint16>(" + nnn + " + m.V[0x0]); " + dispatch(targets);
+            falls_through = false;
+            break;
+        case 0xC: out += interpret; break;
+        case 0xD:
+            // A draw ends the batch, as it does in the interpreter
+            out += interpret + " exit = recompiled_exit::drew; return n;";
+            falls_through = false;
+            break;
+        case 0xE:
+            if ((opcode & 0xFF) == 0x9E)
+                out += "if (m.keypad & (1u << (" + vx + " & KEY_MASK))) " + jump(address + 4u, targets);
+            else if ((opcode & 0xFF) == 0xA1)
+                out += "if (!(m.keypad & (1u << (" + vx + " & KEY_MASK)))) " + jump(address + 4u, targets);
+            else
+                out += "// " + op + " is ignored";
+            break;
+        case 0xF:
+            switch (opcode & 0xFF)
+            {
+                case 0x07: out += vx + " = m.delay_timer;"; break;
+                case 0x15: out += "m.delay_timer = " + vx + ";"; break;
+                case 0x18: out += "m.sound_timer = " + vx + ";"; break;
+                case 0x1E: out += "m.I = static_cast<uint16>(m.I + " + vx + ");"; break;
+                case 0x29: out += "m.I = static_cast<uint16>(" + vx + " * 5);"; break;
+                case 0x0A:
+                    // Waiting for a key runs the instruction again each cycle, the way the interpreter does
+                    out += interpret + " if (m.pc != " + next + ") " + jump(address, targets);
+                    break;
+                case 0x33:
+                case 0x55:
+                    out += "{ uint16 at = m.I; " + interpret + " if (writes_code(at, " + std::to_string((opcode & 0xFF) == 0x33 ? 3 : x + 1)
+                        + ")) { exit = recompiled_exit::code_written; return n; } }";
+                    break;
+                case 0x65:
+                    for (uint32 i = 0; i <= x; ++i)
+                        out += reg(i) + " = m.memory[(m.I + " + std::to_string(i) + ") & MEMORY_MASK]; ";
+                    if (load_store_increments_i)
+                        out += "m.I = static_cast<uint16>(m.I + " + std::to_string(x + 1) + ");";
+                    break;
+                case 0x02:
+                case 0x3A:
+                    out += interpret;
+                    break;
+                default:
+                    out += "// " + op + " is ignored";
+                    break;
+            }
+            break;
+    }
+    out += "\n";
+
+    // Cases fall through to the next address in order, which is only the following instruction if the search
+    // found one there and nothing at the odd address in between
+    if (falls_through)
+    {
+        uint32 following = address + 1u;
+        while (following < MEMORY_SIZE && !is_code(following))
+            ++following;
+        if (following != address + 2u)
+            out += "        " + jump(address + 2u, targets) + "\n";
+        else
+            out += "        [[fallthrough]];\n";
+    }
+}
+
+std::string rom_recompiler::generate(const std::string& name, const std::string& symbol) const
+{
+    std::string out;
+    out += "// Generated by JChip8Recomp from " + name + ".  Do not edit; regenerate it from the ROM instead.\n";
+    out += "#include \"jchip8.h\"\n#include \"recompiled.h\"\n\n";
+    out += PREAMBLE;
+    out += "\nnamespace\n{\n";
+
+    out += "    const uint8 s_rom[] =\n    {";
+    for (size_t i = 0; i < _rom.size(); ++i)
+        out += std::string(i % 16 == 0 ? "\n        " : " ") + hex(_rom[i], 2) + ",";
+    out += "\n    };\n\n";
+
+    // The bytes of every instruction found, as ranges for checking memory and a bitmap for checking stores
+    std::vector<std::pair<uint32, uint32>> ranges;
+    std::vector<bool> code_bytes(MEMORY_SIZE, false);
+    for (uint32 address = 0; address < MEMORY_SIZE; ++address)
+    {
+        if (!_code[address])
+            continue;
+        code_bytes[address] = code_bytes[address + 1] = true;
+        if (!ranges.empty() && ranges.back().second >= address)
+            ranges.back().second = address + 2;
+        else
+            ranges.emplace_back(address, address + 2);
+    }
+    out += "    const recompiled_range s_code[] =\n    {\n";
+    for (const std::pair<uint32, uint32>& range : ranges)
+        out += "        { " + hex(range.first, 3) + ", " + hex(range.second, 3) + " },\n";
+    out += "    };\n\n";
+
+    out += "    const uint8 s_code_bytes[MEMORY_SIZE / 8] =\n    {";
+    for (uint32 i = 0; i < MEMORY_SIZE / 8; ++i)
+    {
+        uint32 bits = 0;
+        for (uint32 bit = 0; bit < 8; ++bit)
+            bits |= code_bytes[i * 8 + bit] ? 1u << bit : 0u;
+        out += std::string(i % 16 == 0 ? "\n        " : " ") + hex(bits, 2) + ",";
+    }
+    out += "\n    };\n\n";
+
+    out += "    bool writes_code(uint16 at, uint32 length)\n    {\n";
+    out += "        for (uint32 i = 0; i < length; ++i)\n        {\n";
+    out += "            uint32 address = (at + i) & MEMORY_MASK;\n";
+    out += "            if (s_code_bytes[address / 8] & (1u << (address % 8)))\n                return true;\n        }\n";
+    out += "        return false;\n    }\n\n";
+
+    out += "    uint16 run(JChip8& m, uint16 budget, recompiled_exit& exit)\n    {\n";
+    // A first pass finds which instructions something jumps to, so the second only labels those.  The extra
+    // entry past the end of memory stands for the dispatch label.
+    std::vector<bool> targets(MEMORY_SIZE + 1, false);
+    std::vector<bool> labelled(MEMORY_SIZE + 1, false);
+    std::string cases;
+    for (uint32 address = 0; address < MEMORY_SIZE; ++address)
+    {
+        if (_code[address])
+            emit_instruction(cases, static_cast<uint16>(address), labelled, targets);
+    }
+    labelled = targets;
+    cases.clear();
+    for (uint32 address = 0; address < MEMORY_SIZE; ++address)
+    {
+        if (_code[address])
+            emit_instruction(cases, static_cast<uint16>(address), labelled, targets);
+    }
+
+    out += std::string("        uint16 n = 0;\n") + (labelled[MEMORY_SIZE] ? "    dispatch:\n" : "") + "        switch (m.pc)\n        {\n";
+    // Indented to sit inside the switch
+    size_t start = 0;
+    while (start < cases.size())
+    {
+        size_t end = cases.find('\n', start);
+        out += "    " + cases.substr(start, end - start + 1);
+        start = end + 1;
+    }
+    out += "        default:\n            exit = recompiled_exit::unknown_pc;\n            return n;\n        }\n    }\n";
+
+    std::string program = "{ \"" + name + "\", " + hex(_quirks, 2) + ", s_rom, " + std::to_string(_rom.size()) + ", s_code, "
+        + std::to_string(ranges.size()) + ", run };\n";
+    if (symbol.empty())
+    {
+        out += "\n    const recompiled_program s_program" + program;
+        out += "    const recompiled_registration s_registration{ s_program };\n}\n";
+    }
+    else
+    {
+        out += "}\n\nextern const recompiled_program " + symbol + ";\nconst recompiled_program " + symbol + program;
+    }
+    return out;
+}
@@ -0,0 +1,124 @@
+#include "chip8_quirks.h"
+#include "jchip8.h"
+#include "typedefs.h"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Drives the headless core the way the frontend does, so a profile-generating build records the paths that
+// matter when a game is played: a frame of instructions at the configured speed with its timer ticks, a rewind
+// capture, and key changes stamped into the input queue.  Every ROM is run under each quirk combination
+// because the engine variant a game uses is picked from its quirks.
+
+namespace
+{
+    constexpr uint16 TRAINING_IPS = 700;
+
+    chip8_quirks quirks_from_mask(uint8 mask) noexcept
+    {
+        chip8_quirks quirks;
+        quirks.shift_uses_vy = (mask & QUIRK_SHIFT_USES_VY) != 0;
+        quirks.load_store_increments_i = (mask & QUIRK_LOAD_STORE_INCREMENTS_I) != 0;
+        quirks.logic_resets_vf = (mask & QUIRK_LOGIC_RESETS_VF) != 0;
+        quirks.clip_sprites = (mask & QUIRK_CLIP_SPRITES) != 0;
+        quirks.display_wait = (mask & QUIRK_DISPLAY_WAIT) != 0;
+        return quirks;
+    }
+
+    bool is_rom(const std::filesystem::path& path)
+    {
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(path, error);
+        return !error && size > 0 && size <= MEMORY_SIZE - ROM_START_LOCATION;
+    }
+
+    void collect_roms(const std::filesystem::path& path, std::vector<std::filesystem::path>& roms)
+    {
+        if (std::filesystem::is_directory(path))
+        {
+            for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(path))
+            {
+                if (entry.is_regular_file() && is_rom(entry.path()))
+                    roms.push_back(entry.path());
+            }
+        }
+        else if (is_rom(path))
+        {
+            roms.push_back(path);
+        }
+        else
+        {
+            std::cerr << "Skipping " << path.string() << ": not a ROM or directory\n";
+        }
+    }
+
+    uint64 train_rom(const std::vector<uint8>& rom, uint32 frames)
+    {
+        JChip8 chip8{ TRAINING_IPS };
+        machine_state rewind_point;
+        uint32 random = 0x2545F491;
+        uint64 executed = 0;
+
+        for (uint8 mask = 0; mask < QUIRK_COMBINATIONS; ++mask)
+        {
+            chip8.load_ROM(rom.data(), rom.size(), quirks_from_mask(mask));
+            chip8.seed_rng(mask + 1);
+            for (uint32 frame = 0; frame < frames; ++frame)
+            {
+                // A key changes every few frames, which is about as often as a player presses one
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+                if ((random & 7) == 0)
+                    chip8.queue_input(input_event{ chip8.cycles() + (random >> 8) % 12, static_cast<uint8>((random >> 4) & 0xF), ((random >> 3) & 1) != 0 });
+
+                executed += chip8.run_frame();
+                if (chip8.draw_flag())
+                    chip8.reset_draw_flag();
+
+                if (frame % 60 == 0)
+                    chip8.capture_state(rewind_point);
+                else if (frame % 600 == 599)
+                    chip8.restore_state(rewind_point);
+            }
+        }
+        return executed;
+    }
+}
+
+// Usage: JChip8Train [--frames N] <ROM files or directories>...
+int main(int argc, char* argv[])
+{
+    uint32 frames = 60 * 60;
+    std::vector<std::filesystem::path> roms;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = static_cast<uint32>(std::strtoul(argv[++i], nullptr, 10));
+        else
+            collect_roms(argv[i], roms);
+    }
+
+    if (roms.empty())
+    {
+        std::cerr << "No ROMs to train on; pass ROM files or directories\n";
+        return 1;
+    }
+
+    uint64 executed = 0;
+    for (const std::filesystem::path& path : roms)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8> rom{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+        executed += train_rom(rom, frames);
+        std::cout << "Trained on " << path.filename().string() << '\n';
+    }
+
+    std::cout << "Ran " << executed << " instructions over " << roms.size() << " ROMs\n";
+    return 0;
+}